@@ -0,0 +1,91 @@
+//
+//  arena.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/12/18.
+//
+
+#include "arena.hpp"
+#include "path_common.hpp"
+
+// Constructor/Destructor
+Arena::Arena(size_t block_size)
+  : block_size_(block_size), idx_block_(0), offset_(0), bytes_used_(0),
+    num_block_allocs_(0) {
+  AddBlock(block_size_);
+}
+
+Arena::~Arena() {
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    ::operator delete(blocks_[i].data);
+  }
+}
+
+/**
+ * Member data accessors
+ */
+size_t Arena::GetNumBytesUsed() const { return bytes_used_; }
+int Arena::GetNumBlockAllocs() const { return num_block_allocs_; }
+
+/**
+ * Add a new block of at least min_size bytes from the global heap
+ */
+void Arena::AddBlock(size_t min_size) {
+  Block block;
+  block.size = std::max(block_size_, min_size);
+  block.data = static_cast<char*>(::operator new(block.size));
+  blocks_.push_back(block);
+  num_block_allocs_++;
+}
+
+/**
+ * Allocate num_bytes aligned to alignment (power of 2) from the current
+ * block, moving on to the next block (or adding one) if it doesn't fit
+ */
+void* Arena::Allocate(size_t num_bytes, size_t alignment) {
+  
+  size_t start = (offset_ + alignment - 1) & ~(alignment - 1);
+  while (start + num_bytes > blocks_[idx_block_].size) {
+    idx_block_++;
+    if (idx_block_ == int(blocks_.size())) {
+      AddBlock(num_bytes + alignment);
+    }
+    offset_ = 0;
+    start = 0;
+  }
+  
+  offset_ = start + num_bytes;
+  bytes_used_ += num_bytes;
+  return blocks_[idx_block_].data + start;
+}
+
+/**
+ * Release all allocations at once.  If more than one block was used, the
+ * blocks are merged into one block of their total size so the next cycle's
+ * allocations fit without adding blocks.
+ */
+void Arena::Reset() {
+  
+  if (idx_block_ > 0) {
+    size_t total_size = 0;
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+      total_size += blocks_[i].size;
+      ::operator delete(blocks_[i].data);
+    }
+    blocks_.clear();
+    AddBlock(total_size);
+  }
+  
+  idx_block_ = 0;
+  offset_ = 0;
+  bytes_used_ = 0;
+}
+
+/**
+ * Get the arena for trajectory data of the current planning cycle, created
+ * once per process on first use and reset at the start of each cycle
+ */
+Arena& GetCycleArena() {
+  static Arena cycle_arena(kCycleArenaBlockSize);
+  return cycle_arena;
+}
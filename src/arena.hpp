@@ -0,0 +1,106 @@
+//
+//  arena.hpp
+//  Path_Planning
+//
+//  Created by Student on 2/12/18.
+//
+
+#ifndef arena_hpp
+#define arena_hpp
+
+#include <stdio.h>
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+/**
+ * Monotonic memory arena for data that only lives for one planning cycle.
+ * Allocations are bumped from large blocks and never freed one by one, and
+ * Reset() releases everything at once.  Blocks are kept for the next cycle,
+ * and if a cycle needed more than one block they are merged into a single
+ * block of the total size, so steady state cycles don't call the global
+ * allocator at all.
+ *
+ * Anything still pointing into the arena must be cleared before Reset().
+ */
+class Arena {
+public:
+  // Constructor/Destructor
+  explicit Arena(size_t block_size);
+  ~Arena();
+  
+  void* Allocate(size_t num_bytes, size_t alignment);
+  void Reset();
+  size_t GetNumBytesUsed() const;
+  int GetNumBlockAllocs() const;
+  
+private:
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  
+  struct Block {
+    char *data;
+    size_t size;
+  };
+  
+  void AddBlock(size_t min_size);
+  
+  std::vector<Block> blocks_;
+  size_t block_size_;
+  int idx_block_;
+  size_t offset_;
+  size_t bytes_used_;
+  int num_block_allocs_;
+};
+
+Arena& GetCycleArena();
+
+/**
+ * Standard allocator drawing from an arena, or from the global heap if no
+ * arena is given (default).  Containers keep the allocator they were
+ * constructed with since assignments don't propagate it, so long lived
+ * containers constructed on the heap stay on the heap when per-cycle data is
+ * assigned to them.
+ */
+template <class T>
+class ArenaAllocator {
+public:
+  typedef T value_type;
+  
+  ArenaAllocator() : arena_(NULL) { }
+  explicit ArenaAllocator(Arena *arena) : arena_(arena) { }
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.GetArena()) { }
+  
+  T* allocate(size_t n) {
+    if (arena_ == NULL) {
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T *p, size_t n) {
+    (void)n;
+    if (arena_ == NULL) { ::operator delete(p); }
+  }
+  
+  Arena* GetArena() const { return arena_; }
+  
+private:
+  Arena *arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+  return lhs.GetArena() == rhs.GetArena();
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+  return lhs.GetArena() != rhs.GetArena();
+}
+
+// Contiguous array that can draw from an arena
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif /* arena_hpp */
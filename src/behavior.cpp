@@ -17,8 +17,8 @@
  * Return best lane # with lowest cost
  */
 int LaneCostFcn(const EgoVehicle &ego_car,
-                const std::map<int, DetectedVehicle> &detected_cars,
-                const std::map<int, std::vector<int>> &car_ids_by_lane) {
+                const DetectedVehicleTable &detected_cars,
+                const LaneIndex &car_ids_by_lane) {
   
   std::vector<double> cost_by_lane;
   const int ego_id = ego_car.GetID();
@@ -36,7 +36,7 @@ int LaneCostFcn(const EgoVehicle &ego_car,
     const int car_id_ahead = std::get<0>(car_ahead);
     double rel_s_ahead = kSensorRange;
     if (car_id_ahead != ego_id) {
-      rel_s_ahead = detected_cars.at(car_id_ahead).GetRelS();
+      rel_s_ahead = detected_cars.GetRelS(detected_cars.Find(car_id_ahead));
     }
     // Cost is 0 at dist = full sensor range, ~1 at dist = 0 m
     const double cost_ahead_dist = (1-LogCost(rel_s_ahead, kSensorRange));
@@ -45,7 +45,7 @@ int LaneCostFcn(const EgoVehicle &ego_car,
     // #2) Cost by speed of car ahead
     double s_dot_ahead = kTargetSpeed;
     if (car_id_ahead != ego_id) {
-      s_dot_ahead = detected_cars.at(car_id_ahead).GetState().s_dot;
+      s_dot_ahead = detected_cars.GetSDot(detected_cars.Find(car_id_ahead));
     }
     // Cost is 0 at spd = full target speed, ~1 at spd = 0 m/s
     const double cost_ahead_spd = (1-LogCost(s_dot_ahead, kTargetSpeed));
@@ -58,9 +58,9 @@ int LaneCostFcn(const EgoVehicle &ego_car,
     double rel_s_behind = -kSensorRange;
     double rel_s_dot_behind = 0.;
     if (car_id_behind != ego_id) {
-      rel_s_behind = detected_cars.at(car_id_behind).GetRelS();
-      rel_s_dot_behind = (detected_cars.at(car_id_behind).GetState().s_dot
-                          - ego_spd);
+      const int idx_behind = detected_cars.Find(car_id_behind);
+      rel_s_behind = detected_cars.GetRelS(idx_behind);
+      rel_s_dot_behind = detected_cars.GetSDot(idx_behind) - ego_spd;
       rel_s_dot_behind = std::max(rel_s_dot_behind, 0.); // guard neg delta spd
     }
     if (abs(rel_s_behind) < kTgtFollowDist) {
@@ -110,15 +110,15 @@ int LaneCostFcn(const EgoVehicle &ego_car,
  * Returns the target intent.
  */
 VehIntents BehaviorFSM(const EgoVehicle &ego_car,
-                       const std::map<int, DetectedVehicle> &detected_cars,
-                       const std::map<int, std::vector<int>> &car_ids_by_lane) {
+                       const DetectedVehicleTable &detected_cars,
+                       const LaneIndex &car_ids_by_lane) {
   
   VehIntents tgt_intent;
   const double gap_on_left = EgoCheckSideGap(kLeft, ego_car, detected_cars,
                                              car_ids_by_lane);
   const double gap_on_right = EgoCheckSideGap(kRight, ego_car, detected_cars,
                                               car_ids_by_lane);
-  const VehBehavior ego_beh = ego_car.GetTgtBehavior();
+  const VehBehavior &ego_beh = ego_car.GetTgtBehavior();
   const VehIntents cur_intent = ego_beh.intent;
   const int cur_tgt_lane = ego_beh.tgt_lane;
   const int ego_lane = ego_car.GetLane();
@@ -192,12 +192,12 @@ VehIntents BehaviorFSM(const EgoVehicle &ego_car,
  * Set behavior target speed based on the target intent
  */
 double SetTargetSpeed(const EgoVehicle &ego_car,
-                      const std::map<int, DetectedVehicle> &detected_cars,
-                      const std::map<int, std::vector<int>> &car_ids_by_lane) {
+                      const DetectedVehicleTable &detected_cars,
+                      const LaneIndex &car_ids_by_lane) {
   
   // Set initial target speed to base target speed parameter
   double target_speed = kTargetSpeed;
-  const VehBehavior ego_beh = ego_car.GetTgtBehavior();
+  const VehBehavior &ego_beh = ego_car.GetTgtBehavior();
   
   // Limit target speed by car ahead in current lane
   target_speed = TargetSpeedKL(target_speed, ego_car, detected_cars,
@@ -232,8 +232,8 @@ double SetTargetSpeed(const EgoVehicle &ego_car,
  * Set target speed for Keep Lane intent (follow car ahead)
  */
 double TargetSpeedKL(double base_tgt_spd, const EgoVehicle &ego_car,
-                     const std::map<int, DetectedVehicle> &detected_cars,
-                     const std::map<int, std::vector<int>> &car_ids_by_lane) {
+                     const DetectedVehicleTable &detected_cars,
+                     const LaneIndex &car_ids_by_lane) {
 
   double tgt_speed = base_tgt_spd; // default is to pass-through base speed
 
@@ -246,12 +246,13 @@ double TargetSpeedKL(double base_tgt_spd, const EgoVehicle &ego_car,
   
   // Set base target speed limited by car ahead
   if (car_id_ahead >= 0) {
-    const double dist_ahead = detected_cars.at(car_id_ahead).GetRelS();
+    const int idx_ahead = detected_cars.Find(car_id_ahead);
+    const double dist_ahead = detected_cars.GetRelS(idx_ahead);
     
     if (dist_ahead < kTgtStartFollowDist) {
       
       // Decrease target speed proportionally to distance of car ahead
-      const double spd_ahead = detected_cars.at(car_id_ahead).GetState().s_dot;
+      const double spd_ahead = detected_cars.GetSDot(idx_ahead);
       const double spd_slope = ((spd_ahead - kTargetSpeed)
                                 / (kTgtFollowDist - kTgtStartFollowDist));
       
@@ -279,8 +280,8 @@ double TargetSpeedKL(double base_tgt_spd, const EgoVehicle &ego_car,
  */
 double TargetSpeedPLC(VehSides sidePLC, double base_tgt_spd,
                       const EgoVehicle &ego_car,
-                      const std::map<int, DetectedVehicle> &detected_cars,
-                      const std::map<int, std::vector<int>> &car_ids_by_lane) {
+                      const DetectedVehicleTable &detected_cars,
+                      const LaneIndex &car_ids_by_lane) {
   
   double target_speed = base_tgt_spd; // default is to pass-through base speed
   const int check_lane = ego_car.GetLane() + sidePLC;
@@ -308,15 +309,15 @@ double TargetSpeedPLC(VehSides sidePLC, double base_tgt_spd,
   bool close_ahead = false;
   bool close_side_ahead = false;
   bool close_side_behind = false;
-  if ((detected_cars.count(car_id_ahead) > 0)
+  if (detected_cars.Contains(car_id_ahead)
       && (rel_s_ahead < kPLCCloseDist)) {
     close_ahead = true;
   }
-  if ((detected_cars.count(car_id_side_ahead) > 0)
+  if (detected_cars.Contains(car_id_side_ahead)
       && (rel_s_side_ahead < kLaneChangeMinGap)) {
     close_side_ahead = true;
   }
-  if ((detected_cars.count(car_id_side_behind) > 0)
+  if (detected_cars.Contains(car_id_side_behind)
       && (abs(rel_s_side_behind) < kLaneChangeMinGap)) {
     close_side_behind = true;
   }
@@ -344,8 +345,8 @@ double TargetSpeedPLC(VehSides sidePLC, double base_tgt_spd,
  */
 double TargetSpeedLC(VehSides sideLC, double base_tgt_spd,
                       const EgoVehicle &ego_car,
-                      const std::map<int, DetectedVehicle> &detected_cars,
-                      const std::map<int, std::vector<int>> &car_ids_by_lane) {
+                      const DetectedVehicleTable &detected_cars,
+                      const LaneIndex &car_ids_by_lane) {
 
   double target_speed = base_tgt_spd; // default is to pass-through base speed
   
@@ -359,11 +360,11 @@ double TargetSpeedLC(VehSides sideLC, double base_tgt_spd,
   const double rel_s_side_ahead = std::get<1>(car_side_ahead);
   
   // Set target speed to match car ahead in lane that ego is changing to
-  if ((detected_cars.count(car_id_side_ahead) > 0)
+  if (detected_cars.Contains(car_id_side_ahead)
       && (rel_s_side_ahead < kTgtStartFollowDist)) {
     
-    const double spd_side_ahead = detected_cars.at(car_id_side_ahead)
-                                  .GetState().s_dot;
+    const int idx_side_ahead = detected_cars.Find(car_id_side_ahead);
+    const double spd_side_ahead = detected_cars.GetSDot(idx_side_ahead);
     
     target_speed = spd_side_ahead;
     
@@ -12,29 +12,29 @@
 #include "vehicle.hpp"
 
 int LaneCostFcn(const EgoVehicle &ego_car,
-                const std::map<int, DetectedVehicle> &detected_cars,
-                const std::map<int, std::vector<int>> &car_ids_by_lane);
+                const DetectedVehicleTable &detected_cars,
+                const LaneIndex &car_ids_by_lane);
 
 VehIntents BehaviorFSM(const EgoVehicle &ego_car,
-                       const std::map<int, DetectedVehicle> &detected_cars,
-                       const std::map<int, std::vector<int>> &car_ids_by_lane);
+                       const DetectedVehicleTable &detected_cars,
+                       const LaneIndex &car_ids_by_lane);
 
 double SetTargetSpeed(const EgoVehicle &ego_car,
-                      const std::map<int, DetectedVehicle> &detected_cars,
-                      const std::map<int, std::vector<int>> &car_ids_by_lane);
+                      const DetectedVehicleTable &detected_cars,
+                      const LaneIndex &car_ids_by_lane);
 
 double TargetSpeedKL(double base_tgt_spd, const EgoVehicle &ego_car,
-                     const std::map<int, DetectedVehicle> &detected_cars,
-                     const std::map<int, std::vector<int>> &car_ids_by_lane);
+                     const DetectedVehicleTable &detected_cars,
+                     const LaneIndex &car_ids_by_lane);
 
 double TargetSpeedPLC(VehSides sidePLC, double base_tgt_spd,
                       const EgoVehicle &ego_car,
-                      const std::map<int, DetectedVehicle> &detected_cars,
-                      const std::map<int, std::vector<int>> &car_ids_by_lane);
+                      const DetectedVehicleTable &detected_cars,
+                      const LaneIndex &car_ids_by_lane);
 
 double TargetSpeedLC(VehSides sideLC, double base_tgt_spd,
                       const EgoVehicle &ego_car,
-                      const std::map<int, DetectedVehicle> &detected_cars,
-                      const std::map<int, std::vector<int>> &car_ids_by_lane);
+                      const DetectedVehicleTable &detected_cars,
+                      const LaneIndex &car_ids_by_lane);
 
 #endif /* behavior_hpp */
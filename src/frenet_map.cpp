@@ -0,0 +1,681 @@
+//
+//  frenet_map.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/10/18.
+//
+
+#include "frenet_map.hpp"
+#include <sstream>
+
+/**
+ * Set a tile's array views, with map_arrays holding the kNumMapArrays array
+ * pointers indexed by MapArray
+ */
+static void SetTileArrays(const double *const *map_arrays, MapTile *tile) {
+  tile->s = map_arrays[kMapS];
+  tile->x = map_arrays[kMapX];
+  tile->y = map_arrays[kMapY];
+  tile->dx = map_arrays[kMapDX];
+  tile->dy = map_arrays[kMapDY];
+  tile->seg_tan_x = map_arrays[kMapSegTanX];
+  tile->seg_tan_y = map_arrays[kMapSegTanY];
+  tile->tan_x = map_arrays[kMapTanX];
+  tile->tan_y = map_arrays[kMapTanY];
+  tile->norm_x = map_arrays[kMapNormX];
+  tile->norm_y = map_arrays[kMapNormY];
+  tile->curvature = map_arrays[kMapCurvature];
+}
+
+/**
+ * Read raw map waypoints [s, x, y, dx, dy] raw_lo to raw_hi from the raw map
+ * file rows at the indexed byte offsets and append them to fit.  Raw index
+ * num_raw is the initial raw waypoint added back at the end of the track
+ * (s = max_s) for wrap-around.  s and (x,y) are taken from the index, so only
+ * (dx,dy) are parsed from the rows (zero if a row can't be read).
+ */
+static void ReadRawRows(std::istream &map_in, const RawMapIndex &raw_index,
+                        int raw_lo, int raw_hi, double max_s,
+                        std::vector<double> *fit) {
+  
+  const int num_raw = raw_index.num_raw;
+  std::string line;
+  for (int j = raw_lo; j <= raw_hi; ++j) {
+    const int j_raw = (j < num_raw) ? j : 0;
+    if ((j == raw_lo) || (j_raw == 0)) {
+      map_in.clear();
+      map_in.seekg(raw_index.row_offset[j_raw]);
+    }
+    double x = 0.;
+    double y = 0.;
+    float s = 0.;
+    float d_x = 0.;
+    float d_y = 0.;
+    if (getline(map_in, line)) {
+      std::istringstream iss(line);
+      iss >> x >> y >> s >> d_x >> d_y;
+    }
+    else {
+      std::cerr << "Could not read raw map row " << j_raw << std::endl;
+    }
+    fit[kMapS].push_back((j < num_raw) ? raw_index.s[j] : max_s);
+    fit[kMapX].push_back(raw_index.x[j_raw]);
+    fit[kMapY].push_back(raw_index.y[j_raw]);
+    fit[kMapDX].push_back(d_x);
+    fit[kMapDY].push_back(d_y);
+  }
+}
+
+/**
+ * Interpolate the raw map waypoints [s, x, y, dx, dy] at map waypoints
+ * [wp_start, wp_start + num_interp), wrapping waypoint indices outside of
+ * [0, num_wps) around the track.  Each contiguous run of waypoints is
+ * interpolated by splines fit only to the raw waypoints around it, with
+ * kMapTileSplineMargin extra raw waypoints on each side read from the raw map
+ * file.
+ */
+static void InterpolateRawMap(std::istream &map_in,
+                              const RawMapIndex &raw_index,
+                              int wp_start, int num_interp, int num_wps,
+                              double s_inc, double max_s,
+                              std::vector<double> *interp) {
+  
+  const double *raw_s = raw_index.s;
+  const int num_raw = raw_index.num_raw;
+  for (int k = kMapS; k <= kMapDY; ++k) {
+    interp[k].resize(num_interp);
+  }
+  
+  int i_run = 0;
+  while (i_run < num_interp) {
+    // Find run of waypoints that don't wrap around the track
+    const int wp_run = (((wp_start + i_run) % num_wps) + num_wps) % num_wps;
+    const int run_size = std::min(num_interp - i_run, num_wps - wp_run);
+    const double s_first = wp_run * s_inc;
+    const double s_last = (wp_run + run_size - 1) * s_inc;
+  
+    // Raw waypoints around the run, where raw index num_raw is the initial
+    // raw waypoint added back at the end of the track for wrap-around
+    const int raw_lo = std::max(int(std::upper_bound(raw_s, raw_s + num_raw,
+                                                     s_first) - raw_s) - 1
+                                - kMapTileSplineMargin, 0);
+    const int raw_hi = std::min(int(std::lower_bound(raw_s, raw_s + num_raw,
+                                                     s_last) - raw_s)
+                                + kMapTileSplineMargin, num_raw);
+    std::vector<double> fit[kMapDY + 1];
+    ReadRawRows(map_in, raw_index, raw_lo, raw_hi, max_s, fit);
+  
+    // Make splines by s axis and interpolate run
+    for (int k = kMapX; k <= kMapDY; ++k) {
+      tk::spline spline_s;
+      spline_s.set_points(fit[kMapS], fit[k]);
+      for (int i = 0; i < run_size; ++i) {
+        interp[k][i_run + i] = spline_s(s_first + i * s_inc);
+      }
+    }
+    for (int i = 0; i < run_size; ++i) {
+      interp[kMapS][i_run + i] = s_first + i * s_inc;
+    }
+  
+    i_run += run_size;
+  }
+}
+
+/**
+ * FrenetMap constructor/destructor
+ */
+FrenetMap::FrenetMap() : num_wps_(0), s_inc_(0.), max_s_(0.), num_tiles_(0),
+                         is_tiled_(false), raster_(), use_raster_(false),
+                         raw_index_(), tile_clock_(0) {
+  for (int i = 0; i < kNumMapArrays; ++i) { flat_arrays_[i] = NULL; }
+}
+
+FrenetMap::~FrenetMap() {}
+
+/**
+ * Set flat map storage with whole waypoint arrays, grid index and raster
+ * viewing storage kept alive by the owner handle, with map_arrays holding the
+ * kNumMapArrays array pointers indexed by MapArray.  All tiles are views into
+ * the flat arrays.
+ */
+void FrenetMap::SetFlatArrays(const double *const *map_arrays, int num_wps,
+                              double s_inc, double max_s,
+                              const MapGrid &map_grid,
+                              const MapRaster &map_raster,
+                              std::shared_ptr<const void> owner) {
+  
+  s_inc_ = s_inc;
+  max_s_ = max_s;
+  is_tiled_ = false;
+  grid_ = map_grid;
+  raster_ = map_raster;
+  owner_ = owner;
+  map_file_.clear();
+  map_in_.close();
+  raw_index_ = RawMapIndex();
+  for (int i = 0; i < kNumMapArrays; ++i) { flat_arrays_[i] = map_arrays[i]; }
+  ResetTiles(num_wps);
+  
+  for (int t = 0; t < num_tiles_; ++t) {
+    std::unique_ptr<MapTile> tile(new MapTile());
+    tile->first_wp = t << kMapTileShift;
+    tile->num_wps = std::min(1 << kMapTileShift, num_wps_ - tile->first_wp);
+    const double *tile_arrays[kNumMapArrays];
+    for (int i = 0; i < kNumMapArrays; ++i) {
+      tile_arrays[i] = map_arrays[i] + tile->first_wp;
+    }
+    SetTileArrays(tile_arrays, tile.get());
+    tile_slots_[t].owned = std::move(tile);
+    tile_slots_[t].tile.store(tile_slots_[t].owned.get(),
+                              std::memory_order_release);
+  }
+}
+
+/**
+ * Set tiled map storage from the raw map file's row index and a map grid of
+ * the raw map waypoints, viewing storage kept alive by the owner handle (the
+ * tables built by BuildTiledFrenetMap or a memory mapped map cache).  Map
+ * waypoint tiles are interpolated from the raw map file rows on first access,
+ * and there is no XY->Frenet raster.
+ */
+void FrenetMap::SetRawMapIndex(const std::string &map_file,
+                               const RawMapIndex &raw_index, double s_inc,
+                               double max_s, const MapGrid &map_grid,
+                               std::shared_ptr<const void> owner) {
+  
+  s_inc_ = s_inc;
+  max_s_ = max_s;
+  is_tiled_ = true;
+  grid_ = map_grid;
+  raster_ = MapRaster();
+  owner_ = owner;
+  map_file_ = map_file;
+  raw_index_ = raw_index;
+  for (int i = 0; i < kNumMapArrays; ++i) { flat_arrays_[i] = NULL; }
+  ResetTiles(int(ceil(max_s / s_inc)));
+  
+  map_in_.close();
+  map_in_.clear();
+  map_in_.open(map_file_.c_str(), std::ifstream::in);
+  if (!map_in_) {
+    std::cerr << "Could not open raw map " << map_file_ << std::endl;
+  }
+}
+
+bool FrenetMap::IsTiled() const { return is_tiled_; }
+
+/**
+ * Get the raw map file and its row index of a tiled map (empty for a flat map)
+ */
+const std::string& FrenetMap::GetMapFile() const { return map_file_; }
+
+const RawMapIndex& FrenetMap::GetRawMapIndex() const { return raw_index_; }
+
+int FrenetMap::GetNumWaypoints() const { return num_wps_; }
+
+double FrenetMap::GetSInc() const { return s_inc_; }
+
+double FrenetMap::GetMaxS() const { return max_s_; }
+
+const MapGrid& FrenetMap::GetGrid() const { return grid_; }
+
+const MapRaster& FrenetMap::GetRaster() const { return raster_; }
+
+/**
+ * Select projection engine, finding the closest waypoint of XY->Frenet
+ * projections with the raster (if the map has one) instead of searching
+ */
+void FrenetMap::SetRasterProjection(bool use_raster) {
+  use_raster_ = use_raster;
+}
+
+bool FrenetMap::IsRasterProjection() const {
+  return (use_raster_ && (raster_.cell_wps != NULL));
+}
+
+/**
+ * Get whole waypoint array of a flat map (NULL for a tiled map)
+ */
+const double* FrenetMap::GetFlatArray(MapArray array) const {
+  return flat_arrays_[array];
+}
+
+int FrenetMap::GetNumResidentTiles() const {
+  if (!is_tiled_) { return num_tiles_; }
+  std::lock_guard<std::mutex> lock(tiles_mutex_);
+  return resident_tiles_.size();
+}
+
+/**
+ * Start a new path planning cycle, so tiles used in the last cycle can be
+ * evicted, and evict tiles of a tiled map down to kMapMaxResidentTiles.  Call
+ * only at the start of a path planning cycle when no tile references are held.
+ */
+void FrenetMap::EvictTiles() {
+  
+  ++tile_clock_;
+  
+  if (is_tiled_) {
+    std::lock_guard<std::mutex> lock(tiles_mutex_);
+    EvictOverBudget();
+  }
+}
+
+/**
+ * Evict the least recently used tiles that weren't used in the current cycle
+ * while more than kMapMaxResidentTiles tiles are resident.  Call with
+ * tiles_mutex_ held.
+ *
+ * A tile is unpublished from its slot before checking whether it was used in
+ * this cycle, and GetTile marks a tile as used before reading its slot, so a
+ * tile taken by another thread at the same time is either seen as used (and
+ * put back) or not taken at all.
+ */
+void FrenetMap::EvictOverBudget() const {
+  
+  while (int(resident_tiles_.size()) > kMapMaxResidentTiles) {
+    // Find least recently used tile from an earlier cycle
+    int i_lru = -1;
+    long lru_used = tile_clock_;
+    for (int i = 0; i < int(resident_tiles_.size()); ++i) {
+      const long last_used = tile_slots_[resident_tiles_[i]].last_used.load();
+      if (last_used < lru_used) {
+        i_lru = i;
+        lru_used = last_used;
+      }
+    }
+    if (i_lru < 0) { break; } // all resident tiles used in this cycle
+    
+    TileSlot &slot = tile_slots_[resident_tiles_[i_lru]];
+    slot.tile.store(NULL);
+    if (slot.last_used.load() == tile_clock_) {
+      // Tile was just taken by another thread, so keep it
+      slot.tile.store(slot.owned.get());
+    }
+    else {
+      slot.owned.reset();
+      resident_tiles_.erase(resident_tiles_.begin() + i_lru);
+    }
+  }
+}
+
+/**
+ * Clear all tiles and size the tile slots for num_wps map waypoints
+ */
+void FrenetMap::ResetTiles(int num_wps) {
+  num_wps_ = num_wps;
+  num_tiles_ = (num_wps + kMapTileMask) >> kMapTileShift;
+  tile_slots_.reset(new TileSlot[num_tiles_]);
+  for (int t = 0; t < num_tiles_; ++t) {
+    tile_slots_[t].tile.store(NULL);
+    tile_slots_[t].last_used.store(tile_clock_);
+  }
+  resident_tiles_.clear();
+}
+
+/**
+ * Interpolate a tile of a tiled map from the raw map file rows around it and
+ * make it resident, evicting least recently used tiles if over budget.  Tiles
+ * may be requested from several threads at once, so the tile is built under
+ * lock and published to the tile slot only after it is complete.
+ */
+const MapTile& FrenetMap::BuildTile(int tile_idx) const {
+  
+  std::lock_guard<std::mutex> lock(tiles_mutex_);
+  
+  // Tile may have been built by another thread while waiting for lock
+  TileSlot &slot = tile_slots_[tile_idx];
+  const MapTile *built_tile = slot.tile.load(std::memory_order_acquire);
+  if (built_tile != NULL) { return *built_tile; }
+  
+  std::unique_ptr<MapTile> tile(new MapTile());
+  tile->first_wp = tile_idx << kMapTileShift;
+  tile->num_wps = std::min(1 << kMapTileShift, num_wps_ - tile->first_wp);
+  const int num_tile_wps = tile->num_wps;
+  
+  // Interpolate tile's waypoints with one more on each side for the road
+  // geometry at the ends of the tile
+  std::vector<double> ext[kMapDY + 1];
+  InterpolateRawMap(map_in_, raw_index_, tile->first_wp - 1, num_tile_wps + 2,
+                    num_wps_, s_inc_, max_s_, ext);
+  
+  tile->storage.resize(kNumMapArrays * num_tile_wps);
+  double *tile_arrays[kNumMapArrays];
+  for (int i = 0; i < kNumMapArrays; ++i) {
+    tile_arrays[i] = tile->storage.data() + i * num_tile_wps;
+  }
+  for (int k = kMapS; k <= kMapDY; ++k) {
+    std::copy(ext[k].begin() + 1, ext[k].end() - 1, tile_arrays[k]);
+  }
+  BuildRoadGeometry(ext[kMapX].data(), ext[kMapY].data(), num_tile_wps, s_inc_,
+                    tile_arrays);
+  SetTileArrays(tile_arrays, tile.get());
+  
+  slot.owned = std::move(tile);
+  slot.tile.store(slot.owned.get());
+  resident_tiles_.push_back(tile_idx);
+  EvictOverBudget();
+  
+  return *slot.owned;
+}
+
+/**
+ * Build a uniform grid spatial index over the map points with square cells
+ * of size cell_size.  Each cell holds the indices of the points inside it,
+ * stored in the cell_start and cell_pts tables that the returned grid views.
+ */
+MapGrid BuildMapGrid(const std::vector<double> &pts_x,
+                     const std::vector<double> &pts_y,
+                     double cell_size,
+                     std::vector<int> *cell_start,
+                     std::vector<int> *cell_pts) {
+  
+  MapGrid map_grid;
+  map_grid.cell_size = cell_size;
+  
+  // Set grid bounds from min/max of points
+  const auto x_minmax = std::minmax_element(pts_x.begin(), pts_x.end());
+  const auto y_minmax = std::minmax_element(pts_y.begin(), pts_y.end());
+  map_grid.x_min = *x_minmax.first;
+  map_grid.y_min = *y_minmax.first;
+  map_grid.num_cols = int((*x_minmax.second - map_grid.x_min) / cell_size) + 1;
+  map_grid.num_rows = int((*y_minmax.second - map_grid.y_min) / cell_size) + 1;
+  const int num_cells = map_grid.num_cols * map_grid.num_rows;
+  
+  // Find the cell of each point and count the points in each cell
+  std::vector<int> pt_cell(pts_x.size());
+  std::vector<int> cell_count(num_cells, 0);
+  for (int i = 0; i < int(pts_x.size()); ++i) {
+    const int col = int((pts_x[i] - map_grid.x_min) / cell_size);
+    const int row = int((pts_y[i] - map_grid.y_min) / cell_size);
+    pt_cell[i] = row * map_grid.num_cols + col;
+    cell_count[pt_cell[i]]++;
+  }
+  
+  // Set start offset of each cell's points, with end offset at last cell+1
+  cell_start->resize(num_cells + 1);
+  (*cell_start)[0] = 0;
+  for (int c = 0; c < num_cells; ++c) {
+    (*cell_start)[c+1] = (*cell_start)[c] + cell_count[c];
+  }
+  
+  // Fill point indices into their cells
+  std::vector<int> cell_fill(cell_start->begin(), cell_start->end() - 1);
+  cell_pts->resize(pts_x.size());
+  for (int i = 0; i < int(pts_x.size()); ++i) {
+    (*cell_pts)[cell_fill[pt_cell[i]]++] = i;
+  }
+  
+  map_grid.num_pts = pts_x.size();
+  map_grid.pt_x = pts_x.data();
+  map_grid.pt_y = pts_y.data();
+  map_grid.pt_wp = NULL;
+  map_grid.cell_start = cell_start->data();
+  map_grid.cell_pts = cell_pts->data();
+  
+  return map_grid;
+}
+
+/**
+ * Build a two level XY->Frenet raster over the cells within max_dist of the
+ * map points, with square cells of size cell_size holding the index of the
+ * point closest to the cell's center.  Only blocks with cells within max_dist
+ * of a point are stored, in the block_slots and cell_wps tables that the
+ * returned raster views.
+ */
+MapRaster BuildMapRaster(const std::vector<double> &pts_x,
+                         const std::vector<double> &pts_y,
+                         double cell_size, double max_dist,
+                         std::vector<int> *block_slots,
+                         std::vector<int> *cell_wps) {
+  
+  const int block_shift = kMapRasterBlockShift;
+  const int cell_mask = (1 << block_shift) - 1;
+  
+  MapRaster map_raster;
+  map_raster.cell_size = cell_size;
+  
+  // Set raster bounds from min/max of points, padded by max_dist
+  const auto x_minmax = std::minmax_element(pts_x.begin(), pts_x.end());
+  const auto y_minmax = std::minmax_element(pts_y.begin(), pts_y.end());
+  const double block_size = (1 << block_shift) * cell_size;
+  map_raster.x_min = *x_minmax.first - max_dist;
+  map_raster.y_min = *y_minmax.first - max_dist;
+  map_raster.num_block_cols = int((*x_minmax.second + max_dist
+                                   - map_raster.x_min) / block_size) + 1;
+  map_raster.num_block_rows = int((*y_minmax.second + max_dist
+                                   - map_raster.y_min) / block_size) + 1;
+  const int num_block_cols = map_raster.num_block_cols;
+  
+  // Find the cells in the square within max_dist around point i
+  auto cell_range = [&](int i, int *col_lo, int *col_hi, int *row_lo,
+                        int *row_hi) {
+    *col_lo = int((pts_x[i] - max_dist - map_raster.x_min) / cell_size);
+    *col_hi = int((pts_x[i] + max_dist - map_raster.x_min) / cell_size);
+    *row_lo = int((pts_y[i] - max_dist - map_raster.y_min) / cell_size);
+    *row_hi = int((pts_y[i] + max_dist - map_raster.y_min) / cell_size);
+  };
+  
+  // Mark blocks with cells near any point, then give them slots in order
+  block_slots->assign(num_block_cols * map_raster.num_block_rows, -1);
+  for (int i = 0; i < int(pts_x.size()); ++i) {
+    int col_lo, col_hi, row_lo, row_hi;
+    cell_range(i, &col_lo, &col_hi, &row_lo, &row_hi);
+    for (int j = (row_lo >> block_shift); j <= (row_hi >> block_shift); ++j) {
+      for (int k = (col_lo >> block_shift); k <= (col_hi >> block_shift);
+           ++k) {
+        (*block_slots)[j * num_block_cols + k] = 0;
+      }
+    }
+  }
+  int num_slots = 0;
+  for (int b = 0; b < int(block_slots->size()); ++b) {
+    if ((*block_slots)[b] == 0) { (*block_slots)[b] = num_slots++; }
+  }
+  map_raster.num_slots = num_slots;
+  
+  // Set each cell to the closest point to its center within max_dist
+  cell_wps->assign(num_slots << (2 * block_shift), -1);
+  std::vector<double> cell_dist2(cell_wps->size(), sq(max_dist));
+  for (int i = 0; i < int(pts_x.size()); ++i) {
+    int col_lo, col_hi, row_lo, row_hi;
+    cell_range(i, &col_lo, &col_hi, &row_lo, &row_hi);
+    for (int row = row_lo; row <= row_hi; ++row) {
+      const double dist_y = (map_raster.y_min + (row + 0.5) * cell_size
+                             - pts_y[i]);
+      const int *row_slots = &(*block_slots)[(row >> block_shift)
+                                             * num_block_cols];
+      for (int col = col_lo; col <= col_hi; ++col) {
+        const double dist_x = (map_raster.x_min + (col + 0.5) * cell_size
+                               - pts_x[i]);
+        const double dist2 = sq(dist_x) + sq(dist_y);
+        const int cell = ((row_slots[col >> block_shift] << (2 * block_shift))
+                          + ((row & cell_mask) << block_shift)
+                          + (col & cell_mask));
+        if (dist2 < cell_dist2[cell]) {
+          cell_dist2[cell] = dist2;
+          (*cell_wps)[cell] = i;
+        }
+      }
+    }
+  }
+  
+  map_raster.block_slots = block_slots->data();
+  map_raster.cell_wps = cell_wps->data();
+  
+  return map_raster;
+}
+
+/**
+ * Build the road geometry arrays of num_wps map waypoints spaced every
+ * s_dist_inc in s.  ext_x and ext_y hold the waypoints' (x,y) with one extra
+ * waypoint before and after (num_wps + 2 values), and map_arrays holds the
+ * kNumMapArrays array pointers indexed by MapArray to fill with road geometry.
+ */
+void BuildRoadGeometry(const double *ext_x, const double *ext_y, int num_wps,
+                       double s_dist_inc, double *const *map_arrays) {
+  
+  // Index waypoint i at i+1 so the extra waypoints are at -1 and num_wps
+  const double *map_x = ext_x + 1;
+  const double *map_y = ext_y + 1;
+  double *seg_tan_x = map_arrays[kMapSegTanX];
+  double *seg_tan_y = map_arrays[kMapSegTanY];
+  double *tan_x = map_arrays[kMapTanX];
+  double *tan_y = map_arrays[kMapTanY];
+  double *norm_x = map_arrays[kMapNormX];
+  double *norm_y = map_arrays[kMapNormY];
+  double *curvature = map_arrays[kMapCurvature];
+  
+  // Unit tangent of each segment to the next waypoint, starting from the
+  // segment before waypoint 0
+  const double seg_x_prev = map_x[0] - map_x[-1];
+  const double seg_y_prev = map_y[0] - map_y[-1];
+  const double seg_len_prev = sqrt(sq(seg_x_prev) + sq(seg_y_prev));
+  double seg_tan_x_prev = seg_x_prev / seg_len_prev;
+  double seg_tan_y_prev = seg_y_prev / seg_len_prev;
+  for (int i = 0; i < num_wps; ++i) {
+    const double seg_x = map_x[i+1] - map_x[i];
+    const double seg_y = map_y[i+1] - map_y[i];
+    const double seg_len = sqrt(sq(seg_x) + sq(seg_y));
+    seg_tan_x[i] = seg_x / seg_len;
+    seg_tan_y[i] = seg_y / seg_len;
+  }
+  
+  for (int i = 0; i < num_wps; ++i) {
+    // Averaged heading from the waypoint before to the waypoint after, with
+    // normal rotated -90deg from tangent
+    const double ave_x = map_x[i+1] - map_x[i-1];
+    const double ave_y = map_y[i+1] - map_y[i-1];
+    const double ave_len = sqrt(sq(ave_x) + sq(ave_y));
+    tan_x[i] = ave_x / ave_len;
+    tan_y[i] = ave_y / ave_len;
+    norm_x[i] = tan_y[i];
+    norm_y[i] = -tan_x[i];
+  
+    // Curvature from heading change between the segments before and after,
+    // with sign flipped so bending clockwise (toward +d) is positive
+    const double cross = (seg_tan_x_prev * seg_tan_y[i]
+                          - seg_tan_y_prev * seg_tan_x[i]);
+    const double dot = (seg_tan_x_prev * seg_tan_x[i]
+                        + seg_tan_y_prev * seg_tan_y[i]);
+    curvature[i] = -atan2(cross, dot) / s_dist_inc;
+    seg_tan_x_prev = seg_tan_x[i];
+    seg_tan_y_prev = seg_tan_y[i];
+  }
+}
+
+/**
+ * Storage for a flat Frenet map built from the interpolated map waypoints
+ */
+struct FrenetMapTables {
+  std::vector<double> map_arrays[kNumMapArrays];
+  std::vector<int> cell_start;
+  std::vector<int> cell_pts;
+  std::vector<int> raster_block_slots;
+  std::vector<int> raster_cell_wps;
+};
+
+/**
+ * Build a flat Frenet map from the interpolated map waypoints
+ * [s, x, y, dx, dy] with its road geometry, a map grid index of the
+ * waypoints with cell size cell_size, and an XY->Frenet raster
+ */
+void BuildFrenetMap(const std::vector<std::vector<double>> &waypts_interp,
+                    double s_dist_inc, double max_s, double cell_size,
+                    FrenetMap *frenet_map) {
+  
+  auto tables = std::make_shared<FrenetMapTables>();
+  const int num_wps = waypts_interp[kMapS].size();
+  for (int i = 0; i < kNumMapArrays; ++i) {
+    if (i <= kMapDY) { tables->map_arrays[i] = waypts_interp[i]; }
+    else { tables->map_arrays[i].resize(num_wps); }
+  }
+  
+  // Road geometry with extra waypoints wrapping around the track
+  const std::vector<double> &map_x = tables->map_arrays[kMapX];
+  const std::vector<double> &map_y = tables->map_arrays[kMapY];
+  std::vector<double> ext_x(num_wps + 2);
+  std::vector<double> ext_y(num_wps + 2);
+  ext_x[0] = map_x[num_wps - 1];
+  ext_y[0] = map_y[num_wps - 1];
+  std::copy(map_x.begin(), map_x.end(), ext_x.begin() + 1);
+  std::copy(map_y.begin(), map_y.end(), ext_y.begin() + 1);
+  ext_x[num_wps + 1] = map_x[0];
+  ext_y[num_wps + 1] = map_y[0];
+  double *map_arrays[kNumMapArrays];
+  for (int i = 0; i < kNumMapArrays; ++i) {
+    map_arrays[i] = tables->map_arrays[i].data();
+  }
+  BuildRoadGeometry(ext_x.data(), ext_y.data(), num_wps, s_dist_inc,
+                    map_arrays);
+  
+  const MapGrid map_grid = BuildMapGrid(map_x, map_y, cell_size,
+                                        &tables->cell_start,
+                                        &tables->cell_pts);
+  
+  const MapRaster map_raster = BuildMapRaster(map_x, map_y, kMapRasterCellSize,
+                                              kMapRasterMaxDist,
+                                              &tables->raster_block_slots,
+                                              &tables->raster_cell_wps);
+  
+  frenet_map->SetFlatArrays(map_arrays, num_wps, s_dist_inc, max_s, map_grid,
+                            map_raster, tables);
+}
+
+/**
+ * Storage for a tiled Frenet map's raw map row index and grid index
+ */
+struct RawMapTables {
+  std::vector<double> raw_s;
+  std::vector<double> raw_x;
+  std::vector<double> raw_y;
+  std::vector<int> raw_wp;
+  std::vector<int64_t> raw_row_offset;
+  std::vector<int> cell_start;
+  std::vector<int> cell_pts;
+};
+
+/**
+ * Build a tiled Frenet map from the raw map waypoints' s and (x,y) and the
+ * byte offsets of their rows in the raw map file, with a map grid index of the
+ * raw map waypoints with cells the length of a tile.  Only this index is kept,
+ * and tiles read the raw map file rows they are interpolated from.
+ */
+void BuildTiledFrenetMap(const std::string &map_file,
+                         const std::vector<double> &raw_s,
+                         const std::vector<double> &raw_x,
+                         const std::vector<double> &raw_y,
+                         const std::vector<int64_t> &raw_row_offset,
+                         double s_dist_inc, double max_s,
+                         FrenetMap *frenet_map) {
+  
+  auto tables = std::make_shared<RawMapTables>();
+  tables->raw_s = raw_s;
+  tables->raw_x = raw_x;
+  tables->raw_y = raw_y;
+  tables->raw_row_offset = raw_row_offset;
+  
+  // Map waypoint at each raw waypoint
+  const int num_raw = raw_s.size();
+  const int num_wps = int(ceil(max_s / s_dist_inc));
+  tables->raw_wp.resize(num_raw);
+  for (int k = 0; k < num_raw; ++k) {
+    tables->raw_wp[k] = int(round(raw_s[k] / s_dist_inc)) % num_wps;
+  }
+  
+  MapGrid map_grid = BuildMapGrid(tables->raw_x, tables->raw_y,
+                                  (1 << kMapTileShift) * s_dist_inc,
+                                  &tables->cell_start, &tables->cell_pts);
+  map_grid.pt_wp = tables->raw_wp.data();
+  
+  RawMapIndex raw_index;
+  raw_index.num_raw = num_raw;
+  raw_index.s = tables->raw_s.data();
+  raw_index.x = tables->raw_x.data();
+  raw_index.y = tables->raw_y.data();
+  raw_index.wp = tables->raw_wp.data();
+  raw_index.row_offset = tables->raw_row_offset.data();
+  
+  frenet_map->SetRawMapIndex(map_file, raw_index, s_dist_inc, max_s, map_grid,
+                             tables);
+}
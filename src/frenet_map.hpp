@@ -0,0 +1,247 @@
+//
+//  frenet_map.hpp
+//  Path_Planning
+//
+//  Created by Student on 2/10/18.
+//
+
+#ifndef frenet_map_hpp
+#define frenet_map_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include "path_common.hpp"
+
+/**
+ * Per waypoint arrays of the Frenet map, in the order they are stored in a
+ * compiled map cache file
+ */
+enum MapArray {
+  kMapS = 0,
+  kMapX,
+  kMapY,
+  kMapDX,
+  kMapDY,
+  kMapSegTanX,
+  kMapSegTanY,
+  kMapTanX,
+  kMapTanY,
+  kMapNormX,
+  kMapNormY,
+  kMapCurvature,
+  kNumMapArrays
+};
+
+/**
+ * Uniform grid spatial index of map points for nearest waypoint search.
+ * Point indices are stored per cell in compressed rows, so the points in
+ * cell c are cell_pts[cell_start[c]] to cell_pts[cell_start[c+1]-1].
+ *
+ * For a flat map the points are all of the map waypoints (pt_wp = NULL).  For
+ * a tiled map they are the raw map waypoints, with pt_wp giving the map
+ * waypoint at each one as a starting point to search for the closest one.
+ */
+struct MapGrid {
+  double x_min;
+  double y_min;
+  double cell_size;
+  int num_cols;
+  int num_rows;
+  int num_pts;
+  const double *pt_x;
+  const double *pt_y;
+  const int *pt_wp;
+  const int *cell_start;
+  const int *cell_pts;
+};
+
+/**
+ * Two level raster over the road corridor for constant time XY->Frenet
+ * projection.  Square cells of size cell_size store the closest map waypoint
+ * to the cell's center if it is within kMapRasterMaxDist of the road (-1 if
+ * not).  Cells are grouped into square blocks of 2^kMapRasterBlockShift cells
+ * per side and only blocks near the road are stored, so block_slots gives the
+ * slot of each block's cells in cell_wps (-1 if the block isn't stored).
+ */
+struct MapRaster {
+  double x_min;
+  double y_min;
+  double cell_size;
+  int num_block_cols;
+  int num_block_rows;
+  int num_slots;
+  const int *block_slots;
+  const int *cell_wps;
+};
+
+/**
+ * Index of the raw map file rows (x,y,s,dx,dy per line) of a tiled map.  Per
+ * raw waypoint, stores its s and (x,y) for the map grid and for finding the
+ * raw waypoints to interpolate a tile from, the map waypoint at it, and the
+ * byte offset of its row in the raw map file so a tile only reads and parses
+ * the rows it is interpolated from.
+ */
+struct RawMapIndex {
+  int num_raw;
+  const double *s;
+  const double *x;
+  const double *y;
+  const int *wp;
+  const int64_t *row_offset;
+};
+
+/**
+ * Tile of the Frenet map holding the arrays of 2^kMapTileShift waypoints
+ * (fewer for the last tile) starting at first_wp, indexed by the waypoint's
+ * low bits (wp & kMapTileMask).  Per waypoint, stores:
+ *   s, (x,y), (dx,dy) : interpolated map waypoint
+ *   seg_tan : unit tangent of the segment from waypoint i to i+1
+ *   tan, norm : unit tangent and normal (toward +d) of the averaged heading
+ *               from waypoint i-1 to i+1
+ *   curvature : 1/m, positive when the road bends toward +d
+ */
+struct MapTile {
+  int first_wp;
+  int num_wps;
+  const double *s;
+  const double *x;
+  const double *y;
+  const double *dx;
+  const double *dy;
+  const double *seg_tan_x;
+  const double *seg_tan_y;
+  const double *tan_x;
+  const double *tan_y;
+  const double *norm_x;
+  const double *norm_y;
+  const double *curvature;
+  std::vector<double> storage; // owned arrays of a lazily built tile
+};
+
+/**
+ * Map of the interpolated waypoints spaced every s_inc in Frenet s around a
+ * closed track of length max_s, with their road geometry and a grid index,
+ * shared by all modules by const reference.
+ *
+ * The waypoint arrays are split into fixed length tiles in s.  A flat map
+ * views whole arrays held by the owner handle (tables built from the raw map
+ * or a memory mapped map cache), so all tiles are always resident.  A tiled
+ * map only keeps an index of the raw map file rows (held the same way) and
+ * interpolates each tile on first access from the rows it needs, read from
+ * the raw map file.  Up to kMapMaxResidentTiles tiles are kept resident by
+ * evicting the least recently used ones when a tile is added, but tiles used
+ * in the current path planning cycle are never evicted, so references to
+ * tiles stay valid until the next cycle starts.
+ *
+ * A flat map also has an XY->Frenet raster, used to find the closest waypoint
+ * for projections when raster projection is selected.
+ */
+class FrenetMap {
+public:
+  // Constructor/Destructor
+  FrenetMap();
+  ~FrenetMap();
+  
+  void SetFlatArrays(const double *const *map_arrays, int num_wps,
+                     double s_inc, double max_s, const MapGrid &map_grid,
+                     const MapRaster &map_raster,
+                     std::shared_ptr<const void> owner);
+  void SetRawMapIndex(const std::string &map_file,
+                      const RawMapIndex &raw_index, double s_inc,
+                      double max_s, const MapGrid &map_grid,
+                      std::shared_ptr<const void> owner);
+  bool IsTiled() const;
+  const std::string& GetMapFile() const;
+  const RawMapIndex& GetRawMapIndex() const;
+  int GetNumWaypoints() const;
+  double GetSInc() const;
+  double GetMaxS() const;
+  const MapGrid& GetGrid() const;
+  const MapRaster& GetRaster() const;
+  void SetRasterProjection(bool use_raster);
+  bool IsRasterProjection() const;
+  const double* GetFlatArray(MapArray array) const;
+  int GetNumResidentTiles() const;
+  void EvictTiles();
+  
+  // Tile containing waypoint wp, built on first access.  The tile is marked
+  // as used in this cycle before it is read so that it can't be evicted while
+  // held (see EvictOverBudget)
+  const MapTile& GetTile(int wp) const {
+    TileSlot &slot = tile_slots_[wp >> kMapTileShift];
+    if (slot.last_used.load(std::memory_order_relaxed) != tile_clock_) {
+      slot.last_used.store(tile_clock_);
+    }
+    const MapTile *tile = slot.tile.load();
+    if (tile == NULL) { tile = &BuildTile(wp >> kMapTileShift); }
+    return *tile;
+  }
+  double GetS(int wp) const { return GetTile(wp).s[wp & kMapTileMask]; }
+  double GetX(int wp) const { return GetTile(wp).x[wp & kMapTileMask]; }
+  double GetY(int wp) const { return GetTile(wp).y[wp & kMapTileMask]; }
+  
+private:
+  FrenetMap(const FrenetMap&) = delete;
+  FrenetMap& operator=(const FrenetMap&) = delete;
+  
+  struct TileSlot {
+    std::atomic<const MapTile*> tile;
+    std::atomic<long> last_used;
+    std::unique_ptr<MapTile> owned;
+  };
+  
+  void ResetTiles(int num_wps);
+  const MapTile& BuildTile(int tile_idx) const;
+  void EvictOverBudget() const;
+  
+  int num_wps_;
+  double s_inc_;
+  double max_s_;
+  int num_tiles_;
+  bool is_tiled_;
+  MapGrid grid_;
+  MapRaster raster_;
+  bool use_raster_;
+  const double *flat_arrays_[kNumMapArrays];
+  std::shared_ptr<const void> owner_;
+  std::string map_file_;
+  RawMapIndex raw_index_;
+  mutable std::ifstream map_in_;
+  std::unique_ptr<TileSlot[]> tile_slots_;
+  long tile_clock_;
+  mutable std::vector<int> resident_tiles_;
+  mutable std::mutex tiles_mutex_;
+};
+
+MapGrid BuildMapGrid(const std::vector<double> &pts_x,
+                     const std::vector<double> &pts_y,
+                     double cell_size,
+                     std::vector<int> *cell_start,
+                     std::vector<int> *cell_pts);
+
+MapRaster BuildMapRaster(const std::vector<double> &pts_x,
+                         const std::vector<double> &pts_y,
+                         double cell_size, double max_dist,
+                         std::vector<int> *block_slots,
+                         std::vector<int> *cell_wps);
+
+void BuildRoadGeometry(const double *ext_x, const double *ext_y, int num_wps,
+                       double s_dist_inc, double *const *map_arrays);
+
+void BuildFrenetMap(const std::vector<std::vector<double>> &waypts_interp,
+                    double s_dist_inc, double max_s, double cell_size,
+                    FrenetMap *frenet_map);
+
+void BuildTiledFrenetMap(const std::string &map_file,
+                         const std::vector<double> &raw_s,
+                         const std::vector<double> &raw_x,
+                         const std::vector<double> &raw_y,
+                         const std::vector<int64_t> &raw_row_offset,
+                         double s_dist_inc, double max_s,
+                         FrenetMap *frenet_map);
+
+#endif /* frenet_map_hpp */
@@ -10,11 +10,14 @@
 #include "json.hpp"
 
 #include "path_common.hpp"
+#include "frenet_map.hpp"
+#include "map_cache.hpp"
 #include "vehicle.hpp"
 #include "sensor_fusion.hpp"
 #include "prediction.hpp"
 #include "behavior.hpp"
 #include "trajectory.hpp"
+#include "occupancy_grid.hpp"
 
 // for convenience
 using json = nlohmann::json;
@@ -39,7 +42,7 @@ std::string hasData(std::string s) {
 /**
  * Debug print output of the road lanes with detected vehicle positions
  */
-void DebugPrintRoad(const std::map<int, DetectedVehicle> &detected_cars,
+void DebugPrintRoad(const DetectedVehicleTable &detected_cars,
                     const EgoVehicle &ego_car) {
 
   std::cout << std::endl;
@@ -55,14 +58,16 @@ void DebugPrintRoad(const std::map<int, DetectedVehicle> &detected_cars,
       }
       else {
         // Find detected cars at this lane position (10m blocks)
-        for (auto it = detected_cars.begin(); it != detected_cars.end(); ++it) {
-          if ((it->second.GetRelS() <= i+4) && (it->second.GetRelS() > i-6)
-              && (it->second.GetLane() == j_lane)) {
-            if (it->second.GetID() < 10) { // pad single digit ID with leading 0
-              lane_mark = "0" + std::to_string(it->second.GetID());
+        for (int idx = 0; idx < detected_cars.Size(); ++idx) {
+          const double rel_s = detected_cars.GetRelS(idx);
+          const int car_id = detected_cars.GetID(idx);
+          if ((rel_s <= i+4) && (rel_s > i-6)
+              && (detected_cars.GetLane(idx) == j_lane)) {
+            if (car_id < 10) { // pad single digit ID with leading 0
+              lane_mark = "0" + std::to_string(car_id);
             }
             else {
-              lane_mark = std::to_string(it->second.GetID());
+              lane_mark = std::to_string(car_id);
             }
           }
         }
@@ -81,62 +86,109 @@ void DebugPrintRoad(const std::map<int, DetectedVehicle> &detected_cars,
  * vehicles, process it using a Path Planner and send resulting path (x,y)
  * coordinates back to the simulator for the car to follow.
  */
-int main() {
+int main(int argc, char *argv[]) {
   uWS::Hub h;
 
-  // Load up raw map values for waypoints (x,y,s,dx,dy)
-  std::vector<double> map_x_raw;
-  std::vector<double> map_y_raw;
-  std::vector<double> map_s_raw;
-  std::vector<double> map_dx_raw;
-  std::vector<double> map_dy_raw;
-  std::string map_file_ = "../data/highway_map.csv"; // for cmake in 'build/'
+  // Find raw map file of waypoints (x,y,s,dx,dy) and its compiled map cache
+  std::string map_file_ = "../data/highway_map.csv"; // for cmake in 'build/'
   std::ifstream in_map_(map_file_.c_str(), std::ifstream::in);
   if (!in_map_) {
     map_file_ = "../../data/highway_map.csv"; // for Xcode in 'xbuild/Debug/'
     in_map_.clear();
     in_map_.open(map_file_.c_str(), std::ifstream::in);
-  }
-  std::string line;
-  while (getline(in_map_, line)) {
-  	std::istringstream iss(line);
-  	double x;
-  	double y;
-  	float s;
-  	float d_x;
-  	float d_y;
-  	iss >> x;
-  	iss >> y;
-  	iss >> s;
-  	iss >> d_x;
-  	iss >> d_y;
-  	map_x_raw.push_back(x);
-  	map_y_raw.push_back(y);
-  	map_s_raw.push_back(s);
-  	map_dx_raw.push_back(d_x);
-  	map_dy_raw.push_back(d_y);
+  }
+  const std::string map_cache_file = GetMapCacheFile(map_file_);
+  const MapSourceStamp map_stamp = GetMapSourceStamp(map_file_);
+  
+  // Load Frenet map of interpolated map waypoints, road geometry table and map
+  // grid index from the compiled map cache, or compile it from the raw map if
+  // the cache is missing or stale compared to the raw map file
+  FrenetMap frenet_map;
+  if (!LoadMapCache(map_cache_file, map_file_, map_stamp, &frenet_map)) {
+    // Load up raw map values for waypoints (x,y,s,dx,dy) and the byte offset
+    // of each one's row in the map file
+    std::vector<double> map_x_raw;
+    std::vector<double> map_y_raw;
+    std::vector<double> map_s_raw;
+    std::vector<double> map_dx_raw;
+    std::vector<double> map_dy_raw;
+    std::vector<int64_t> map_row_offset_raw;
+    std::string line;
+    int64_t row_offset = in_map_.tellg();
+    while (getline(in_map_, line)) {
+      std::istringstream iss(line);
+      double x;
+      double y;
+      float s;
+      float d_x;
+      float d_y;
+      iss >> x;
+      iss >> y;
+      iss >> s;
+      iss >> d_x;
+      iss >> d_y;
+      map_x_raw.push_back(x);
+      map_y_raw.push_back(y);
+      map_s_raw.push_back(s);
+      map_dx_raw.push_back(d_x);
+      map_dy_raw.push_back(d_y);
+      map_row_offset_raw.push_back(row_offset);
+      row_offset = in_map_.tellg();
+    }
+    
+    const double max_s = GetTrackLength(map_s_raw, map_x_raw, map_y_raw);
+    
+    if (max_s > kMapMaxFlatLength) {
+      // Long map, only keep an index of the raw map rows and interpolate map
+      // tiles from the rows around them on first access
+      BuildTiledFrenetMap(map_file_, map_s_raw, map_x_raw, map_y_raw,
+                          map_row_offset_raw, kMapInterpInc, max_s,
+                          &frenet_map);
+    }
+    else {
+      // Reinterpolate map waypoints for higher precision
+      auto waypts_interp = InterpolateMap(map_s_raw, map_x_raw, map_y_raw,
+                                          map_dx_raw, map_dy_raw,
+                                          kMapInterpInc, max_s);
+      
+      // Build Frenet map with road geometry table of interpolated waypoints
+      // for (s,d)->(x,y) and grid index for nearest waypoint search
+      BuildFrenetMap(waypts_interp, kMapInterpInc, max_s, kMapGridCellSize,
+                     &frenet_map);
+    }
+      
+    // Compile map cache to be memory mapped on the next startup
+    WriteMapCache(map_cache_file, map_stamp, frenet_map);
   }
   
-  // Reinterpolate map waypoints for higher precision
-  auto waypts_interp = InterpolateMap(map_s_raw, map_x_raw, map_y_raw,
-                                      map_dx_raw, map_dy_raw, kMapInterpInc);
+  // Select XY->Frenet projection engine, using the raster lookup if started
+  // with option "--frenet-raster" or the waypoint search by default
+  bool use_frenet_raster = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--frenet-raster") { use_frenet_raster = true; }
+  }
+  frenet_map.SetRasterProjection(use_frenet_raster);
   
   // Debug logging
   if (kDBGMain == 2) {
     std::cout << "** Map interpolation for s, x, y, dx, dy **" << std::endl;
-    for (int i = 0; i < waypts_interp.size(); ++i) {
+    for (int i = kMapS; i <= kMapDY; ++i) {
       std::cout << "Map " << i << ":" << std::endl;
-      for (int j = 0; j < waypts_interp[i].size(); ++j) {
-        std::cout << waypts_interp[i][j] << std::endl;
+      for (int j = 0; j < frenet_map.GetNumWaypoints(); ++j) {
+        const MapTile &tile = frenet_map.GetTile(j);
+        const double *map_interp[] = {tile.s, tile.x, tile.y, tile.dx, tile.dy};
+        std::cout << map_interp[i][j & kMapTileMask] << std::endl;
       }
       std::cout << std::endl;
     }
   }
   
-  // Instantiate ego car object and map of detected cars to hold their data
+  // Instantiate ego car object and table of detected cars to hold their data
   EgoVehicle ego_car = EgoVehicle();
   ego_car.SetID(-1);
-  std::map<int, DetectedVehicle> detected_cars;
+  DetectedVehicleTable detected_cars;
+  LaneIndex car_ids_by_lane;
+  OccupancyGrid occupancy_grid;
   long int loop = 0; // debug loop counter
   auto t_last = std::chrono::time_point_cast<std::chrono::milliseconds>
                 (std::chrono::high_resolution_clock::now())
@@ -145,7 +197,8 @@ int main() {
   /**
    * Loop on communication message with simulator
    */
-  h.onMessage([&loop, &t_last, &waypts_interp, &ego_car, &detected_cars]
+  h.onMessage([&loop, &t_last, &frenet_map, &ego_car, &detected_cars,
+               &car_ids_by_lane, &occupancy_grid]
               (uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length,
                      uWS::OpCode opCode) {
                 
@@ -189,13 +242,6 @@ int main() {
           // List of detected cars on same side of road
           const auto sensor_fusion = j[1]["sensor_fusion"];
           
-          // Interpolated map waypoints
-          std::vector<double> map_interp_s = waypts_interp[0];
-          std::vector<double> map_interp_x = waypts_interp[1];
-          std::vector<double> map_interp_y = waypts_interp[2];
-          std::vector<double> map_interp_dx = waypts_interp[3];
-          std::vector<double> map_interp_dy = waypts_interp[4];
-          
           // DEBUG Log raw car (x,y) values at every communication cycle
           if (kDBGMain == 3) {
             std::cout << "t: " << t_msg << ", x: " << car_x
@@ -216,6 +262,12 @@ int main() {
             t_last = t_msg;
             loop++;
             
+            // Release map tiles that are no longer near the cars
+            frenet_map.EvictTiles();
+            
+            // Release last cycle's trajectory data all at once
+            GetCycleArena().Reset();
+            
             /**
              * Sensor Fusion
              *   1. Process prev ego path to determine where ego car is now
@@ -224,35 +276,34 @@ int main() {
              *   4. Group detected car ID's by lane # for easier lookups
              *
              * Output:
-             *   prev_ego_traj : ego's previous full trajectory
              *   idx_current_pt : index of where ego car is now in prev traj
              *   ego_car : ego car object updated with current state
-             *   detected_cars : updated detected cars (key=ID, val=det car obj)
-             *   car_ids_by_lane : grouped ID's (key=lane #, val=det car ID's)
+             *   detected_cars : updated detected cars table
+             *   car_ids_by_lane : det car ID's grouped by lane # and sorted
              */
             
-            // Store prev ego traj and find current idx from prev processed path
-            VehTrajectory prev_ego_traj = ego_car.GetTraj();
+            // Find current idx in ego's prev traj from prev processed path
             const int prev_path_size = previous_path_x.size();
-            const int idx_current_pt = GetCurrentTrajIndex(prev_ego_traj,
+            const int idx_current_pt = GetCurrentTrajIndex(ego_car.GetTraj(),
                                                            prev_path_size);
             
-            // Process ego car's state
+            // Process ego car's state from its prev traj (before it's trimmed
+            // in place below)
+            int ego_wp_hint = ego_car.GetWaypointHint();
             VehState new_ego_state = ProcessEgoState(car_x, car_y,
                                                      idx_current_pt,
-                                                     prev_ego_traj,
-                                                     map_interp_s,
-                                                     map_interp_x,
-                                                     map_interp_y);
+                                                     ego_car.GetTraj(),
+                                                     frenet_map,
+                                                     &ego_wp_hint);
             ego_car.UpdateState(new_ego_state);
+            ego_car.SetWaypointHint(ego_wp_hint);
             
-            // Process detected cars' states (updates detected_cars map by ptr)
-            ProcessDetectedCars(ego_car, sensor_fusion, map_interp_s,
-                                map_interp_x, map_interp_y, map_interp_dx,
-                                map_interp_dy, &detected_cars);
+            // Process detected cars' states (updates detected_cars by ptr)
+            ProcessDetectedCars(ego_car, sensor_fusion, frenet_map,
+                                &detected_cars);
             
-            // Group detected car id's in a map by lane #
-            auto car_ids_by_lane = SortDetectedCarsByLane(detected_cars);
+            // Group detected car id's by lane # (updates car_ids_by_lane)
+            SortDetectedCarsByLane(ego_car, detected_cars, &car_ids_by_lane);
             
             /**
              * Prediction
@@ -264,9 +315,9 @@ int main() {
              */
             
             // Generate trajectory predictions for all detected cars (updates
-            //   detected_cars map by ptr)
-            PredictBehavior(ego_car, car_ids_by_lane, map_interp_s,
-                            map_interp_x, map_interp_y, &detected_cars);
+            //   detected_cars table by ptr)
+            PredictBehavior(ego_car, car_ids_by_lane, frenet_map,
+                            &detected_cars);
             
             /**
              * Behavior Planning
@@ -306,28 +357,41 @@ int main() {
             /**
              * Trajectory Generation
              *   1. Keep some of prev path as a buffer to start the next traj
-             *   2. Generate a new ego car path trajectory to achieve the
+             *   2. Build occupancy grid of detected cars' predicted trajs
+             *      over the new traj's risk time windows as a broad phase
+             *      of the collision risk checks
+             *   3. Generate a new ego car path trajectory to achieve the
              *      target behavior
-             *   3. Append the new traj after the prev path buffer
+             *   4. Append the new traj after the prev path buffer
              *
              * Output:
              *   ego_car.traj_ : Final trajectory for ego car
              */
             
             // Keep some buffer traj from prev path to start the next path
-            ego_car.ClearTraj();
-            auto buff_traj = GetBufferTrajectory(idx_current_pt, prev_ego_traj);
-            ego_car.SetTraj(buff_traj);
+            // (trims ego's traj in place, so it's only the buffer now)
+            ego_car.TrimTrajToBuffer(idx_current_pt);
+            
+            // Build occupancy grid from predicted trajs (updates
+            //   occupancy_grid, starting after the prev path buffer)
+            occupancy_grid.Update(ego_car, detected_cars,
+                                  frenet_map.GetMaxS());
             
             // Generate new ego car traj from target behavior
+            int num_pruned_trajs;
             VehTrajectory new_traj = GetEgoTrajectory(ego_car, detected_cars,
                                                       car_ids_by_lane,
-                                                      map_interp_s,
-                                                      map_interp_x,
-                                                      map_interp_y);
+                                                      occupancy_grid,
+                                                      frenet_map,
+                                                      &num_pruned_trajs);
             
-            // Append new traj after prev path buffer
-            ego_car.AppendTraj(new_traj);
+            // Append new traj after prev path buffer (written at ring tail)
+            const int num_appended = ego_car.AppendTraj(new_traj);
+            if (num_appended < int(new_traj.states.size())) {
+              std::cerr << "Ego traj full, dropped "
+                        << (int(new_traj.states.size()) - num_appended)
+                        << " new states" << std::endl;
+            }
             
             /**
              * Control
@@ -342,10 +406,12 @@ int main() {
             // Pack path vectors of x and y coordinates
             std::vector<double> next_x_vals;
             std::vector<double> next_y_vals;
-            const VehTrajectory ego_traj = ego_car.GetTraj();
-            for (int i = 0; i < ego_traj.states.size(); ++i) {
-              next_x_vals.push_back(ego_traj.states[i].x);
-              next_y_vals.push_back(ego_traj.states[i].y);
+            const TrajRingBuffer &ego_traj = ego_car.GetTraj();
+            next_x_vals.reserve(ego_traj.Size());
+            next_y_vals.reserve(ego_traj.Size());
+            for (int i = 0; i < ego_traj.Size(); ++i) {
+              next_x_vals.push_back(ego_traj[i].x);
+              next_y_vals.push_back(ego_traj[i].y);
             }
             
             // Output path vectors to JSON message
@@ -376,8 +442,8 @@ int main() {
             }
             else if ((kDBGMain == 2) || (kDBGMain == 3)) {
               // Detailed telemetry output
-              const VehState ego_state = ego_car.GetState();
-              const VehTrajectory ego_traj = ego_car.GetTraj();
+              const VehState &ego_state = ego_car.GetState();
+              const TrajRingBuffer &ego_traj = ego_car.GetTraj();
               std::cout << loop << ", t: " << t_msg
               << ", num_prev_path: " << previous_path_x.size()
               << ", idx_current_pt: " << idx_current_pt
@@ -390,12 +456,12 @@ int main() {
               << ", d_dot: " << ego_state.d_dot
               << ", d_dotdot: " << ego_state.d_dotdot;
               std::cout << ", traj_x: ";
-              for (int i = 0; i < ego_traj.states.size(); ++i) {
-                std::cout << ego_traj.states[i].x << ";";
+              for (int i = 0; i < ego_traj.Size(); ++i) {
+                std::cout << ego_traj[i].x << ";";
               }
               std::cout << ", traj_y: ";
-              for (int i = 0; i < ego_traj.states.size(); ++i) {
-                std::cout << ego_traj.states[i].y << ";";
+              for (int i = 0; i < ego_traj.Size(); ++i) {
+                std::cout << ego_traj[i].y << ";";
               }
               std::cout << ", prev_path_x: ";
               for (int i = 0; i < previous_path_x.size(); ++i) {
@@ -406,12 +472,12 @@ int main() {
                 std::cout << previous_path_y[i] << ";";
               }
               std::cout << ", traj_s: ";
-              for (int i = 0; i < ego_traj.states.size(); ++i) {
-                std::cout << ego_traj.states[i].s << ";";
+              for (int i = 0; i < ego_traj.Size(); ++i) {
+                std::cout << ego_traj[i].s << ";";
               }
               std::cout << ", traj_d: ";
-              for (int i = 0; i < ego_traj.states.size(); ++i) {
-                std::cout << ego_traj.states[i].d << ";";
+              for (int i = 0; i < ego_traj.Size(); ++i) {
+                std::cout << ego_traj[i].d << ";";
               }
               std::cout << std::endl;
             }
@@ -0,0 +1,478 @@
+//
+//  map_cache.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/8/18.
+//
+
+#include "map_cache.hpp"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static_assert(sizeof(int) == sizeof(int32_t), "map cache stores int32 cells");
+static_assert(sizeof(MapCacheHeader) % sizeof(int64_t) == 0,
+              "map cache arrays after header are 8 byte aligned");
+
+// Raw map arrays s, x, y of a tiled map cache, indexed by MapArray
+static const int kNumRawArrays = kMapY + 1;
+
+static const char kMapCacheMagic[8] = "PPMAPC";
+
+/**
+ * Total file size expected for a map cache with the given header counts
+ */
+static int64_t MapCacheFileSize(const MapCacheHeader &header) {
+  const int64_t num_cells = (int64_t(header.grid_num_cols)
+                             * header.grid_num_rows);
+  const int64_t num_raster_blocks = (int64_t(header.raster_num_block_cols)
+                                     * header.raster_num_block_rows);
+  const int64_t num_raster_cells = (int64_t(header.raster_num_slots)
+                                    << (2 * header.raster_block_shift));
+  const int64_t waypoint_size = (header.is_tiled
+      ? (int64_t(header.num_raw) * (kNumRawArrays * sizeof(double)
+                                    + sizeof(int64_t) + sizeof(int32_t)))
+      : (int64_t(kNumMapArrays) * header.num_wps * sizeof(double)));
+  return (int64_t(sizeof(MapCacheHeader))
+          + waypoint_size
+          + (num_cells + 1 + header.num_cell_wps) * sizeof(int32_t)
+          + (num_raster_blocks + num_raster_cells) * sizeof(int32_t));
+}
+
+/**
+ * Check that every grid and raster index in the map cache is in range, so a
+ * corrupted cache that passes the header checks can't index outside of the
+ * waypoint arrays or the cell tables.  Grid cell starts must run from 0 to
+ * the number of cell waypoints without decreasing, cell waypoints must be
+ * valid waypoints (raw waypoints for a tiled map), and raster entries must be
+ * valid slots/waypoints or -1.  A tiled map's raw waypoints must also be in
+ * order of s, at valid map waypoints, and at increasing rows of the source
+ * map file.
+ */
+static bool IsMapCacheIndexValid(const MapCache &map_cache) {
+  
+  const MapCacheHeader &header = map_cache.GetHeader();
+  const int num_pts = header.is_tiled ? header.num_raw : header.num_wps;
+  const int64_t num_cells = (int64_t(header.grid_num_cols)
+                             * header.grid_num_rows);
+  const int64_t num_raster_blocks = (int64_t(header.raster_num_block_cols)
+                                     * header.raster_num_block_rows);
+  const int64_t num_raster_cells = (int64_t(header.raster_num_slots)
+                                    << (2 * header.raster_block_shift));
+  
+  // Grid cell start offsets into the cell waypoints
+  const int *cell_start = map_cache.GetCellStart();
+  if ((cell_start[0] != 0) || (cell_start[num_cells] != header.num_cell_wps)) {
+    return false;
+  }
+  for (int64_t i = 0; i < num_cells; ++i) {
+    if (cell_start[i + 1] < cell_start[i]) { return false; }
+  }
+  
+  // Grid cell waypoints
+  const int *cell_wps = map_cache.GetCellWps();
+  for (int64_t i = 0; i < header.num_cell_wps; ++i) {
+    if ((cell_wps[i] < 0) || (cell_wps[i] >= num_pts)) { return false; }
+  }
+  
+  // Raw waypoints of a tiled map
+  if (header.is_tiled) {
+    const double *raw_s = map_cache.GetRawArray(kMapS);
+    const int64_t *row_offset = map_cache.GetRawRowOffset();
+    const int *raw_wps = map_cache.GetRawWps();
+    for (int i = 0; i < header.num_raw; ++i) {
+      if (!(raw_s[i] >= 0.) || !(raw_s[i] < header.max_s)
+          || ((i > 0) && !(raw_s[i] >= raw_s[i-1]))
+          || (raw_wps[i] < 0) || (raw_wps[i] >= header.num_wps)
+          || (row_offset[i] < 0) || (row_offset[i] >= header.src_size)
+          || ((i > 0) && (row_offset[i] <= row_offset[i-1]))) {
+        return false;
+      }
+    }
+  }
+  
+  // Raster block slots (-1 for blocks with no cells near the road)
+  const int *block_slots = map_cache.GetRasterBlockSlots();
+  for (int64_t i = 0; i < num_raster_blocks; ++i) {
+    if ((block_slots[i] < -1) || (block_slots[i] >= header.raster_num_slots)) {
+      return false;
+    }
+  }
+  
+  // Raster cell waypoints (-1 for cells too far from the road)
+  const int *raster_cell_wps = map_cache.GetRasterCellWps();
+  for (int64_t i = 0; i < num_raster_cells; ++i) {
+    if ((raster_cell_wps[i] < -1) || (raster_cell_wps[i] >= header.num_wps)) {
+      return false;
+    }
+  }
+  
+  return true;
+}
+
+/**
+ * MapCache constructor/destructor
+ */
+MapCache::MapCache() : data_(NULL), size_(0) {}
+
+MapCache::~MapCache() {
+  Close();
+}
+
+/**
+ * Memory map a compiled map cache file read-only and check its header.
+ * Return false if the file can't be mapped or isn't a valid map cache.
+ */
+bool MapCache::Open(const std::string &cache_file) {
+  Close();
+  
+  const int fd = open(cache_file.c_str(), O_RDONLY);
+  if (fd < 0) { return false; }
+  
+  struct stat file_stat;
+  if ((fstat(fd, &file_stat) != 0)
+      || (file_stat.st_size < int64_t(sizeof(MapCacheHeader)))) {
+    close(fd);
+    return false;
+  }
+  
+  // Mapping stays valid after closing the file descriptor
+  void *data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) { return false; }
+  data_ = data;
+  size_ = file_stat.st_size;
+  
+  // Check format version and that the array sizes match the file size
+  // (tiled maps index the raw waypoints in the grid and have no raster)
+  const MapCacheHeader &header = GetHeader();
+  const bool is_valid_flat = ((header.is_tiled == 0)
+                              && (header.num_raw == 0)
+                              && (header.num_cell_wps == header.num_wps)
+                              && (header.raster_num_block_cols > 0)
+                              && (header.raster_num_block_rows > 0)
+                              && (header.raster_num_slots >= 0));
+  const bool is_valid_tiled = ((header.is_tiled == 1)
+                               && (header.num_raw > 1)
+                               && (header.num_cell_wps == header.num_raw)
+                               && (header.raster_num_block_cols == 0)
+                               && (header.raster_num_block_rows == 0)
+                               && (header.raster_num_slots == 0));
+  const bool is_valid = ((memcmp(header.magic, kMapCacheMagic,
+                                 sizeof(kMapCacheMagic)) == 0)
+                         && (header.version == kMapCacheVersion)
+                         && (header.num_wps > 1)
+                         && (header.grid_num_cols > 0)
+                         && (header.grid_num_rows > 0)
+                         && (is_valid_flat || is_valid_tiled)
+                         && (header.raster_block_shift == kMapRasterBlockShift)
+                         && (header.file_size == int64_t(size_))
+                         && (MapCacheFileSize(header) == int64_t(size_)));
+  if (!is_valid) {
+    Close();
+    return false;
+  }
+  
+  return true;
+}
+
+void MapCache::Close() {
+  if (data_ != NULL) {
+    munmap(data_, size_);
+  }
+  data_ = NULL;
+  size_ = 0;
+}
+
+bool MapCache::IsOpen() const { return (data_ != NULL); }
+
+const MapCacheHeader& MapCache::GetHeader() const {
+  return *static_cast<const MapCacheHeader*>(data_);
+}
+
+/**
+ * Get a waypoint array of a flat map cache
+ */
+const double* MapCache::GetArray(MapArray array) const {
+  const char *arrays_start = (static_cast<const char*>(data_)
+                              + sizeof(MapCacheHeader));
+  return (reinterpret_cast<const double*>(arrays_start)
+          + int64_t(array) * GetHeader().num_wps);
+}
+
+/**
+ * Get the raw waypoint s, x or y array, raw map file row offsets and map
+ * waypoints at the raw waypoints of a tiled map cache
+ */
+const double* MapCache::GetRawArray(MapArray array) const {
+  const char *arrays_start = (static_cast<const char*>(data_)
+                              + sizeof(MapCacheHeader));
+  return (reinterpret_cast<const double*>(arrays_start)
+          + int64_t(array) * GetHeader().num_raw);
+}
+
+const int64_t* MapCache::GetRawRowOffset() const {
+  const double *raw_arrays_end = GetRawArray(MapArray(kNumRawArrays));
+  return reinterpret_cast<const int64_t*>(raw_arrays_end);
+}
+
+const int* MapCache::GetRawWps() const {
+  return reinterpret_cast<const int*>(GetRawRowOffset() + GetHeader().num_raw);
+}
+
+const int* MapCache::GetCellStart() const {
+  if (GetHeader().is_tiled) {
+    return GetRawWps() + GetHeader().num_raw;
+  }
+  return reinterpret_cast<const int*>(GetArray(kNumMapArrays));
+}
+
+const int* MapCache::GetCellWps() const {
+  const MapCacheHeader &header = GetHeader();
+  return (GetCellStart() + int64_t(header.grid_num_cols) * header.grid_num_rows
+          + 1);
+}
+
+const int* MapCache::GetRasterBlockSlots() const {
+  return GetCellWps() + GetHeader().num_cell_wps;
+}
+
+const int* MapCache::GetRasterCellWps() const {
+  const MapCacheHeader &header = GetHeader();
+  return (GetRasterBlockSlots() + (int64_t(header.raster_num_block_cols)
+                                   * header.raster_num_block_rows));
+}
+
+/**
+ * Get size and modification time of the source map file
+ */
+MapSourceStamp GetMapSourceStamp(const std::string &map_file) {
+  MapSourceStamp src_stamp = {-1, -1};
+  struct stat file_stat;
+  if (stat(map_file.c_str(), &file_stat) == 0) {
+    src_stamp.size = file_stat.st_size;
+    src_stamp.mtime = file_stat.st_mtime;
+  }
+  return src_stamp;
+}
+
+/**
+ * Get the compiled map cache file name next to the source map file, with the
+ * file extension replaced by ".bin"
+ */
+std::string GetMapCacheFile(const std::string &map_file) {
+  const size_t idx_ext = map_file.find_last_of('.');
+  const size_t idx_dir = map_file.find_last_of('/');
+  if ((idx_ext == std::string::npos)
+      || ((idx_dir != std::string::npos) && (idx_ext < idx_dir))) {
+    return map_file + ".bin";
+  }
+  return map_file.substr(0, idx_ext) + ".bin";
+}
+
+/**
+ * Compile a flat Frenet map's waypoint and road geometry arrays, map grid
+ * index and XY->Frenet raster into a map cache file, or a tiled Frenet map's
+ * raw map row index and map grid index.  The file is written to a temporary
+ * name first and then renamed, so other planner processes never map a
+ * partially written cache.
+ */
+bool WriteMapCache(const std::string &cache_file,
+                   const MapSourceStamp &src_stamp,
+                   const FrenetMap &frenet_map) {
+  
+  const bool is_tiled = frenet_map.IsTiled();
+  const RawMapIndex &raw_index = frenet_map.GetRawMapIndex();
+  const int num_wps = frenet_map.GetNumWaypoints();
+  const MapGrid &map_grid = frenet_map.GetGrid();
+  const MapRaster &map_raster = frenet_map.GetRaster();
+  
+  // Pack header
+  MapCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMapCacheMagic, sizeof(kMapCacheMagic));
+  header.version = kMapCacheVersion;
+  header.num_wps = num_wps;
+  header.is_tiled = is_tiled ? 1 : 0;
+  header.num_raw = is_tiled ? raw_index.num_raw : 0;
+  header.src_size = src_stamp.size;
+  header.src_mtime = src_stamp.mtime;
+  header.s_inc = frenet_map.GetSInc();
+  header.max_s = frenet_map.GetMaxS();
+  header.grid_cell_size = map_grid.cell_size;
+  header.grid_x_min = map_grid.x_min;
+  header.grid_y_min = map_grid.y_min;
+  header.grid_num_cols = map_grid.num_cols;
+  header.grid_num_rows = map_grid.num_rows;
+  header.num_cell_wps = map_grid.num_pts;
+  header.raster_cell_size = kMapRasterCellSize;
+  header.raster_max_dist = kMapRasterMaxDist;
+  header.raster_x_min = map_raster.x_min;
+  header.raster_y_min = map_raster.y_min;
+  header.raster_block_shift = kMapRasterBlockShift;
+  header.raster_num_block_cols = map_raster.num_block_cols;
+  header.raster_num_block_rows = map_raster.num_block_rows;
+  header.raster_num_slots = map_raster.num_slots;
+  header.file_size = MapCacheFileSize(header);
+  const int num_cell_start = map_grid.num_cols * map_grid.num_rows + 1;
+  const int num_raster_blocks = (map_raster.num_block_cols
+                                 * map_raster.num_block_rows);
+  const int num_raster_cells = (map_raster.num_slots
+                                << (2 * kMapRasterBlockShift));
+  
+  // Double arrays in MapArray order (raw s, x, y for a tiled map)
+  const int num_arrays = is_tiled ? kNumRawArrays : kNumMapArrays;
+  const int num_array_pts = is_tiled ? raw_index.num_raw : num_wps;
+  const double *map_arrays[kNumMapArrays];
+  for (int i = 0; i < kNumMapArrays; ++i) {
+    map_arrays[i] = frenet_map.GetFlatArray(MapArray(i));
+  }
+  if (is_tiled) {
+    map_arrays[kMapS] = raw_index.s;
+    map_arrays[kMapX] = raw_index.x;
+    map_arrays[kMapY] = raw_index.y;
+  }
+  
+  // Write to temporary file
+  const std::string tmp_file = cache_file + ".tmp" + std::to_string(getpid());
+  FILE *fp = fopen(tmp_file.c_str(), "wb");
+  if (fp == NULL) {
+    std::cerr << "Could not write map cache " << tmp_file << std::endl;
+    return false;
+  }
+  bool is_written = (fwrite(&header, sizeof(header), 1, fp) == 1);
+  for (int i = 0; i < num_arrays; ++i) {
+    is_written = is_written && (fwrite(map_arrays[i], sizeof(double),
+                                       num_array_pts, fp)
+                                == size_t(num_array_pts));
+  }
+  if (is_tiled) {
+    is_written = is_written && (fwrite(raw_index.row_offset, sizeof(int64_t),
+                                       raw_index.num_raw, fp)
+                                == size_t(raw_index.num_raw));
+    is_written = is_written && (fwrite(raw_index.wp, sizeof(int),
+                                       raw_index.num_raw, fp)
+                                == size_t(raw_index.num_raw));
+  }
+  is_written = is_written && (fwrite(map_grid.cell_start, sizeof(int),
+                                     num_cell_start, fp)
+                              == size_t(num_cell_start));
+  is_written = is_written && (fwrite(map_grid.cell_pts, sizeof(int),
+                                     map_grid.num_pts, fp)
+                              == size_t(map_grid.num_pts));
+  is_written = is_written && (fwrite(map_raster.block_slots, sizeof(int),
+                                     num_raster_blocks, fp)
+                              == size_t(num_raster_blocks));
+  is_written = is_written && (fwrite(map_raster.cell_wps, sizeof(int),
+                                     num_raster_cells, fp)
+                              == size_t(num_raster_cells));
+  is_written = (fclose(fp) == 0) && is_written;
+  
+  // Replace cache file
+  if (!is_written || (rename(tmp_file.c_str(), cache_file.c_str()) != 0)) {
+    std::cerr << "Could not write map cache " << cache_file << std::endl;
+    remove(tmp_file.c_str());
+    return false;
+  }
+  
+  return true;
+}
+
+/**
+ * Load the Frenet map from a map cache file, with the map arrays (or a tiled
+ * map's raw map row index) viewing the read-only memory mapping directly (no
+ * copies) and the mapping kept open by the Frenet map's owner handle.  Return
+ * false if the cache is missing, invalid (including any out of range grid,
+ * raster or raw map row index), was compiled with different map parameters,
+ * or is stale compared to the source map file map_file (skipped for a flat
+ * map if the source map isn't found, but a tiled map reads its tiles from
+ * it), so the caller falls back to building the map from the source map file.
+ */
+bool LoadMapCache(const std::string &cache_file,
+                  const std::string &map_file,
+                  const MapSourceStamp &src_stamp,
+                  FrenetMap *frenet_map) {
+  
+  auto map_cache = std::make_shared<MapCache>();
+  if (!map_cache->Open(cache_file)) { return false; }
+  
+  const MapCacheHeader &header = map_cache->GetHeader();
+  const double grid_cell_size = (header.is_tiled
+                                 ? (1 << kMapTileShift) * kMapInterpInc
+                                 : kMapGridCellSize);
+  if ((header.s_inc != kMapInterpInc)
+      || (header.grid_cell_size != grid_cell_size)
+      || (header.raster_cell_size != kMapRasterCellSize)
+      || (header.raster_max_dist != kMapRasterMaxDist)) {
+    return false;
+  }
+  if ((header.is_tiled || (src_stamp.size >= 0))
+      && ((header.src_size != src_stamp.size)
+          || (header.src_mtime != src_stamp.mtime))) {
+    return false;
+  }
+  if (!(header.max_s > 0.) || !IsMapCacheIndexValid(*map_cache)) {
+    std::cerr << "Invalid map cache " << cache_file << std::endl;
+    return false;
+  }
+  
+  // Set raw map row index and grid views into mapped file for a tiled map
+  if (header.is_tiled) {
+    RawMapIndex raw_index;
+    raw_index.num_raw = header.num_raw;
+    raw_index.s = map_cache->GetRawArray(kMapS);
+    raw_index.x = map_cache->GetRawArray(kMapX);
+    raw_index.y = map_cache->GetRawArray(kMapY);
+    raw_index.wp = map_cache->GetRawWps();
+    raw_index.row_offset = map_cache->GetRawRowOffset();
+    MapGrid map_grid;
+    map_grid.x_min = header.grid_x_min;
+    map_grid.y_min = header.grid_y_min;
+    map_grid.cell_size = header.grid_cell_size;
+    map_grid.num_cols = header.grid_num_cols;
+    map_grid.num_rows = header.grid_num_rows;
+    map_grid.num_pts = header.num_raw;
+    map_grid.pt_x = raw_index.x;
+    map_grid.pt_y = raw_index.y;
+    map_grid.pt_wp = raw_index.wp;
+    map_grid.cell_start = map_cache->GetCellStart();
+    map_grid.cell_pts = map_cache->GetCellWps();
+    frenet_map->SetRawMapIndex(map_file, raw_index, header.s_inc,
+                               header.max_s, map_grid, map_cache);
+    return true;
+  }
+  
+  // Set map array, grid and raster views into mapped file
+  const double *map_arrays[kNumMapArrays];
+  for (int i = 0; i < kNumMapArrays; ++i) {
+    map_arrays[i] = map_cache->GetArray(MapArray(i));
+  }
+  MapGrid map_grid;
+  map_grid.x_min = header.grid_x_min;
+  map_grid.y_min = header.grid_y_min;
+  map_grid.cell_size = header.grid_cell_size;
+  map_grid.num_cols = header.grid_num_cols;
+  map_grid.num_rows = header.grid_num_rows;
+  map_grid.num_pts = header.num_wps;
+  map_grid.pt_x = map_arrays[kMapX];
+  map_grid.pt_y = map_arrays[kMapY];
+  map_grid.pt_wp = NULL;
+  map_grid.cell_start = map_cache->GetCellStart();
+  map_grid.cell_pts = map_cache->GetCellWps();
+  MapRaster map_raster;
+  map_raster.x_min = header.raster_x_min;
+  map_raster.y_min = header.raster_y_min;
+  map_raster.cell_size = header.raster_cell_size;
+  map_raster.num_block_cols = header.raster_num_block_cols;
+  map_raster.num_block_rows = header.raster_num_block_rows;
+  map_raster.num_slots = header.raster_num_slots;
+  map_raster.block_slots = map_cache->GetRasterBlockSlots();
+  map_raster.cell_wps = map_cache->GetRasterCellWps();
+  
+  frenet_map->SetFlatArrays(map_arrays, header.num_wps, header.s_inc,
+                            header.max_s, map_grid, map_raster, map_cache);
+  
+  return true;
+}
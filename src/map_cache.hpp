@@ -0,0 +1,120 @@
+//
+//  map_cache.hpp
+//  Path_Planning
+//
+//  Created by Student on 2/8/18.
+//
+
+#ifndef map_cache_hpp
+#define map_cache_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "path_common.hpp"
+#include "frenet_map.hpp"
+
+/**
+ * Compiled map cache file layout of a flat map (is_tiled = 0):
+ *   MapCacheHeader
+ *   double arrays [num_wps] in MapArray order
+ *   int32 cell_start [grid_num_cols * grid_num_rows + 1]
+ *   int32 cell_wps [num_cell_wps]
+ *   int32 raster_block_slots [raster_num_block_cols * raster_num_block_rows]
+ *   int32 raster_cell_wps [raster_num_slots * 2^(2 * kMapRasterBlockShift)]
+ *
+ * and of a tiled map (is_tiled = 1), which has no raster:
+ *   MapCacheHeader
+ *   double raw s, x, y arrays [num_raw]
+ *   int64 raw_row_offset [num_raw]
+ *   int32 raw_wp [num_raw]
+ *   int32 cell_start [grid_num_cols * grid_num_rows + 1]
+ *   int32 cell_raw_pts [num_cell_wps]
+ *
+ * The header records the cache format version, the size and modification
+ * time of the source map file, and the map build parameters so a stale cache
+ * is detected and recompiled.
+ */
+struct MapCacheHeader {
+  char magic[8];
+  int32_t version;
+  int32_t num_wps;
+  int32_t is_tiled;
+  int32_t num_raw;
+  int64_t src_size;
+  int64_t src_mtime;
+  double s_inc;
+  double max_s;
+  double grid_cell_size;
+  double grid_x_min;
+  double grid_y_min;
+  int32_t grid_num_cols;
+  int32_t grid_num_rows;
+  int64_t num_cell_wps;
+  double raster_cell_size;
+  double raster_max_dist;
+  double raster_x_min;
+  double raster_y_min;
+  int32_t raster_block_shift;
+  int32_t raster_num_block_cols;
+  int32_t raster_num_block_rows;
+  int32_t raster_num_slots;
+  int64_t file_size;
+};
+
+/**
+ * Size and modification time of the source map file, used to detect a stale
+ * map cache (size = -1 if the source map file could not be found)
+ */
+struct MapSourceStamp {
+  int64_t size;
+  int64_t mtime;
+};
+
+/**
+ * Read-only memory mapping of a compiled map cache file.  The mapping is
+ * released when the object is destroyed, so it can't be copied and is shared
+ * as the owner of the Frenet map arrays that view it.
+ */
+class MapCache {
+public:
+  // Constructor/Destructor
+  MapCache();
+  ~MapCache();
+  
+  bool Open(const std::string &cache_file);
+  void Close();
+  bool IsOpen() const;
+  const MapCacheHeader& GetHeader() const;
+  const double* GetArray(MapArray array) const;
+  const double* GetRawArray(MapArray array) const;
+  const int64_t* GetRawRowOffset() const;
+  const int* GetRawWps() const;
+  const int* GetCellStart() const;
+  const int* GetCellWps() const;
+  const int* GetRasterBlockSlots() const;
+  const int* GetRasterCellWps() const;
+  
+private:
+  MapCache(const MapCache&) = delete;
+  MapCache& operator=(const MapCache&) = delete;
+  
+  void *data_;
+  size_t size_;
+};
+
+MapSourceStamp GetMapSourceStamp(const std::string &map_file);
+
+std::string GetMapCacheFile(const std::string &map_file);
+
+bool WriteMapCache(const std::string &cache_file,
+                   const MapSourceStamp &src_stamp,
+                   const FrenetMap &frenet_map);
+
+bool LoadMapCache(const std::string &cache_file,
+                  const std::string &map_file,
+                  const MapSourceStamp &src_stamp,
+                  FrenetMap *frenet_map);
+
+#endif /* map_cache_hpp */
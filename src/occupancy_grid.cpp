@@ -0,0 +1,191 @@
+//
+//  occupancy_grid.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/13/18.
+//
+
+#include "occupancy_grid.hpp"
+
+// Constructor/Destructor
+OccupancyGrid::OccupancyGrid() : num_layers_(0), t_start_(0.), ref_s_(0.),
+                                 max_s_(0.) { }
+OccupancyGrid::~OccupancyGrid() { }
+
+/**
+ * Member data accessors
+ */
+int OccupancyGrid::GetNumLayers() const { return num_layers_; }
+
+/**
+ * Get s relative to the ego car's s when the grid was updated, wrapping
+ * around the end of the track
+ */
+double OccupancyGrid::GetRelS(double s) const {
+  double rel_s = s - ref_s_;
+  if (rel_s > 0.5*max_s_) { rel_s -= max_s_; }
+  else if (rel_s < -0.5*max_s_) { rel_s += max_s_; }
+  return rel_s;
+}
+
+/**
+ * Get the cell index of a relative s, clamped to the grid's edge cells
+ */
+int OccupancyGrid::GetCellS(double rel_s) const {
+  const double cell_s = std::floor((rel_s + kOccGridBehind) / kOccGridCellS);
+  return int(std::min(std::max(cell_s, 0.), double(kNumCellsS - 1)));
+}
+
+/**
+ * Get the cell index of a d, clamped to the grid's edge cells
+ */
+int OccupancyGrid::GetCellD(double d) const {
+  const double cell_d = std::floor((d + kCollisionDThresh) / kOccGridCellD);
+  return int(std::min(std::max(cell_d, 0.), double(kNumCellsD - 1)));
+}
+
+/**
+ * Check if no predicted path could be within the collision thresholds of any
+ * point in the box [min_rel_s, max_rel_s] x [min_d, max_d] during the time
+ * window of a grid layer.  Windows past the last layer have no predicted
+ * paths left and are always clear.
+ */
+bool OccupancyGrid::IsClear(int idx_layer, double min_rel_s, double max_rel_s,
+                            double min_d, double max_d) const {
+  
+  if (idx_layer >= num_layers_) { return true; }
+  
+  const int lo_s = GetCellS(min_rel_s);
+  const int hi_s = GetCellS(max_rel_s);
+  const int lo_d = GetCellD(min_d);
+  const int hi_d = GetCellD(max_d);
+  
+  // Sum over cells [lo, hi] from the layer's summed-area table
+  const int stride = kNumCellsD + 1;
+  const int *sums = &sums_[idx_layer * kLayerSize];
+  return ((sums[(hi_s+1)*stride + (hi_d+1)] - sums[lo_s*stride + (hi_d+1)]
+           - sums[(hi_s+1)*stride + lo_d] + sums[lo_s*stride + lo_d]) == 0);
+}
+
+/**
+ * Check if no predicted path could be within the collision thresholds of a new
+ * ego traj between t_begin and t_end (from the start of the traj) of a grid
+ * layer's window, from the Bernstein bounds of the traj's polys over that
+ * time
+ */
+bool OccupancyGrid::IsTrajWindowClear(const VehTrajectory &traj,
+                                      int idx_layer, double t_begin,
+                                      double t_end) const {
+  
+  Poly<5> rel_s = (t_begin > 0.) ? traj.poly_s.Shift(t_begin) : traj.poly_s;
+  const Poly<5> path_d = (t_begin > 0.) ? traj.poly_d.Shift(t_begin)
+                                        : traj.poly_d;
+  rel_s.a[0] = GetRelS(rel_s.a[0]);
+  double min_s, max_s;
+  double min_d, max_d;
+  rel_s.GetBounds(t_end - t_begin, &min_s, &max_s);
+  path_d.GetBounds(t_end - t_begin, &min_d, &max_d);
+  return IsClear(idx_layer, min_s, max_s, min_d, max_d);
+}
+
+/**
+ * Rebuild the grid from the detected cars' predicted trajectories for the
+ * ego car's current state and prev path buffer (must be called after the ego
+ * trajectory is trimmed to its buffer).  Each predicted path's bounds over a
+ * layer's window, expanded by the collision thresholds, are added to the
+ * layer's cells as corners of a 2D difference table, which is accumulated
+ * once into cell counts and once more into the summed-area table.
+ */
+void OccupancyGrid::Update(const EgoVehicle &ego_car,
+                           const DetectedVehicleTable &detected_cars,
+                           double max_s) {
+  
+  ref_s_ = ego_car.GetState().s;
+  max_s_ = max_s;
+  
+  // Predicted trajs start now and new ego traj starts after the buffer
+  t_start_ = ego_car.GetTraj().Size() * kSimCycleTime;
+  double t_pred_end = 0.;
+  for (int idx = 0; idx < detected_cars.Size(); ++idx) {
+    const PredTrajectories &pred_trajs = detected_cars.GetCar(idx)
+                                           .GetPredTrajs();
+    for (int i = 0; i < pred_trajs.size; ++i) {
+      t_pred_end = std::max(t_pred_end, pred_trajs.trajs[i].t_end - t_start_);
+    }
+  }
+  num_layers_ = 0;
+  for (double t_begin = 0., t_window = kEvalRiskWindowTime;
+       t_begin < t_pred_end; t_begin += t_window, t_window *= 2.) {
+    num_layers_++;
+  }
+  
+  // Storage is kept between cycles and only grows
+  if (int(sums_.size()) < num_layers_ * kLayerSize) {
+    sums_.resize(num_layers_ * kLayerSize);
+  }
+  std::fill(sums_.begin(), sums_.begin() + num_layers_ * kLayerSize, 0);
+  
+  // Mark each predicted path's box of cells in each layer, with cell (i,j)
+  // at (i+1,j+1) to leave a zero row and column for the summed-area table
+  const int stride = kNumCellsD + 1;
+  for (int idx = 0; idx < detected_cars.Size(); ++idx) {
+    const PredTrajectories &pred_trajs = detected_cars.GetCar(idx)
+                                           .GetPredTrajs();
+    for (int i = 0; i < pred_trajs.size; ++i) {
+      const PredTrajectory &car_traj = pred_trajs.trajs[i];
+      
+      double t_begin = 0.;
+      double t_window = kEvalRiskWindowTime;
+      for (int l = 0; l < num_layers_; ++l) {
+        const double t_end = std::min(t_begin + t_window,
+                                      car_traj.t_end - t_start_);
+        if (t_end <= t_begin) { break; }
+        
+        Poly<5> rel_s = car_traj.s.Shift(t_start_ + t_begin);
+        const Poly<5> path_d = car_traj.d.Shift(t_start_ + t_begin);
+        rel_s.a[0] = GetRelS(rel_s.a[0]);
+        double min_s, max_s_path;
+        double min_d, max_d;
+        rel_s.GetBounds(t_end - t_begin, &min_s, &max_s_path);
+        path_d.GetBounds(t_end - t_begin, &min_d, &max_d);
+        const int lo_s = GetCellS(min_s - kCollisionSThresh);
+        const int hi_s = GetCellS(max_s_path + kCollisionSThresh);
+        const int lo_d = GetCellD(min_d - kCollisionDThresh);
+        const int hi_d = GetCellD(max_d + kCollisionDThresh);
+        
+        // Corners past the last cell would only affect cells beyond the grid
+        int *diffs = &sums_[l * kLayerSize];
+        diffs[(lo_s+1)*stride + (lo_d+1)] += 1;
+        if (hi_d + 1 < kNumCellsD) {
+          diffs[(lo_s+1)*stride + (hi_d+2)] -= 1;
+        }
+        if (hi_s + 1 < kNumCellsS) {
+          diffs[(hi_s+2)*stride + (lo_d+1)] -= 1;
+          if (hi_d + 1 < kNumCellsD) {
+            diffs[(hi_s+2)*stride + (hi_d+2)] += 1;
+          }
+        }
+        
+        t_begin += t_window;
+        t_window *= 2.;
+      }
+    }
+  }
+  
+  // Accumulate each layer twice (differences -> counts -> summed-area table),
+  // row by row as a running sum across d plus the previous row's sums
+  for (int l = 0; l < num_layers_; ++l) {
+    int *sums = &sums_[l * kLayerSize];
+    for (int pass = 0; pass < 2; ++pass) {
+      for (int i = 1; i <= kNumCellsS; ++i) {
+        int *row = &sums[i*stride];
+        const int *prev_row = &sums[(i-1)*stride];
+        int row_sum = 0;
+        for (int j = 1; j <= kNumCellsD; ++j) {
+          row_sum += row[j];
+          row[j] = row_sum + prev_row[j];
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,60 @@
+//
+//  occupancy_grid.hpp
+//  Path_Planning
+//
+//  Created by Student on 2/13/18.
+//
+
+#ifndef occupancy_grid_hpp
+#define occupancy_grid_hpp
+
+#include <stdio.h>
+#include "vehicle.hpp"
+
+/**
+ * Space-time occupancy grid of the detected cars' predicted trajectories,
+ * built once per cycle as the broad phase of the collision risk checks of all
+ * candidate ego trajectories.  Each layer is one of EvalTrajCost's risk time
+ * windows of the new ego trajectory (starting at kEvalRiskWindowTime after
+ * the ego's prev path buffer and doubling), with cells over s relative to the
+ * ego car and d.  Each cell holds the number of predicted paths that could be
+ * within kCollisionSThresh and kCollisionDThresh of a point in it during the
+ * window, from the Bernstein bounds of the paths' polys over the window, and
+ * the layers are stored as summed-area tables so any box of cells is checked
+ * with 4 lookups.  Positions beyond the grid's range are clamped to its edge
+ * cells, so a box is never reported clear when a path could be near it.
+ */
+class OccupancyGrid {
+public:
+  // Constructor/Destructor
+  OccupancyGrid();
+  ~OccupancyGrid();
+  
+  int GetNumLayers() const;
+  bool IsClear(int idx_layer, double min_rel_s, double max_rel_s,
+               double min_d, double max_d) const;
+  bool IsTrajWindowClear(const VehTrajectory &traj, int idx_layer,
+                         double t_begin, double t_end) const;
+  void Update(const EgoVehicle &ego_car,
+              const DetectedVehicleTable &detected_cars, double max_s);
+
+private:
+  static constexpr int kNumCellsS = int((kOccGridBehind + kOccGridAhead)
+                                        / kOccGridCellS);
+  static constexpr int kNumCellsD = int((kNumLanes * kLaneWidth
+                                         + 2 * kCollisionDThresh)
+                                        / kOccGridCellD);
+  static constexpr int kLayerSize = (kNumCellsS + 1) * (kNumCellsD + 1);
+  
+  int GetCellS(double rel_s) const;
+  int GetCellD(double d) const;
+  double GetRelS(double s) const;
+  
+  int num_layers_;
+  double t_start_;
+  double ref_s_;
+  double max_s_;
+  std::vector<int> sums_;
+};
+
+#endif /* occupancy_grid_hpp */
@@ -6,6 +6,15 @@
 //
 
 #include "path_common.hpp"
+#include "frenet_map.hpp"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 /**
  * Calculate Cartesian distance between two (x,y) points
@@ -22,10 +31,11 @@ std::vector<std::vector<double>> InterpolateMap(std::vector<double> map_s,
                                                 std::vector<double> map_y,
                                                 std::vector<double> map_dx,
                                                 std::vector<double> map_dy,
-                                                double s_dist_inc) {
+                                                double s_dist_inc,
+                                                double max_s) {
   
   // Add initial map point back to end of map points for wrap-around
-  map_s.push_back(kMaxS);
+  map_s.push_back(max_s);
   map_x.push_back(map_x[0]);
   map_y.push_back(map_y[0]);
   map_dx.push_back(map_dx[0]);
@@ -47,7 +57,7 @@ std::vector<std::vector<double>> InterpolateMap(std::vector<double> map_s,
   std::vector<double> interp_y;
   std::vector<double> interp_dx;
   std::vector<double> interp_dy;
-  for (double s=0.; s < kMaxS; s = s + s_dist_inc) {
+  for (double s=0.; s < max_s; s = s + s_dist_inc) {
     interp_s.push_back(s);
     interp_x.push_back(spline_s_x(s));
     interp_y.push_back(spline_s_y(s));
@@ -59,19 +69,32 @@ std::vector<std::vector<double>> InterpolateMap(std::vector<double> map_s,
 }
 
 /**
- * Find closest waypoint ahead or behind
+ * Calculate track length from the raw map waypoints as the s of the last
+ * waypoint plus the distance from it back to the first waypoint, where s
+ * wraps back to 0
+ */
+double GetTrackLength(const std::vector<double> &map_s,
+                      const std::vector<double> &map_x,
+                      const std::vector<double> &map_y) {
+  return (map_s.back() + Distance(map_x.back(), map_y.back(),
+                                  map_x.front(), map_y.front()));
+}
+
+/**
+ * Find closest point ahead or behind
  *
- * Note: This is not efficient, might be improved by k-d tree search
+ * Note: This is a linear search over all points, only used as fallback for
+ *       positions outside of the map grid index
  */
-int ClosestWaypoint(double x, double y, const std::vector<double> &map_x,
-                    const std::vector<double> &map_y) {
+int ClosestWaypoint(double x, double y, const double *pts_x,
+                    const double *pts_y, int num_pts) {
   
   double closestLen = std::numeric_limits<double>::max(); //large number
   int closestWaypoint = 0;
   
-  for (int i = 0; i < map_x.size(); ++i) {
-    double wp_x = map_x[i];
-    double wp_y = map_y[i];
+  for (int i = 0; i < num_pts; ++i) {
+    double wp_x = pts_x[i];
+    double wp_y = pts_y[i];
     double dist = Distance(x,y,wp_x,wp_y);
     if (dist < closestLen) {
       closestLen = dist;
@@ -83,196 +106,1002 @@ int ClosestWaypoint(double x, double y, const std::vector<double> &map_x,
 }
 
 /**
- * Transform from Frenet (s,d) coordinates to Cartesian (x,y)
+ * Step from waypoint *wp in the direction of decreasing distance to (x,y),
+ * for up to max_steps waypoints.  Update *wp and its squared distance
+ * *wp_dist2 to the closest waypoint found and return the # of steps taken.
  */
-std::vector<double> GetHiResXY(double s, double d,
-                               const std::vector<double> &map_s,
-                               const std::vector<double> &map_x,
-                               const std::vector<double> &map_y) {
+static int DescendToClosestWaypoint(double x, double y, int max_steps,
+                                    const FrenetMap &frenet_map,
+                                    int *wp, double *wp_dist2) {
   
-  // Wrap around s
-  s = std::fmod(s, kMaxS);
+  const int num_wps = frenet_map.GetNumWaypoints();
+  int closest_wp = *wp;
+  double closest_dist2 = (sq(frenet_map.GetX(closest_wp) - x)
+                          + sq(frenet_map.GetY(closest_wp) - y));
+  
+  // Step forward while waypoints get closer, then backward if none did
+  int steps = 0;
+  for (int step_dir = 1; step_dir >= -1; step_dir -= 2) {
+    while (steps < max_steps) {
+      const int next_wp = (closest_wp + step_dir + num_wps) % num_wps;
+      const double next_dist2 = (sq(frenet_map.GetX(next_wp) - x)
+                                 + sq(frenet_map.GetY(next_wp) - y));
+      if (next_dist2 >= closest_dist2) { break; }
+      closest_wp = next_wp;
+      closest_dist2 = next_dist2;
+      steps++;
+    }
+    if (steps > 0) { break; }
+  }
+  
+  *wp = closest_wp;
+  *wp_dist2 = closest_dist2;
+  return steps;
+}
 
-  // Find 2 waypoints before s and 2 waypoints after s for angular interpolation
-  auto it_wp1_search = std::lower_bound(map_s.begin(), map_s.end(), s);
-  int wp1 = (it_wp1_search - map_s.begin() - 1); // wp before s
-  int wp2 = (wp1 + 1) % map_s.size(); // wp after s
-  int wp3 = (wp2 + 1) % map_s.size(); // wp 2nd after s
-  int wp0 = wp1 - 1; // wp 2nd before s
-  if (wp0 < 0) { wp0 = map_s.size() - 1; } // wrap around backwards
+/**
+ * Search rings of map grid cells outward from the cell (col,row) containing
+ * (x,y) until the closest point found is nearer than any cell in the next ring
+ * could be.  Cells farther than sqrt(max_dist2) from (x,y) are skipped and the
+ * search ends once the rings cover that distance.  Returns the closest point
+ * (-1 if none found) and its squared distance in *closest_dist2.
+ */
+static int SearchMapGridRings(double x, double y, int col, int row,
+                              const MapGrid &map_grid, double max_dist2,
+                              double *closest_dist2) {
+  
+  const double cell_size = map_grid.cell_size;
+  int closest_pt = -1;
+  *closest_dist2 = std::numeric_limits<double>::max();
+  
+  const int max_ring = std::max(map_grid.num_cols, map_grid.num_rows);
+  for (int ring = 0; ring <= max_ring; ++ring) {
+    // Check cells on the border of the square ring around (col,row)
+    for (int j = row - ring; j <= row + ring; ++j) {
+      if ((j < 0) || (j >= map_grid.num_rows)) { continue; }
+      const bool edge_row = ((j == row - ring) || (j == row + ring));
+      const int i_step = edge_row ? 1 : 2*ring;
+      const double cell_y = map_grid.y_min + j * cell_size;
+      const double dy = std::max(0., std::max(cell_y - y,
+                                              y - (cell_y + cell_size)));
+      for (int i = col - ring; i <= col + ring; i += i_step) {
+        if ((i < 0) || (i >= map_grid.num_cols)) { continue; }
+        const double cell_x = map_grid.x_min + i * cell_size;
+        const double dx = std::max(0., std::max(cell_x - x,
+                                                x - (cell_x + cell_size)));
+        if (sq(dx) + sq(dy) > max_dist2) { continue; }
+        const int cell = j * map_grid.num_cols + i;
+        for (int k = map_grid.cell_start[cell];
+             k < map_grid.cell_start[cell+1]; ++k) {
+          const int pt = map_grid.cell_pts[k];
+          const double dist2 = (sq(map_grid.pt_x[pt] - x)
+                                + sq(map_grid.pt_y[pt] - y));
+          if (dist2 < *closest_dist2) {
+            *closest_dist2 = dist2;
+            closest_pt = pt;
+          }
+        }
+      }
+    }
+    
+    // Cells in the next ring are at least ring * cell_size away from (x,y)
+    const double ring_dist2 = sq(ring * cell_size);
+    if (((closest_pt >= 0) && (*closest_dist2 <= ring_dist2))
+        || (max_dist2 <= ring_dist2)) {
+      break;
+    }
+  }
+  
+  return closest_pt;
+}
 
-  // Use angle between wp1-wp2 to derive segment vector at distance s from wp1
-  double theta_wp = atan2((map_y[wp2] - map_y[wp1]),
-                          (map_x[wp2] - map_x[wp1]));
+/**
+ * Find closest waypoint ahead or behind using the map grid index.  Search
+ * rings of cells outward from the cell containing (x,y) until the closest
+ * point found is nearer than any cell in the next ring could be.  For a tiled
+ * map the grid points are the raw map waypoints, so the closest map waypoint
+ * is found by stepping from the one at the closest raw waypoint.
+ */
+int ClosestWaypoint(double x, double y, const FrenetMap &frenet_map) {
   
-  // The (x,y,s) along the segment vector between wp1 and wp2
-  double seg_s = s - map_s[wp1];
-  double seg_x = map_x[wp1] + seg_s * cos(theta_wp);
-  double seg_y = map_y[wp1] + seg_s * sin(theta_wp);
+  const MapGrid &map_grid = frenet_map.GetGrid();
+  const int col = int(floor((x - map_grid.x_min) / map_grid.cell_size));
+  const int row = int(floor((y - map_grid.y_min) / map_grid.cell_size));
+  
+  double closest_dist2 = std::numeric_limits<double>::max();
+  int closest_pt = -1;
+  
+  if ((col < 0) || (col >= map_grid.num_cols)
+      || (row < 0) || (row >= map_grid.num_rows)) {
+    // Position outside of grid, fall back to linear search
+    closest_pt = ClosestWaypoint(x, y, map_grid.pt_x, map_grid.pt_y,
+                                 map_grid.num_pts);
+  }
+  else {
+    closest_pt = SearchMapGridRings(x, y, col, row, map_grid,
+                                    std::numeric_limits<double>::max(),
+                                    &closest_dist2);
+  }
+  
+  // Grid points are the map waypoints
+  if (map_grid.pt_wp == NULL) { return closest_pt; }
+  
+  // Grid points are raw map waypoints, step to closest map waypoint
+  int closest_wp = map_grid.pt_wp[closest_pt];
+  DescendToClosestWaypoint(x, y, frenet_map.GetNumWaypoints(), frenet_map,
+                           &closest_wp, &closest_dist2);
+  
+  return closest_wp;
+}
 
-  // Interpolate theta at s based on the distance between wp1 (with ave angle
-  // from wp0 before and wp2 after) and wp2 (with ave angle from wp1 before
-  // and wp3 after)
-  double theta_wp1ave = atan2((map_y[wp2] - map_y[wp0]),
-                              (map_x[wp2] - map_x[wp0]));
+/**
+ * Look up the closest waypoint to (x,y) in the cell of the Frenet map's
+ * XY->Frenet raster containing it, in constant time regardless of map length.
+ * Returns -1 if the map has no raster or (x,y) is too far from the road to be
+ * in the raster, so the caller can fall back to a search.
+ */
+int RasterWaypoint(double x, double y, const FrenetMap &frenet_map) {
   
-  double theta_wp2ave = atan2((map_y[wp3] - map_y[wp1]),
-                              (map_x[wp3] - map_x[wp1]));
+  const MapRaster &map_raster = frenet_map.GetRaster();
+  if (map_raster.cell_wps == NULL) { return -1; }
   
-  double s_interp = (s - map_s[wp1]) / (map_s[wp2] - map_s[wp1]);
+  const int col = int(floor((x - map_raster.x_min) / map_raster.cell_size));
+  const int row = int(floor((y - map_raster.y_min) / map_raster.cell_size));
+  if ((col < 0) || (row < 0)) { return -1; }
+  const int block_col = (col >> kMapRasterBlockShift);
+  const int block_row = (row >> kMapRasterBlockShift);
+  if ((block_col >= map_raster.num_block_cols)
+      || (block_row >= map_raster.num_block_rows)) {
+    return -1;
+  }
   
-  double cos_interp = ((1-s_interp) * cos(theta_wp1ave)
-                         + s_interp * cos(theta_wp2ave));
+  const int slot = map_raster.block_slots[block_row * map_raster.num_block_cols
+                                          + block_col];
+  if (slot < 0) { return -1; }
+  const int cell_mask = (1 << kMapRasterBlockShift) - 1;
+  return map_raster.cell_wps[(slot << (2 * kMapRasterBlockShift))
+                             + ((row & cell_mask) << kMapRasterBlockShift)
+                             + (col & cell_mask)];
+}
+
+/**
+ * Find the same closest waypoint as ClosestWaypoint, using the distance to a
+ * seed waypoint near (x,y) (e.g. from the XY->Frenet raster) as an upper bound
+ * so grid cells farther than the seed are skipped.  A tiled map's grid points
+ * are raw map waypoints that the bound doesn't apply to, so it does a plain
+ * ClosestWaypoint search.
+ */
+int ClosestWaypointFromSeed(double x, double y, int seed_wp,
+                            const FrenetMap &frenet_map) {
   
-  double sin_interp = ((1-s_interp) * sin(theta_wp1ave)
-                         + s_interp * sin(theta_wp2ave));
+  const MapGrid &map_grid = frenet_map.GetGrid();
+  const int col = int(floor((x - map_grid.x_min) / map_grid.cell_size));
+  const int row = int(floor((y - map_grid.y_min) / map_grid.cell_size));
+  if ((map_grid.pt_wp != NULL) || (col < 0) || (col >= map_grid.num_cols)
+      || (row < 0) || (row >= map_grid.num_rows)) {
+    return ClosestWaypoint(x, y, frenet_map);
+  }
   
-  double theta_interp = atan2(sin_interp, cos_interp);
+  const double seed_dist2 = (sq(map_grid.pt_x[seed_wp] - x)
+                             + sq(map_grid.pt_y[seed_wp] - y));
+  double closest_dist2;
+  const int closest_wp = SearchMapGridRings(x, y, col, row, map_grid,
+                                            seed_dist2, &closest_dist2);
   
-  // Use interpolated theta to calculate final (x,y) at d offset from the
+  // Seed's own cell can only be skipped by rounding of the cell bounds
+  if ((closest_wp < 0) || (closest_dist2 > seed_dist2)) { return seed_wp; }
+  return closest_wp;
+}
+
+/**
+ * Find closest waypoint by searching from a hint waypoint (the closest waypoint
+ * from the last search) in the direction of decreasing distance, within a
+ * window of kWaypointHintWindow waypoints.  Returns -1 if the search reaches
+ * the end of the window or the waypoint found is too far away from (x,y) to
+ * be trusted, so the caller can fall back to a global search.
+ */
+int ClosestWaypointNearHint(double x, double y, int wp_hint,
+                            const FrenetMap &frenet_map) {
+  
+  if ((wp_hint < 0) || (wp_hint >= frenet_map.GetNumWaypoints())) {
+    return -1;
+  }
+  
+  int closest_wp = wp_hint;
+  double closest_dist2;
+  const int steps = DescendToClosestWaypoint(x, y, kWaypointHintWindow,
+                                             frenet_map, &closest_wp,
+                                             &closest_dist2);
+  
+  // Residual check, fail if search ran out of window or ended too far away
+  if ((steps >= kWaypointHintWindow)
+      || (closest_dist2 > sq(kWaypointHintMaxDist))) {
+    return -1;
+  }
+  
+  return closest_wp;
+}
+
+/**
+ * Transform from Frenet (s,d) coordinates to Cartesian (x,y)
+ */
+std::vector<double> GetHiResXY(double s, double d,
+                               const FrenetMap &frenet_map) {
+  
+  const double max_s = frenet_map.GetMaxS();
+  const double s_inc = frenet_map.GetSInc();
+  
+  // Wrap around s
+  if ((s < 0.) || (s >= max_s)) {
+    s -= floor(s / max_s) * max_s;
+  }
+  
+  // Index waypoint before s (wp1) and after s (wp2) directly from uniform s
+  // spacing, where the last segment wraps back to wp 0 with a shorter length
+  const int last_wp = frenet_map.GetNumWaypoints() - 1;
+  const int wp1 = std::min(int(s / s_inc), last_wp);
+  const int wp2 = (wp1 < last_wp) ? (wp1 + 1) : 0;
+  const double s_wp1 = wp1 * s_inc;
+  const double seg_len = (wp1 < last_wp) ? s_inc : (max_s - s_wp1);
+  
+  // Map tiles of wp1 and wp2, which are only different if wp2 starts a tile
+  const MapTile &tile1 = frenet_map.GetTile(wp1);
+  const MapTile &tile2 = ((wp2 & kMapTileMask) != 0) ? tile1
+                                                     : frenet_map.GetTile(wp2);
+  const int i1 = wp1 & kMapTileMask;
+  const int i2 = wp2 & kMapTileMask;
+  
+  // The (x,y,s) along the segment vector between wp1 and wp2
+  const double seg_s = s - s_wp1;
+  const double seg_x = tile1.x[i1] + seg_s * tile1.seg_tan_x[i1];
+  const double seg_y = tile1.y[i1] + seg_s * tile1.seg_tan_y[i1];
+  
+  // Interpolate normal at s based on the distance between wp1 and wp2 (each
+  // with normal from their averaged heading)
+  const double s_interp = seg_s / seg_len;
+  double norm_x = ((1-s_interp) * tile1.norm_x[i1]
+                   + s_interp * tile2.norm_x[i2]);
+  double norm_y = ((1-s_interp) * tile1.norm_y[i1]
+                   + s_interp * tile2.norm_y[i2]);
+  const double norm_len = sqrt(sq(norm_x) + sq(norm_y));
+  
+  // Use interpolated normal to calculate final (x,y) at d offset from the
   // segment vector
-  double theta_perp = theta_interp - pi()/2;
-  double x = seg_x + d * cos(theta_perp);
-  double y = seg_y + d * sin(theta_perp);
+  const double x = seg_x + d * norm_x / norm_len;
+  const double y = seg_y + d * norm_y / norm_len;
   
   return {x, y};
 }
 
 /**
- * Transform from Cartesian (x,y) coordinates to Frenet (s,d)
+ * Transform arrays of Frenet (s,d) coordinates to Cartesian (x,y) in blocks of
+ * kXYBatchBlockSize points.  For each block, the road geometry values at each
+ * point's waypoints are gathered into contiguous arrays first, and then the
+ * (x,y) arithmetic is done with AVX (4 points) or SSE2 (2 points) vectors
+ * when available, with a scalar loop for the remaining points.
+ */
+void GetHiResXYBatch(const double *pts_s, const double *pts_d, int num_pts,
+                     const FrenetMap &frenet_map,
+                     double *pts_x, double *pts_y) {
+  
+  const double max_s = frenet_map.GetMaxS();
+  const double s_inc = frenet_map.GetSInc();
+  
+  // Gathered values for each point in block
+  double seg_s[kXYBatchBlockSize];
+  double s_interp[kXYBatchBlockSize];
+  double wp1_x[kXYBatchBlockSize];
+  double wp1_y[kXYBatchBlockSize];
+  double seg_tan_x[kXYBatchBlockSize];
+  double seg_tan_y[kXYBatchBlockSize];
+  double wp1_norm_x[kXYBatchBlockSize];
+  double wp1_norm_y[kXYBatchBlockSize];
+  double wp2_norm_x[kXYBatchBlockSize];
+  double wp2_norm_y[kXYBatchBlockSize];
+  
+  const int last_wp = frenet_map.GetNumWaypoints() - 1;
+  
+  for (int i_blk = 0; i_blk < num_pts; i_blk += kXYBatchBlockSize) {
+    const int blk_size = std::min(kXYBatchBlockSize, num_pts - i_blk);
+    
+    // Gather road geometry at waypoint before s (wp1) and after s (wp2), same
+    // as GetHiResXY
+    for (int j = 0; j < blk_size; ++j) {
+      double s = pts_s[i_blk + j];
+      if ((s < 0.) || (s >= max_s)) {
+        s -= floor(s / max_s) * max_s;
+      }
+      const int wp1 = std::min(int(s / s_inc), last_wp);
+      const int wp2 = (wp1 < last_wp) ? (wp1 + 1) : 0;
+      const double s_wp1 = wp1 * s_inc;
+      const double seg_len = (wp1 < last_wp) ? s_inc : (max_s - s_wp1);
+      const MapTile &tile1 = frenet_map.GetTile(wp1);
+      const MapTile &tile2 = ((wp2 & kMapTileMask) != 0)
+                               ? tile1 : frenet_map.GetTile(wp2);
+      const int i1 = wp1 & kMapTileMask;
+      const int i2 = wp2 & kMapTileMask;
+      seg_s[j] = s - s_wp1;
+      s_interp[j] = seg_s[j] / seg_len;
+      wp1_x[j] = tile1.x[i1];
+      wp1_y[j] = tile1.y[i1];
+      seg_tan_x[j] = tile1.seg_tan_x[i1];
+      seg_tan_y[j] = tile1.seg_tan_y[i1];
+      wp1_norm_x[j] = tile1.norm_x[i1];
+      wp1_norm_y[j] = tile1.norm_y[i1];
+      wp2_norm_x[j] = tile2.norm_x[i2];
+      wp2_norm_y[j] = tile2.norm_y[i2];
+    }
+    
+    const double *blk_d = pts_d + i_blk;
+    double *blk_x = pts_x + i_blk;
+    double *blk_y = pts_y + i_blk;
+    int j = 0;
+    
+#if defined(__AVX__)
+    for (; j + 4 <= blk_size; j += 4) {
+      const __m256d v_seg_s = _mm256_loadu_pd(seg_s + j);
+      const __m256d v_interp = _mm256_loadu_pd(s_interp + j);
+      const __m256d v_d = _mm256_loadu_pd(blk_d + j);
+      const __m256d v_seg_x = _mm256_add_pd(_mm256_loadu_pd(wp1_x + j),
+          _mm256_mul_pd(v_seg_s, _mm256_loadu_pd(seg_tan_x + j)));
+      const __m256d v_seg_y = _mm256_add_pd(_mm256_loadu_pd(wp1_y + j),
+          _mm256_mul_pd(v_seg_s, _mm256_loadu_pd(seg_tan_y + j)));
+      const __m256d v_n1_x = _mm256_loadu_pd(wp1_norm_x + j);
+      const __m256d v_n1_y = _mm256_loadu_pd(wp1_norm_y + j);
+      const __m256d v_n_x = _mm256_add_pd(v_n1_x, _mm256_mul_pd(v_interp,
+          _mm256_sub_pd(_mm256_loadu_pd(wp2_norm_x + j), v_n1_x)));
+      const __m256d v_n_y = _mm256_add_pd(v_n1_y, _mm256_mul_pd(v_interp,
+          _mm256_sub_pd(_mm256_loadu_pd(wp2_norm_y + j), v_n1_y)));
+      const __m256d v_n_len = _mm256_sqrt_pd(_mm256_add_pd(
+          _mm256_mul_pd(v_n_x, v_n_x), _mm256_mul_pd(v_n_y, v_n_y)));
+      const __m256d v_d_scale = _mm256_div_pd(v_d, v_n_len);
+      _mm256_storeu_pd(blk_x + j, _mm256_add_pd(v_seg_x,
+                                                _mm256_mul_pd(v_d_scale, v_n_x)));
+      _mm256_storeu_pd(blk_y + j, _mm256_add_pd(v_seg_y,
+                                                _mm256_mul_pd(v_d_scale, v_n_y)));
+    }
+#elif defined(__SSE2__)
+    for (; j + 2 <= blk_size; j += 2) {
+      const __m128d v_seg_s = _mm_loadu_pd(seg_s + j);
+      const __m128d v_interp = _mm_loadu_pd(s_interp + j);
+      const __m128d v_d = _mm_loadu_pd(blk_d + j);
+      const __m128d v_seg_x = _mm_add_pd(_mm_loadu_pd(wp1_x + j),
+          _mm_mul_pd(v_seg_s, _mm_loadu_pd(seg_tan_x + j)));
+      const __m128d v_seg_y = _mm_add_pd(_mm_loadu_pd(wp1_y + j),
+          _mm_mul_pd(v_seg_s, _mm_loadu_pd(seg_tan_y + j)));
+      const __m128d v_n1_x = _mm_loadu_pd(wp1_norm_x + j);
+      const __m128d v_n1_y = _mm_loadu_pd(wp1_norm_y + j);
+      const __m128d v_n_x = _mm_add_pd(v_n1_x, _mm_mul_pd(v_interp,
+          _mm_sub_pd(_mm_loadu_pd(wp2_norm_x + j), v_n1_x)));
+      const __m128d v_n_y = _mm_add_pd(v_n1_y, _mm_mul_pd(v_interp,
+          _mm_sub_pd(_mm_loadu_pd(wp2_norm_y + j), v_n1_y)));
+      const __m128d v_n_len = _mm_sqrt_pd(_mm_add_pd(
+          _mm_mul_pd(v_n_x, v_n_x), _mm_mul_pd(v_n_y, v_n_y)));
+      const __m128d v_d_scale = _mm_div_pd(v_d, v_n_len);
+      _mm_storeu_pd(blk_x + j, _mm_add_pd(v_seg_x, _mm_mul_pd(v_d_scale, v_n_x)));
+      _mm_storeu_pd(blk_y + j, _mm_add_pd(v_seg_y, _mm_mul_pd(v_d_scale, v_n_y)));
+    }
+#endif
+    
+    // Scalar loop for points remaining after vector lanes
+    for (; j < blk_size; ++j) {
+      const double seg_x = wp1_x[j] + seg_s[j] * seg_tan_x[j];
+      const double seg_y = wp1_y[j] + seg_s[j] * seg_tan_y[j];
+      const double norm_x = (wp1_norm_x[j]
+                             + s_interp[j] * (wp2_norm_x[j] - wp1_norm_x[j]));
+      const double norm_y = (wp1_norm_y[j]
+                             + s_interp[j] * (wp2_norm_y[j] - wp1_norm_y[j]));
+      const double d_scale = blk_d[j] / sqrt(sq(norm_x) + sq(norm_y));
+      blk_x[j] = seg_x + d_scale * norm_x;
+      blk_y[j] = seg_y + d_scale * norm_y;
+    }
+  }
+}
+
+/**
+ * Get the road curvature (1/m, positive when bending toward +d) at Frenet s,
+ * interpolated between the curvature of the waypoints before and after s.
+ * A path at offset d then moves (1 - curvature * d) m in (x,y) per m of s.
+ */
+double GetHiResCurvature(double s, const FrenetMap &frenet_map) {
+  
+  const double max_s = frenet_map.GetMaxS();
+  const double s_inc = frenet_map.GetSInc();
+  
+  // Wrap around s
+  if ((s < 0.) || (s >= max_s)) {
+    s -= floor(s / max_s) * max_s;
+  }
+  
+  // Index waypoints before and after s, same as GetHiResXY
+  const int last_wp = frenet_map.GetNumWaypoints() - 1;
+  const int wp1 = std::min(int(s / s_inc), last_wp);
+  const int wp2 = (wp1 < last_wp) ? (wp1 + 1) : 0;
+  const double s_wp1 = wp1 * s_inc;
+  const double seg_len = (wp1 < last_wp) ? s_inc : (max_s - s_wp1);
+  const MapTile &tile1 = frenet_map.GetTile(wp1);
+  const MapTile &tile2 = ((wp2 & kMapTileMask) != 0) ? tile1
+                                                     : frenet_map.GetTile(wp2);
+  
+  const double s_interp = (s - s_wp1) / seg_len;
+  return ((1-s_interp) * tile1.curvature[wp1 & kMapTileMask]
+          + s_interp * tile2.curvature[wp2 & kMapTileMask]);
+}
+
+/**
+ * Get the road curvature at an array of Frenet s points, same as
+ * GetHiResCurvature.  The points are trajectory samples that mostly stay in
+ * the same map tile as the point before them, so the tiles of the last point
+ * are kept and only looked up again when a point's waypoints move to another
+ * tile.
  */
-std::vector<double> GetHiResFrenet(double x, double y,
-                                   const std::vector<double> &map_s,
-                                   const std::vector<double> &map_x,
-                                   const std::vector<double> &map_y) {
+void GetHiResCurvatureBatch(const double *pts_s, int num_pts,
+                            const FrenetMap &frenet_map,
+                            double *curvatures) {
+  
+  const double max_s = frenet_map.GetMaxS();
+  const double s_inc = frenet_map.GetSInc();
+  const int last_wp = frenet_map.GetNumWaypoints() - 1;
+  
+  int tile1_idx = -1;
+  int tile2_idx = -1;
+  const MapTile *tile1 = NULL;
+  const MapTile *tile2 = NULL;
+  for (int i = 0; i < num_pts; ++i) {
+    double s = pts_s[i];
+    if ((s < 0.) || (s >= max_s)) {
+      s -= floor(s / max_s) * max_s;
+    }
+    
+    const int wp1 = std::min(int(s / s_inc), last_wp);
+    const int wp2 = (wp1 < last_wp) ? (wp1 + 1) : 0;
+    const double s_wp1 = wp1 * s_inc;
+    const double seg_len = (wp1 < last_wp) ? s_inc : (max_s - s_wp1);
+    if ((wp1 >> kMapTileShift) != tile1_idx) {
+      tile1_idx = wp1 >> kMapTileShift;
+      tile1 = &frenet_map.GetTile(wp1);
+    }
+    if ((wp2 >> kMapTileShift) != tile2_idx) {
+      tile2_idx = wp2 >> kMapTileShift;
+      tile2 = &frenet_map.GetTile(wp2);
+    }
+    
+    const double s_interp = (s - s_wp1) / seg_len;
+    curvatures[i] = ((1-s_interp) * tile1->curvature[wp1 & kMapTileMask]
+                     + s_interp * tile2->curvature[wp2 & kMapTileMask]);
+  }
+}
+
+/**
+ * Find the map segment (wp1, wp1+1) that Cartesian (x,y) projects onto and
+ * return wp1.
+ *
+ * wp_hint is the closest waypoint from the last transform of the same vehicle
+ * (-1 if none) and is updated to the closest waypoint found by this search.
+ * The segment is picked by the closer neighbor of the closest waypoint and then
+ * stepped along the map while the projection falls outside of it.
+ */
+static int FindFrenetSegment(double x, double y, const FrenetMap &frenet_map,
+                             int *wp_hint) {
+  
+  const int num_wps = frenet_map.GetNumWaypoints();
+  
+  // Get closest waypoint to (x,y) by a grid search seeded from the raster if
+  // selected, otherwise (or if outside of the raster) searching near the hint
+  // first, with global search as fallback if there was no hint or the local
+  // search failed
+  int close_wp = -1;
+  if (frenet_map.IsRasterProjection()) {
+    const int raster_wp = RasterWaypoint(x, y, frenet_map);
+    if (raster_wp >= 0) {
+      close_wp = ClosestWaypointFromSeed(x, y, raster_wp, frenet_map);
+    }
+  }
+  if (close_wp < 0) {
+    close_wp = ClosestWaypointNearHint(x, y, *wp_hint, frenet_map);
+  }
+  if (close_wp < 0) {
+    close_wp = ClosestWaypoint(x, y, frenet_map);
+  }
+  *wp_hint = close_wp;
   
   // Get closest pair of waypoints to (x,y)
-  int close_wp = ClosestWaypoint(x, y, map_x, map_y);
-  int next_wp = (close_wp + 1) % map_x.size(); // wrap around end
+  int next_wp = (close_wp + 1) % num_wps; // wrap around end
   int prev_wp = close_wp - 1;
-  if (prev_wp < 0) { prev_wp = map_x.size() - 1; } // wrap around beginning
-  double dist_nextwp = Distance(x, y, map_x[next_wp], map_y[next_wp]);
-  double dist_prevwp = Distance(x, y, map_x[prev_wp], map_y[prev_wp]);
-  int wp1;
-  int wp2;
-  if (dist_nextwp < dist_prevwp) {
-    wp1 = close_wp;
-    wp2 = next_wp;
-  }
-  else {
-    wp1 = prev_wp;
-    wp2 = close_wp;
+  if (prev_wp < 0) { prev_wp = num_wps - 1; } // wrap around beginning
+  double dist_nextwp = Distance(x, y, frenet_map.GetX(next_wp),
+                                frenet_map.GetY(next_wp));
+  double dist_prevwp = Distance(x, y, frenet_map.GetX(prev_wp),
+                                frenet_map.GetY(prev_wp));
+  int wp1 = (dist_nextwp < dist_prevwp) ? close_wp : prev_wp;
+  
+  // Step to the adjacent waypoint pair and project again until the projection
+  // falls within the waypoint pair, stopping if the step direction reverses
+  // (position is off the outside corner between two segments)
+  int prev_step = 0;
+  for (int i_refine = 0; i_refine < kFrenetMaxRefineSteps; ++i_refine) {
+    const int wp2 = (wp1 + 1) % num_wps;
+    const double vx_wp = frenet_map.GetX(wp2) - frenet_map.GetX(wp1);
+    const double vy_wp = frenet_map.GetY(wp2) - frenet_map.GetY(wp1);
+    const double vx_pos = x - frenet_map.GetX(wp1);
+    const double vy_pos = y - frenet_map.GetY(wp1);
+    const double dot_proj = vx_pos * vx_wp + vy_pos * vy_wp;
+    int step = 0;
+    if (dot_proj < 0.) { step = -1; }
+    else if (dot_proj > (sq(vx_wp) + sq(vy_wp))) { step = 1; }
+    if ((step == 0) || (step == -prev_step)) { break; }
+    prev_step = step;
+    wp1 = (wp1 + step + num_wps) % num_wps;
   }
   
+  return wp1;
+}
+
+/**
+ * Transform from Cartesian (x,y) coordinates and (vx,vy) velocity to Frenet
+ * (s,d) and (s_dot,d_dot) in a single projection onto the map segment from
+ * waypoint wp1 to wp2.
+ */
+static FrenetProjection ProjectOnSegment(double x, double y,
+                                         double vx, double vy,
+                                         int wp1, int wp2,
+                                         const FrenetMap &frenet_map) {
+  
   // Waypoint vector x and y components from prev waypoint to next waypoint
-  double vx_wp = map_x[wp2] - map_x[wp1];
-  double vy_wp = map_y[wp2] - map_y[wp1];
+  const double vx_wp = frenet_map.GetX(wp2) - frenet_map.GetX(wp1);
+  const double vy_wp = frenet_map.GetY(wp2) - frenet_map.GetY(wp1);
   
   // Position vector x and y components from prev waypoint to position coord
-  double vx_pos = x - map_x[wp1];
-  double vy_pos = y - map_y[wp1];
+  const double vx_pos = x - frenet_map.GetX(wp1);
+  const double vy_pos = y - frenet_map.GetY(wp1);
   
   // Find the scalar projection of position vector onto waypoint vector
-  double norm_wp = sqrt(sq(vx_wp) + sq(vy_wp));
+  const double norm_wp = sqrt(sq(vx_wp) + sq(vy_wp));
   double scalar_proj = ((vx_pos * vx_wp + vy_pos * vy_wp) / norm_wp);
   
-  // Calculate d using distance from projection to the position coord, with
-  // special cases where the projection is outside of waypoint vector ends
+  // Segment's unit tangent and normal (rotated -90deg from tangent to point
+  // toward +d)
+  FrenetProjection proj;
+  proj.seg_wp = wp1;
+  proj.tan_x = vx_wp / norm_wp;
+  proj.tan_y = vy_wp / norm_wp;
+  proj.norm_x = proj.tan_y;
+  proj.norm_y = -proj.tan_x;
+  
+  // Calculate signed d as the position vector's component along the normal,
+  // with special cases where the projection is outside of waypoint vector ends
+  // using the distance to the end (signed by the side of the segment)
+  const double normal_proj = vx_pos * proj.norm_x + vy_pos * proj.norm_y;
+  const double d_sign = (normal_proj < 0.) ? -1. : 1.;
   double frenet_d;
   if (scalar_proj < 0.) {
     // Projection to position coord goes behind wp1
     scalar_proj = 0.; // limit scalar proj to endpoint for calculating s
-    frenet_d = Distance(map_x[wp1], map_y[wp1], x, y);
+    frenet_d = d_sign * Distance(frenet_map.GetX(wp1), frenet_map.GetY(wp1),
+                                 x, y);
   }
   else if (scalar_proj > norm_wp) {
     // Projection to position coord goes past wp2
     scalar_proj = norm_wp; // limit scalar proj to endpoint for calculating s
-    frenet_d = Distance(map_x[wp2], map_y[wp2], x, y);
+    frenet_d = d_sign * Distance(frenet_map.GetX(wp2), frenet_map.GetY(wp2),
+                                 x, y);
   }
   else {
     // Projection to position coord is within wp1-wp2
-    double dist_wp1_pos = Distance(map_x[wp1], map_y[wp1], x, y);
-    frenet_d = sqrt(sq(dist_wp1_pos) - sq(scalar_proj)); // Pythagorean
+    frenet_d = normal_proj;
   }
   
   // Calculate s using scalar_proj limited between waypoint pair (0, norm_wp)
-  double frenet_s = map_s[wp1] + scalar_proj;
+  proj.s = frenet_map.GetS(wp1) + scalar_proj;
+  proj.d = frenet_d;
+  
+  // Split (vx,vy) into Frenet velocity components with the same tangent and
+  // normal, so s_dot and d_dot have the same sign convention as s and d
+  proj.s_dot = vx * proj.tan_x + vy * proj.tan_y;
+  proj.d_dot = vx * proj.norm_x + vy * proj.norm_y;
   
-  return {frenet_s, frenet_d};
+  return proj;
 }
 
 /**
- * Calculate Frenet velocities (s_dot,d_dot) from (vx,vy) and d normal vector
- * based on closest map waypoint's (dx,dy)
+ * Transform from Cartesian (x,y) coordinates and (vx,vy) velocity to Frenet
+ * (s,d) and (s_dot,d_dot) in a single projection onto the closest map segment.
+ *
+ * wp_hint is the closest waypoint from the last transform of the same vehicle
+ * (-1 if none) and is updated to the closest waypoint found by this transform.
  */
-std::vector<double> GetFrenetVelocity(double vx, double vy, int closest_wp,
-                                      const std::vector<double> &map_dx,
-                                      const std::vector<double> &map_dy) {
-  
-  double dx = map_dx[closest_wp];
-  double dy = map_dy[closest_wp];
-  double frenet_d_dot = (vx * dx + vy * dy);
-  double frenet_s_dot = sqrt(sq(vx) + sq(vy) - sq(frenet_d_dot));
+FrenetProjection GetHiResFrenet(double x, double y, double vx, double vy,
+                                const FrenetMap &frenet_map,
+                                int *wp_hint) {
   
-  return {frenet_s_dot, frenet_d_dot};
+  const int wp1 = FindFrenetSegment(x, y, frenet_map, wp_hint);
+  const int wp2 = (wp1 + 1) % frenet_map.GetNumWaypoints();
+  return ProjectOnSegment(x, y, vx, vy, wp1, wp2, frenet_map);
 }
 
 /**
- * Calculate the Jerk Minimizing Trajectory that connects the start state
- * to the end state in time t_end.  The state variables are [s, s_dot, s_dotdot]
- * and the output is a vector of 5th order polynomial coefficients a0-a5:
- * s(t) = a0 + a1 * t + a2 * t^2 + a3 * t^3 + a4 * t^4 + a5 * t^5
+ * Persistent worker threads for GetHiResFrenetBatch, started the first time a
+ * batch is large enough to split so later batches only hand out chunks
+ * instead of creating and joining threads every call.  Chunks are claimed by
+ * the workers and the calling thread until all are done.
  */
-std::vector<double> JMT(std::vector<double> start, std::vector<double> end,
-                        double t_end) {
+class FrenetBatchPool {
+public:
+  static FrenetBatchPool& Get() {
+    static FrenetBatchPool pool;
+    return pool;
+  }
   
-  const double t_end2 = t_end * t_end;
-  const double t_end3 = t_end2 * t_end;
-  const double t_end4 = t_end3 * t_end;
-  const double t_end5 = t_end4 * t_end;
+  int GetNumThreads() const { return int(workers_.size()) + 1; }
   
-  Eigen::MatrixXd A = Eigen::MatrixXd(3, 3);
-  A << t_end3, t_end4, t_end5,
-       3*t_end2, 4*t_end3, 5*t_end4,
-       6*t_end, 12*t_end2, 20*t_end3;
+  void Run(int num_chunks, const std::function<void(int)> &run_chunk) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_ = &run_chunk;
+    num_chunks_ = num_chunks;
+    next_chunk_ = 0;
+    num_pending_ = num_chunks;
+    generation_++;
+    cv_start_.notify_all();
+    RunChunks(&lock);
+    cv_done_.wait(lock, [this] { return num_pending_ == 0; });
+    job_ = nullptr;
+  }
   
-  Eigen::MatrixXd B = Eigen::MatrixXd(3,1);
-  B << end[0]-(start[0]+start[1]*t_end+0.5*start[2]*t_end2),
-       end[1]-(start[1]+start[2]*t_end),
-       end[2]-start[2];
+  ~FrenetBatchPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      is_stopping_ = true;
+    }
+    cv_start_.notify_all();
+    for (int i = 0; i < int(workers_.size()); ++i) {
+      workers_[i].join();
+    }
+  }
+
+private:
+  FrenetBatchPool() : job_(nullptr), num_chunks_(0), next_chunk_(0),
+                      num_pending_(0), generation_(0), is_stopping_(false) {
+    const int num_workers = int(std::thread::hardware_concurrency()) - 1;
+    for (int i = 0; i < num_workers; ++i) {
+      workers_.push_back(std::thread(&FrenetBatchPool::WorkerLoop, this));
+    }
+  }
   
-  Eigen::MatrixXd Ai = A.inverse();
-  Eigen::MatrixXd C = Ai * B;
+  // Claim and run chunks until none are left (mutex held between chunks)
+  void RunChunks(std::unique_lock<std::mutex> *lock) {
+    while (next_chunk_ < num_chunks_) {
+      const int i_chunk = next_chunk_++;
+      const std::function<void(int)> &run_chunk = *job_;
+      lock->unlock();
+      run_chunk(i_chunk);
+      lock->lock();
+      if (--num_pending_ == 0) { cv_done_.notify_one(); }
+    }
+  }
   
-  std::vector<double> result = {start[0], start[1], 0.5*start[2]};
-  for(int i = 0; i < C.size(); ++i) {
-    result.push_back(C.data()[i]);
+  void WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    int last_generation = generation_;
+    while (true) {
+      cv_start_.wait(lock, [&] { return is_stopping_
+                                        || (generation_ != last_generation); });
+      if (is_stopping_) { return; }
+      last_generation = generation_;
+      RunChunks(&lock);
+    }
+  }
+  
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable cv_start_;
+  std::condition_variable cv_done_;
+  const std::function<void(int)> *job_;
+  int num_chunks_;
+  int next_chunk_;
+  int num_pending_;
+  int generation_;
+  bool is_stopping_;
+};
+
+#if defined(__AVX__)
+static inline __m256d SelectPd(__m256d mask, __m256d v_false,
+                               __m256d v_true) {
+  return _mm256_blendv_pd(v_false, v_true, mask);
+}
+#elif defined(__SSE2__)
+static inline __m128d SelectPd(__m128d mask, __m128d v_false,
+                               __m128d v_true) {
+  return _mm_or_pd(_mm_and_pd(mask, v_true), _mm_andnot_pd(mask, v_false));
+}
+#endif
+
+/**
+ * Transform a block of at most kXYBatchBlockSize points to Frenet.  The map
+ * segment of each point is searched one point at a time, then the segments'
+ * waypoints are gathered and the projections onto them are done with AVX
+ * (4 points) or SSE2 (2 points) vectors when available, with the same
+ * operations as ProjectOnSegment.
+ */
+static void GetHiResFrenetBlock(const double *pts_x, const double *pts_y,
+                                const double *pts_vx, const double *pts_vy,
+                                int blk_size,
+                                const FrenetMap &frenet_map,
+                                int *wp_hints,
+                                double *pts_s, double *pts_d,
+                                double *pts_s_dot, double *pts_d_dot) {
+  
+  const int num_wps = frenet_map.GetNumWaypoints();
+  
+  // Gathered segment waypoints for each point in block
+  int seg_wp1[kXYBatchBlockSize];
+  double wp1_s[kXYBatchBlockSize];
+  double wp1_x[kXYBatchBlockSize];
+  double wp1_y[kXYBatchBlockSize];
+  double wp2_x[kXYBatchBlockSize];
+  double wp2_y[kXYBatchBlockSize];
+  
+  for (int j = 0; j < blk_size; ++j) {
+    const int wp1 = FindFrenetSegment(pts_x[j], pts_y[j], frenet_map,
+                                      &wp_hints[j]);
+    const int wp2 = (wp1 + 1) % num_wps;
+    seg_wp1[j] = wp1;
+    wp1_s[j] = frenet_map.GetS(wp1);
+    wp1_x[j] = frenet_map.GetX(wp1);
+    wp1_y[j] = frenet_map.GetY(wp1);
+    wp2_x[j] = frenet_map.GetX(wp2);
+    wp2_y[j] = frenet_map.GetY(wp2);
+  }
+  
+  int j = 0;
+
+#if defined(__AVX__)
+  const __m256d v_zero = _mm256_setzero_pd();
+  const __m256d v_sign = _mm256_set1_pd(-0.);
+  for (; j + 4 <= blk_size; j += 4) {
+    const __m256d v_x = _mm256_loadu_pd(pts_x + j);
+    const __m256d v_y = _mm256_loadu_pd(pts_y + j);
+    const __m256d v_x1 = _mm256_loadu_pd(wp1_x + j);
+    const __m256d v_y1 = _mm256_loadu_pd(wp1_y + j);
+    const __m256d v_x2 = _mm256_loadu_pd(wp2_x + j);
+    const __m256d v_y2 = _mm256_loadu_pd(wp2_y + j);
+    const __m256d v_vx_wp = _mm256_sub_pd(v_x2, v_x1);
+    const __m256d v_vy_wp = _mm256_sub_pd(v_y2, v_y1);
+    const __m256d v_vx_pos = _mm256_sub_pd(v_x, v_x1);
+    const __m256d v_vy_pos = _mm256_sub_pd(v_y, v_y1);
+    const __m256d v_norm_wp = _mm256_sqrt_pd(_mm256_add_pd(
+        _mm256_mul_pd(v_vx_wp, v_vx_wp), _mm256_mul_pd(v_vy_wp, v_vy_wp)));
+    __m256d v_proj = _mm256_div_pd(_mm256_add_pd(
+        _mm256_mul_pd(v_vx_pos, v_vx_wp), _mm256_mul_pd(v_vy_pos, v_vy_wp)),
+        v_norm_wp);
+    const __m256d v_tan_x = _mm256_div_pd(v_vx_wp, v_norm_wp);
+    const __m256d v_tan_y = _mm256_div_pd(v_vy_wp, v_norm_wp);
+    const __m256d v_norm_x = v_tan_y;
+    const __m256d v_norm_y = _mm256_xor_pd(v_tan_x, v_sign);
+    
+    // Signed d, with the distance to the segment end if projection is outside
+    const __m256d v_normal_proj = _mm256_add_pd(
+        _mm256_mul_pd(v_vx_pos, v_norm_x), _mm256_mul_pd(v_vy_pos, v_norm_y));
+    const __m256d v_behind = _mm256_cmp_pd(v_proj, v_zero, _CMP_LT_OQ);
+    const __m256d v_past = _mm256_cmp_pd(v_proj, v_norm_wp, _CMP_GT_OQ);
+    const __m256d v_ex = SelectPd(v_past, v_vx_pos, _mm256_sub_pd(v_x, v_x2));
+    const __m256d v_ey = SelectPd(v_past, v_vy_pos, _mm256_sub_pd(v_y, v_y2));
+    const __m256d v_end_dist = _mm256_sqrt_pd(_mm256_add_pd(
+        _mm256_mul_pd(v_ex, v_ex), _mm256_mul_pd(v_ey, v_ey)));
+    const __m256d v_end_d = _mm256_xor_pd(v_end_dist, _mm256_and_pd(
+        _mm256_cmp_pd(v_normal_proj, v_zero, _CMP_LT_OQ), v_sign));
+    const __m256d v_d = SelectPd(_mm256_or_pd(v_behind, v_past),
+                                 v_normal_proj, v_end_d);
+    v_proj = SelectPd(v_behind, v_proj, v_zero);
+    v_proj = SelectPd(v_past, v_proj, v_norm_wp);
+    
+    const __m256d v_vx = _mm256_loadu_pd(pts_vx + j);
+    const __m256d v_vy = _mm256_loadu_pd(pts_vy + j);
+    _mm256_storeu_pd(pts_s + j, _mm256_add_pd(_mm256_loadu_pd(wp1_s + j),
+                                              v_proj));
+    _mm256_storeu_pd(pts_d + j, v_d);
+    _mm256_storeu_pd(pts_s_dot + j, _mm256_add_pd(
+        _mm256_mul_pd(v_vx, v_tan_x), _mm256_mul_pd(v_vy, v_tan_y)));
+    _mm256_storeu_pd(pts_d_dot + j, _mm256_add_pd(
+        _mm256_mul_pd(v_vx, v_norm_x), _mm256_mul_pd(v_vy, v_norm_y)));
+  }
+#elif defined(__SSE2__)
+  const __m128d v_zero = _mm_setzero_pd();
+  const __m128d v_sign = _mm_set1_pd(-0.);
+  for (; j + 2 <= blk_size; j += 2) {
+    const __m128d v_x = _mm_loadu_pd(pts_x + j);
+    const __m128d v_y = _mm_loadu_pd(pts_y + j);
+    const __m128d v_x1 = _mm_loadu_pd(wp1_x + j);
+    const __m128d v_y1 = _mm_loadu_pd(wp1_y + j);
+    const __m128d v_x2 = _mm_loadu_pd(wp2_x + j);
+    const __m128d v_y2 = _mm_loadu_pd(wp2_y + j);
+    const __m128d v_vx_wp = _mm_sub_pd(v_x2, v_x1);
+    const __m128d v_vy_wp = _mm_sub_pd(v_y2, v_y1);
+    const __m128d v_vx_pos = _mm_sub_pd(v_x, v_x1);
+    const __m128d v_vy_pos = _mm_sub_pd(v_y, v_y1);
+    const __m128d v_norm_wp = _mm_sqrt_pd(_mm_add_pd(
+        _mm_mul_pd(v_vx_wp, v_vx_wp), _mm_mul_pd(v_vy_wp, v_vy_wp)));
+    __m128d v_proj = _mm_div_pd(_mm_add_pd(
+        _mm_mul_pd(v_vx_pos, v_vx_wp), _mm_mul_pd(v_vy_pos, v_vy_wp)),
+        v_norm_wp);
+    const __m128d v_tan_x = _mm_div_pd(v_vx_wp, v_norm_wp);
+    const __m128d v_tan_y = _mm_div_pd(v_vy_wp, v_norm_wp);
+    const __m128d v_norm_x = v_tan_y;
+    const __m128d v_norm_y = _mm_xor_pd(v_tan_x, v_sign);
+    
+    // Signed d, with the distance to the segment end if projection is outside
+    const __m128d v_normal_proj = _mm_add_pd(
+        _mm_mul_pd(v_vx_pos, v_norm_x), _mm_mul_pd(v_vy_pos, v_norm_y));
+    const __m128d v_behind = _mm_cmplt_pd(v_proj, v_zero);
+    const __m128d v_past = _mm_cmpgt_pd(v_proj, v_norm_wp);
+    const __m128d v_ex = SelectPd(v_past, v_vx_pos, _mm_sub_pd(v_x, v_x2));
+    const __m128d v_ey = SelectPd(v_past, v_vy_pos, _mm_sub_pd(v_y, v_y2));
+    const __m128d v_end_dist = _mm_sqrt_pd(_mm_add_pd(
+        _mm_mul_pd(v_ex, v_ex), _mm_mul_pd(v_ey, v_ey)));
+    const __m128d v_end_d = _mm_xor_pd(v_end_dist, _mm_and_pd(
+        _mm_cmplt_pd(v_normal_proj, v_zero), v_sign));
+    const __m128d v_d = SelectPd(_mm_or_pd(v_behind, v_past),
+                                 v_normal_proj, v_end_d);
+    v_proj = SelectPd(v_behind, v_proj, v_zero);
+    v_proj = SelectPd(v_past, v_proj, v_norm_wp);
+    
+    const __m128d v_vx = _mm_loadu_pd(pts_vx + j);
+    const __m128d v_vy = _mm_loadu_pd(pts_vy + j);
+    _mm_storeu_pd(pts_s + j, _mm_add_pd(_mm_loadu_pd(wp1_s + j), v_proj));
+    _mm_storeu_pd(pts_d + j, v_d);
+    _mm_storeu_pd(pts_s_dot + j, _mm_add_pd(_mm_mul_pd(v_vx, v_tan_x),
+                                            _mm_mul_pd(v_vy, v_tan_y)));
+    _mm_storeu_pd(pts_d_dot + j, _mm_add_pd(_mm_mul_pd(v_vx, v_norm_x),
+                                            _mm_mul_pd(v_vy, v_norm_y)));
   }
+#endif
   
-  return result; // [a0, a1, a2, a3, a4, a5]
+  // Scalar loop for points remaining after vector lanes
+  for (; j < blk_size; ++j) {
+    const int wp2 = (seg_wp1[j] + 1) % num_wps;
+    const FrenetProjection proj = ProjectOnSegment(pts_x[j], pts_y[j],
+                                                   pts_vx[j], pts_vy[j],
+                                                   seg_wp1[j], wp2,
+                                                   frenet_map);
+    pts_s[j] = proj.s;
+    pts_d[j] = proj.d;
+    pts_s_dot[j] = proj.s_dot;
+    pts_d_dot[j] = proj.d_dot;
+  }
 }
 
 /**
- * Evaluate a polynomial with form "y = a0 + a1*x + a2*x^2 + ..." at x
+ * Transform arrays of Cartesian positions and velocities to Frenet, with each
+ * point's waypoint hint updated the same as GetHiResFrenet.  Points are
+ * transformed in blocks on this thread, unless the batch has enough points to
+ * give each thread of the persistent FrenetBatchPool at least
+ * kFrenetBatchMinPerThread of them.
  */
-double EvalPoly(double x, std::vector<double> coeffs) {
-  double y = 0;
-  for (int i = 0; i < coeffs.size(); ++i) {
-    y += coeffs[i] * pow(x, i);
+void GetHiResFrenetBatch(const double *pts_x, const double *pts_y,
+                         const double *pts_vx, const double *pts_vy,
+                         int num_pts,
+                         const FrenetMap &frenet_map,
+                         int *wp_hints,
+                         double *pts_s, double *pts_d,
+                         double *pts_s_dot, double *pts_d_dot) {
+  
+  // Transform a chunk of points [i_start, i_end) block by block
+  auto transform_chunk = [&](int i_start, int i_end) {
+    for (int i_blk = i_start; i_blk < i_end; i_blk += kXYBatchBlockSize) {
+      const int blk_size = std::min(kXYBatchBlockSize, i_end - i_blk);
+      GetHiResFrenetBlock(pts_x + i_blk, pts_y + i_blk, pts_vx + i_blk,
+                          pts_vy + i_blk, blk_size, frenet_map,
+                          wp_hints + i_blk, pts_s + i_blk, pts_d + i_blk,
+                          pts_s_dot + i_blk, pts_d_dot + i_blk);
+    }
+  };
+  
+  // Small batches (all sensor fusion sizes) never touch the thread pool
+  if (num_pts < 2 * kFrenetBatchMinPerThread) {
+    transform_chunk(0, num_pts);
+    return;
+  }
+  
+  // Split into one chunk per pool thread, limited by min points per thread
+  FrenetBatchPool &pool = FrenetBatchPool::Get();
+  const int num_chunks = std::min(num_pts / kFrenetBatchMinPerThread,
+                                  pool.GetNumThreads());
+  if (num_chunks <= 1) {
+    transform_chunk(0, num_pts);
+    return;
   }
-  return y;
+  const int chunk_size = (num_pts + num_chunks - 1) / num_chunks;
+  pool.Run(num_chunks, [&](int i_chunk) {
+    const int i_start = i_chunk * chunk_size;
+    transform_chunk(i_start, std::min(i_start + chunk_size, num_pts));
+  });
 }
 
 /**
- * Differentiate a polynomial with form y = a0 + a1*x + a2*x^2 + ... to get
- * the derivative polynomial's coefficients
+ * Find the points within range of (x,y) by checking squared distances of all
+ * points with AVX (4 points) or SSE2 (2 points) vectors when available.
+ * Fills idx_in_range with the indices of points in range (in order) and
+ * returns the number found.
  */
-std::vector<double> DiffPoly(std::vector<double> coeffs) {
-  std::vector<double> diff_coeffs;
-  for (int i = 1; i < coeffs.size(); ++i) {
-    diff_coeffs.push_back(i*coeffs[i]);
+int CullPointsInRange(const double *pts_x, const double *pts_y, int num_pts,
+                      double x, double y, double range, int *idx_in_range) {
+  
+  const double range2 = sq(range);
+  int num_in_range = 0;
+  int i = 0;
+  
+#if defined(__AVX__)
+  const __m256d v_x = _mm256_set1_pd(x);
+  const __m256d v_y = _mm256_set1_pd(y);
+  const __m256d v_range2 = _mm256_set1_pd(range2);
+  for (; i + 4 <= num_pts; i += 4) {
+    const __m256d v_dx = _mm256_sub_pd(_mm256_loadu_pd(pts_x + i), v_x);
+    const __m256d v_dy = _mm256_sub_pd(_mm256_loadu_pd(pts_y + i), v_y);
+    const __m256d v_dist2 = _mm256_add_pd(_mm256_mul_pd(v_dx, v_dx),
+                                          _mm256_mul_pd(v_dy, v_dy));
+    const int mask = _mm256_movemask_pd(_mm256_cmp_pd(v_dist2, v_range2,
+                                                      _CMP_LT_OQ));
+    for (int j = 0; j < 4; ++j) {
+      if (mask & (1 << j)) { idx_in_range[num_in_range++] = i + j; }
+    }
   }
-  return diff_coeffs;
+#elif defined(__SSE2__)
+  const __m128d v_x = _mm_set1_pd(x);
+  const __m128d v_y = _mm_set1_pd(y);
+  const __m128d v_range2 = _mm_set1_pd(range2);
+  for (; i + 2 <= num_pts; i += 2) {
+    const __m128d v_dx = _mm_sub_pd(_mm_loadu_pd(pts_x + i), v_x);
+    const __m128d v_dy = _mm_sub_pd(_mm_loadu_pd(pts_y + i), v_y);
+    const __m128d v_dist2 = _mm_add_pd(_mm_mul_pd(v_dx, v_dx),
+                                       _mm_mul_pd(v_dy, v_dy));
+    const int mask = _mm_movemask_pd(_mm_cmplt_pd(v_dist2, v_range2));
+    for (int j = 0; j < 2; ++j) {
+      if (mask & (1 << j)) { idx_in_range[num_in_range++] = i + j; }
+    }
+  }
+#endif
+  
+  // Scalar loop for points remaining after vector lanes
+  for (; i < num_pts; ++i) {
+    if ((sq(pts_x[i] - x) + sq(pts_y[i] - y)) < range2) {
+      idx_in_range[num_in_range++] = i;
+    }
+  }
+  
+  return num_in_range;
+}
+
+/**
+ * Calculate the Jerk Minimizing Trajectory that connects the start state
+ * to the end state in time t_end.  The state variables are [s, s_dot, s_dotdot]
+ * and the output is the 5th order polynomial with coefficients a0-a5:
+ * s(t) = a0 + a1 * t + a2 * t^2 + a3 * t^3 + a4 * t^4 + a5 * t^5
+ *
+ * a3-a5 are solved with the closed-form inverse of the boundary matrix
+ *   [  t^3     t^4     t^5  ]^-1   [  10/t^3   -4/t^2    1/(2t)   ]
+ *   [ 3t^2    4t^3    5t^4  ]    = [ -15/t^4    7/t^3   -1/t^2    ]
+ *   [  6t    12t^2   20t^3  ]      [   6/t^5   -3/t^4    1/(2t^3) ]
+ * so no matrix is built or inverted.
+ */
+Poly<5> JMT(const double *start, const double *end, double t_end) {
+  
+  const double t_end2 = t_end * t_end;
+  const double t_inv = 1. / t_end;
+  const double t_inv3 = t_inv * t_inv * t_inv;
+  
+  // Remaining end state not reached by the start state's terms a0-a2
+  const double b0 = end[0] - (start[0] + start[1]*t_end + 0.5*start[2]*t_end2);
+  const double b1 = end[1] - (start[1] + start[2]*t_end);
+  const double b2 = end[2] - start[2];
+  
+  Poly<5> poly;
+  poly.a[0] = start[0];
+  poly.a[1] = start[1];
+  poly.a[2] = 0.5 * start[2];
+  poly.a[3] = (10.*b0 - 4.*b1*t_end + 0.5*b2*t_end2) * t_inv3;
+  poly.a[4] = (-15.*b0 + 7.*b1*t_end - b2*t_end2) * t_inv3 * t_inv;
+  poly.a[5] = (6.*b0 - 3.*b1*t_end + 0.5*b2*t_end2) * t_inv3 * t_inv*t_inv;
+  
+  return poly;
 }
 
 /**
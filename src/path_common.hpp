@@ -15,7 +15,7 @@
 #include <vector>
 #include <deque>
 #include <map>
-#include "Eigen-3.3/Eigen/Dense"
+#include <algorithm>
 #include "spline.h"
 
 /**
@@ -32,18 +32,35 @@ constexpr int kDBGTrajectory = 0;
 
 // Simulation and Track
 constexpr double kSimCycleTime = 0.02; // sec
-constexpr double kMaxS = 6945.554; // m, max S before track wraps back to 0
 constexpr double kMapInterpInc = 1.; // m, interpolated increment in Frenet S
 constexpr double kLaneWidth = 3.9; // m, width per lane
 constexpr int kNumLanes = 3; // # of lanes in the road
+constexpr double kMapGridCellSize = 10.; // m, cell size of waypoint grid index
+constexpr int kWaypointHintWindow = 30; // # waypoints to search around hint
+constexpr int kFrenetMaxRefineSteps = 8; // # max segment steps to project pt
+constexpr double kWaypointHintMaxDist = 15.; // m, max dist to accept hint wp
+constexpr int kXYBatchBlockSize = 64; // # pts per block for batch (s,d)->(x,y)
+constexpr int kFrenetBatchMinPerThread = 256; // # pts per thread, batch (x,y)
+constexpr int kMapCacheVersion = 3; // compiled map cache file format version
+constexpr int kMapTileShift = 8; // 2^shift waypoints per map tile
+constexpr int kMapTileMask = (1 << kMapTileShift) - 1; // waypoint idx in tile
+constexpr int kMapMaxResidentTiles = 16; // # of tiles kept by tiled map LRU
+constexpr int kMapTileSplineMargin = 6; // # raw waypoints each side to fit tile
+constexpr double kMapMaxFlatLength = 100000.; // m, longer maps are tiled
+constexpr double kMapRasterCellSize = 2.; // m, cell size of XY->Frenet raster
+constexpr int kMapRasterBlockShift = 3; // 2^shift cells per raster block side
+constexpr double kMapRasterMaxDist = 20.; // m, raster cells near road center
 
 // Main Path Planner
 constexpr int kPathCycleTimeMS = 200; // ms, path planner cycle time
+constexpr int kCycleArenaBlockSize = 1 << 20; // bytes, per-cycle arena block
 constexpr double kSensorRange = 100.; // m, limit detected cars within range
+constexpr int kLaneIndexCapacity = 32; // # cars per lane preallocated to sort
 
 // Prediction
 constexpr double kLatVelLaneChange = (5.) / 2.23694; // (mph)->m/s to judge LC
 constexpr double kPredictTime = 1.5; // sec, time to predict car paths
+constexpr int kNumPredIntents = 3; // # max predicted intents per car
 
 // Behavior
 constexpr double kCostDistAhead = 5.; // cost gain
@@ -66,6 +83,7 @@ constexpr double kPLCCloseDist = 11.; // m, dist to judge close car during PLC
 // Trajectory
 constexpr double kPathBufferTime = 0.5; // sec, duration of prev path buffer
 constexpr double kNewPathTime = 2.5; // sec, duration of new planned path
+constexpr int kEgoTrajCapacity = 512; // # of states in ego traj (power of 2)
 constexpr double kMinTrajPntDist = (3.) / 2.23694 * kSimCycleTime; // (mph)->m
 constexpr double kMaxA = 8.; // m/s^2, target max accel to keep peak < 10m/s^2
 constexpr double kSpdAdjOffset = (2.) / 2.23694; // (mph)->m/s, spd adj offset
@@ -73,18 +91,178 @@ constexpr double kAccAdjOffset = 1.; // m/s^2, accel adj offset
 constexpr int kAccelAveSamples = 10; // # samples for smoothing ave accel
 constexpr double kCollisionSThresh = 8.; // m, gap S to judge collision risk
 constexpr double kCollisionDThresh = 3.; // m, gap D to judge collision risk
-constexpr int kEvalRiskStep = 10; // # time steps for risk check interval
+constexpr int kEvalRiskStep = 10; // # time steps per unit of risk time
+constexpr double kEvalRiskWindowTime = 0.5; // sec, 1st risk window (doubles)
+constexpr double kPolyRootTol = 1e-4; // sec, time tolerance of poly roots
+constexpr double kOccGridCellS = 2.; // m, occupancy grid cell length in s
+constexpr double kOccGridCellD = 1.; // m, occupancy grid cell width in d
+constexpr double kOccGridBehind = 20.; // m, occupancy grid range behind ego
+constexpr double kOccGridAhead = 60.; // m, occupancy grid range ahead of ego
 constexpr int kTrajGenNum = 5; // # of possible traj variations to sample from
 constexpr double kRandSpdMean = (5.) / 2.23694; // (mph)->m/s, speed adj mean
 constexpr double kRandSpdDev = (2.) / 2.23694; // (mph)->m/s, speed adj std dev
 constexpr double kRandTimeMean = 0.; // sec, path time adj mean
 constexpr double kRandTimeDev = 0.6; // sec, path time adj std dev
 constexpr double kMinTrajTime = 1.5; // sec, guard min traj time
+constexpr int kTimeBasisSteps = 300; // # sim steps in time basis tables (6s)
 constexpr double kTrajCostRisk = 10.; // cost gain for traj collision risk
 constexpr double kTrajCostDeviation = 1.; // cost gain for deviation from base
 constexpr double kTrajCostThresh = 20.; // cost thresh to judge traj risk
 constexpr double kBackupTgtSpeedDec = (10.) / 2.23694; // (mph)->m/s spd steps
 
+class FrenetMap;
+
+/**
+ * Result of projecting a Cartesian position and velocity onto the map, with
+ * Frenet (s,d), Frenet velocity (s_dot,d_dot), the waypoint at the start of
+ * the map segment projected onto, and the segment's unit tangent and normal
+ * (normal points toward +d)
+ */
+struct FrenetProjection {
+  double s;
+  double d;
+  double s_dot;
+  double d_dot;
+  int seg_wp;
+  double tan_x;
+  double tan_y;
+  double norm_x;
+  double norm_y;
+};
+
+/**
+ * Polynomial of fixed degree N with form y = a0 + a1*x + ... + aN*x^N, with
+ * coefficients a[0] to a[N].  Loops are over the compile-time degree so they
+ * are fully unrolled.
+ */
+template <int N>
+struct Poly {
+  double a[N + 1];
+  
+  // Evaluate y at x with Horner's method
+  double Eval(double x) const {
+    double y = a[N];
+    for (int i = N - 1; i >= 0; --i) { y = y * x + a[i]; }
+    return y;
+  }
+  
+  // Derivative polynomial of degree N-1
+  Poly<N - 1> Diff() const {
+    Poly<N - 1> diff_poly;
+    for (int i = 1; i <= N; ++i) { diff_poly.a[i-1] = i * a[i]; }
+    return diff_poly;
+  }
+  
+  // Evaluate y and its 1st and 2nd derivatives at x in one fused Horner pass
+  void EvalDerivs(double x, double *y, double *y_dot, double *y_dotdot) const {
+    double p = a[N];
+    double dp = 0.;
+    double ddp = 0.; // half of 2nd derivative
+    for (int i = N - 1; i >= 0; --i) {
+      ddp = ddp * x + dp;
+      dp = dp * x + p;
+      p = p * x + a[i];
+    }
+    *y = p;
+    *y_dot = dp;
+    *y_dotdot = 2. * ddp;
+  }
+  
+  // Evaluate y and its 1st and 2nd derivatives at each point of a grid of
+  // num_pts x values
+  void EvalDerivsBatch(const double *pts_x, int num_pts, double *pts_y,
+                       double *pts_y_dot, double *pts_y_dotdot) const {
+    for (int i = 0; i < num_pts; ++i) {
+      EvalDerivs(pts_x[i], &pts_y[i], &pts_y_dot[i], &pts_y_dotdot[i]);
+    }
+  }
+  
+  // Polynomial of y at x + dx, by Taylor shift with repeated synthetic
+  // division
+  Poly<N> Shift(double dx) const {
+    Poly<N> shift_poly = *this;
+    for (int k = 0; k < N; ++k) {
+      for (int i = N - 1; i >= k; --i) {
+        shift_poly.a[i] += dx * shift_poly.a[i+1];
+      }
+    }
+    return shift_poly;
+  }
+  
+  // Bounds of y over x in [0, x_end] from the Bernstein coefficients on that
+  // range (the curve is within their convex hull)
+  void GetBounds(double x_end, double *y_min, double *y_max) const {
+    double c[N + 1]; // coefficients scaled to x in [0, 1]
+    double x_pow = 1.;
+    for (int j = 0; j <= N; ++j) {
+      c[j] = a[j] * x_pow;
+      x_pow *= x_end;
+    }
+    *y_min = c[0];
+    *y_max = c[0];
+    for (int i = 1; i <= N; ++i) {
+      // b[i] = sum of C(i,j) / C(N,j) * c[j] for j = 0 to i
+      double b = 0.;
+      double binom_i = 1.;
+      double binom_n = 1.;
+      for (int j = 0; j <= i; ++j) {
+        b += binom_i / binom_n * c[j];
+        binom_i = binom_i * (i - j) / (j + 1);
+        binom_n = binom_n * (N - j) / (j + 1);
+      }
+      *y_min = std::min(*y_min, b);
+      *y_max = std::max(*y_max, b);
+    }
+  }
+  
+  // Find roots where y changes sign within (x_lo, x_hi)
+  int FindRoots(double x_lo, double x_hi, double *roots) const;
+};
+
+/**
+ * Find the roots where the polynomial changes sign within (x_lo, x_hi).  The
+ * range is split into monotonic pieces at the roots of the derivative, and
+ * each piece with a sign change has one root found by bisection to within
+ * kPolyRootTol.  Returns the number of roots (up to N) and sets them in
+ * ascending order in roots.
+ */
+template <int N>
+int Poly<N>::FindRoots(double x_lo, double x_hi, double *roots) const {
+  
+  // Split range at derivative's roots
+  double x_splits[N + 1];
+  x_splits[0] = x_lo;
+  int num_splits = 1 + Diff().FindRoots(x_lo, x_hi, &x_splits[1]);
+  x_splits[num_splits++] = x_hi;
+  
+  int num_roots = 0;
+  for (int k = 0; k < num_splits - 1; ++k) {
+    double lo = x_splits[k];
+    double hi = x_splits[k+1];
+    bool is_neg_lo = (Eval(lo) < 0.);
+    if (is_neg_lo == (Eval(hi) < 0.)) { continue; }
+    
+    while ((hi - lo) > kPolyRootTol) {
+      const double mid = 0.5 * (lo + hi);
+      if ((Eval(mid) < 0.) == is_neg_lo) { lo = mid; }
+      else { hi = mid; }
+    }
+    roots[num_roots++] = 0.5 * (lo + hi);
+  }
+  
+  return num_roots;
+}
+
+// Linear root ends the recursion through the derivatives
+template <>
+inline int Poly<1>::FindRoots(double x_lo, double x_hi, double *roots) const {
+  if (a[1] == 0.) { return 0; }
+  const double x = -a[0] / a[1];
+  if ((x <= x_lo) || (x >= x_hi)) { return 0; }
+  roots[0] = x;
+  return 1;
+}
+
 /**
  * Basic parameter helpers
  */
@@ -103,31 +281,55 @@ std::vector<std::vector<double>> InterpolateMap(std::vector<double> map_s,
                                                 std::vector<double> map_y,
                                                 std::vector<double> map_dx,
                                                 std::vector<double> map_dy,
-                                                double s_dist_inc);
+                                                double s_dist_inc,
+                                                double max_s);
+
+double GetTrackLength(const std::vector<double> &map_s,
+                      const std::vector<double> &map_x,
+                      const std::vector<double> &map_y);
+
+int ClosestWaypoint(double x, double y, const double *pts_x,
+                    const double *pts_y, int num_pts);
 
-int ClosestWaypoint(double x, double y, const std::vector<double> &map_x,
-                    const std::vector<double> &map_y);
+int ClosestWaypoint(double x, double y, const FrenetMap &frenet_map);
+
+int RasterWaypoint(double x, double y, const FrenetMap &frenet_map);
+
+int ClosestWaypointFromSeed(double x, double y, int seed_wp,
+                            const FrenetMap &frenet_map);
+
+int ClosestWaypointNearHint(double x, double y, int wp_hint,
+                            const FrenetMap &frenet_map);
 
 std::vector<double> GetHiResXY(double s, double d,
-                               const std::vector<double> &map_s,
-                               const std::vector<double> &map_x,
-                               const std::vector<double> &map_y);
+                               const FrenetMap &frenet_map);
+
+void GetHiResXYBatch(const double *pts_s, const double *pts_d, int num_pts,
+                     const FrenetMap &frenet_map,
+                     double *pts_x, double *pts_y);
+
+double GetHiResCurvature(double s, const FrenetMap &frenet_map);
 
-std::vector<double> GetHiResFrenet(double x, double y,
-                                   const std::vector<double> &map_s,
-                                   const std::vector<double> &map_x,
-                                   const std::vector<double> &map_y);
+void GetHiResCurvatureBatch(const double *pts_s, int num_pts,
+                            const FrenetMap &frenet_map,
+                            double *curvatures);
 
-std::vector<double> GetFrenetVelocity(double vx, double vy, int closest_wp,
-                                      const std::vector<double> &map_dx,
-                                      const std::vector<double> &map_dy);
+FrenetProjection GetHiResFrenet(double x, double y, double vx, double vy,
+                                const FrenetMap &frenet_map,
+                                int *wp_hint);
 
-std::vector<double> JMT(std::vector< double> start, std::vector<double> end,
-                        double t_end);
+void GetHiResFrenetBatch(const double *pts_x, const double *pts_y,
+                         const double *pts_vx, const double *pts_vy,
+                         int num_pts,
+                         const FrenetMap &frenet_map,
+                         int *wp_hints,
+                         double *pts_s, double *pts_d,
+                         double *pts_s_dot, double *pts_d_dot);
 
-double EvalPoly(double x, std::vector<double> coeffs);
+int CullPointsInRange(const double *pts_x, const double *pts_y, int num_pts,
+                      double x, double y, double range, int *idx_in_range);
 
-std::vector<double> DiffPoly(std::vector<double> coeffs);
+Poly<5> JMT(const double *start, const double *end, double t_end);
 
 double LogCost(double x, double x_saturate);
 
@@ -9,33 +9,41 @@
 
 /**
  * Predict detected car trajectories over fixed time horizon for each possible
- * behavior with associated probabilities.  Update the detected_cars map to add
- * the predicted trajectories to each detected vehicle object.
+ * behavior with associated probabilities.  Update the detected_cars table to
+ * add the predicted trajectories to each detected vehicle object.
  */
 void PredictBehavior(const EgoVehicle &ego_car,
-                     const std::map<int, std::vector<int>> &car_ids_by_lane,
-                     const std::vector<double> &map_interp_s,
-                     const std::vector<double> &map_interp_x,
-                     const std::vector<double> &map_interp_y,
-                     std::map<int, DetectedVehicle> *detected_cars) {
+                     const LaneIndex &car_ids_by_lane,
+                     const FrenetMap &frenet_map,
+                     DetectedVehicleTable *detected_cars) {
   
-  // Loop through each lane of veh ID's
-  for (auto it = car_ids_by_lane.begin(); it != car_ids_by_lane.end(); ++it) {
-    auto car_ids_in_lane = it->second;
+  // Loop through each lane of veh ID's, then the cars out of indexed lanes
+  const int num_lanes = car_ids_by_lane.GetNumLanes();
+  for (int lane = 0; lane <= num_lanes; ++lane) {
+    const LaneCarsView car_ids_in_lane = ((lane < num_lanes)
+        ? car_ids_by_lane.GetLaneCars(lane)
+        : car_ids_by_lane.GetOutOfLanesCars());
     
-    // Loop through each lane's vector of car ID's
-    for (int i = 0; i < car_ids_in_lane.size(); ++i) {
-      int cur_car_id = car_ids_in_lane[i];
-      DetectedVehicle* cur_car_ptr = &detected_cars->at(cur_car_id);
-      const VehState cur_car_state = cur_car_ptr->GetState();
-      const int cur_car_lane = cur_car_ptr->GetLane();
+    // Loop through each lane's sorted car ID's
+    for (int i = 0; i < car_ids_in_lane.size; ++i) {
+      int cur_car_id = car_ids_in_lane[i].id;
+      const int idx_cur_car = detected_cars->Find(cur_car_id);
+      const VehState &cur_car_state = detected_cars->GetCar(idx_cur_car)
+                                        .GetState();
+      const int cur_car_lane = detected_cars->GetLane(idx_cur_car);
       
       // Predict behavior for this detected car
-      cur_car_ptr->ClearPredTrajs();
-      std::map<VehIntents, VehTrajectory> new_pred_trajs;
       double t_tgt = kPredictTime; // use same prediction time for all intents
       double v_tgt;
       double d_tgt;
+      
+      // Targets and probabilities of each intent, with all of the intents'
+      // predicted trajs generated together in one batch
+      VehIntents pred_intents[kNumPredIntents];
+      double pred_v_tgts[kNumPredIntents];
+      double pred_d_tgts[kNumPredIntents];
+      double pred_probs[kNumPredIntents];
+      int num_pred = 0;
       const auto car_ahead = FindCarInLane(kFront, cur_car_lane, cur_car_id,
                                            ego_car, (*detected_cars),
                                            car_ids_by_lane);
@@ -50,7 +58,8 @@ void PredictBehavior(const EgoVehicle &ego_car,
       if (s_rel_ahead < kTgtFollowDist) {
         double v_car_ahead;
         if (car_id_ahead != ego_car.GetID()) {
-          v_car_ahead = detected_cars->at(car_id_ahead).GetState().s_dot;
+          v_car_ahead = detected_cars->GetSDot(
+                          detected_cars->Find(car_id_ahead));
         }
         else {
           v_car_ahead = ego_car.GetState().s_dot;
@@ -64,11 +73,12 @@ void PredictBehavior(const EgoVehicle &ego_car,
       // Set target d to keep current value
       d_tgt = cur_car_state.d;
       
-      // Generate predicted traj for KeepLane intent
-      auto traj_KL = GetTrajectory(cur_car_state, t_tgt, v_tgt, d_tgt, kMaxA,
-                                   map_interp_s, map_interp_x, map_interp_y);
-      traj_KL.probability = 1.0;
-      new_pred_trajs[kKeepLane] = traj_KL;
+      // Add predicted traj for KeepLane intent
+      const int idx_KL = num_pred++;
+      pred_intents[idx_KL] = kKeepLane;
+      pred_v_tgts[idx_KL] = v_tgt;
+      pred_d_tgts[idx_KL] = d_tgt;
+      pred_probs[idx_KL] = 1.0;
       
       //// LaneChangeLeft intent predicted traj ////
       // Add if lane is open to left and set high prob if car ahead is close
@@ -78,19 +88,19 @@ void PredictBehavior(const EgoVehicle &ego_car,
         v_tgt = cur_car_state.s_dot; // keep current speed
         d_tgt = tgt_lane2tgt_d(cur_car_lane - 1); // target left lane
         
-        // Generate predicted traj for LaneChangeLeft intent
-        auto traj_LCL = GetTrajectory(cur_car_state, t_tgt, v_tgt, d_tgt, kMaxA,
-                                      map_interp_s, map_interp_x, map_interp_y);
-
         // LCL probability 0.1 default, 0.3 if close to car ahead, 0.8 if
         // already moving to the left fast enough
         double prob_LCL = 0.1;
         if (s_rel_ahead < kTgtFollowDist) { prob_LCL = 0.3; }
         if (cur_car_state.d_dot < -kLatVelLaneChange) { prob_LCL = 0.8; }
-        traj_LCL.probability = prob_LCL;
         
-        new_pred_trajs[kLaneChangeLeft] = traj_LCL;
-        new_pred_trajs.at(kKeepLane).probability -= prob_LCL;
+        // Add predicted traj for LaneChangeLeft intent
+        pred_intents[num_pred] = kLaneChangeLeft;
+        pred_v_tgts[num_pred] = v_tgt;
+        pred_d_tgts[num_pred] = d_tgt;
+        pred_probs[num_pred] = prob_LCL;
+        num_pred++;
+        pred_probs[idx_KL] -= prob_LCL;
       }
       
       //// LaneChangeRight intent predicted traj ////
@@ -101,36 +111,48 @@ void PredictBehavior(const EgoVehicle &ego_car,
         v_tgt = cur_car_state.s_dot; // keep current speed
         d_tgt = tgt_lane2tgt_d(cur_car_lane + 1); // target right lane
         
-        // Generate predicted traj for LaneChangeRight intent
-        auto traj_LCR = GetTrajectory(cur_car_state, t_tgt, v_tgt, d_tgt, kMaxA,
-                                      map_interp_s, map_interp_x, map_interp_y);
-        
         // LCR probability 0.1 default, 0.3 if close to car ahead, 0.8 if
         // already moving to the right fast enough
         double prob_LCR = 0.1;
         if (s_rel_ahead < kTgtFollowDist) { prob_LCR = 0.3; }
         if (cur_car_state.d_dot > kLatVelLaneChange) { prob_LCR = 0.8; }
-        traj_LCR.probability = prob_LCR;
         
-        new_pred_trajs[kLaneChangeRight] = traj_LCR;
-        new_pred_trajs.at(kKeepLane).probability -= prob_LCR;
+        // Add predicted traj for LaneChangeRight intent
+        pred_intents[num_pred] = kLaneChangeRight;
+        pred_v_tgts[num_pred] = v_tgt;
+        pred_d_tgts[num_pred] = d_tgt;
+        pred_probs[num_pred] = prob_LCR;
+        num_pred++;
+        pred_probs[idx_KL] -= prob_LCR;
+      }
+      
+      // Generate predicted trajs of all intents in one batch
+      auto pred_trajs = GetTrajectories(cur_car_state, t_tgt, pred_v_tgts,
+                                        pred_d_tgts, num_pred, kMaxA,
+                                        frenet_map);
+      PredTrajectories new_pred_trajs;
+      new_pred_trajs.size = num_pred;
+      for (int k = 0; k < num_pred; ++k) {
+        pred_trajs[k].probability = pred_probs[k];
+        new_pred_trajs.intents[k] = pred_intents[k];
+        new_pred_trajs.trajs[k] = GetPredTrajectory(pred_trajs[k]);
       }
       
       // Set predicted trajectories to current car
-      cur_car_ptr->SetPredTrajs(new_pred_trajs);
+      detected_cars->SetPredTrajs(idx_cur_car, new_pred_trajs);
     }
   }
   
   // Debug logging
   if (kDBGPrediction != 0) {
     std::cout << "Predicted intents:" << std::endl;
-    for (auto it = detected_cars->begin(); it != detected_cars->end(); ++it) {
-      std::cout << "car #" << it->first << " - ";
-      auto predictions = it->second.GetPredTrajs();
-      for (auto it2 = predictions.begin();
-           it2 != predictions.end(); ++it2) {
-        std::cout << it2->first << " = "
-        << it2->second.probability << ", ";
+    for (int idx = 0; idx < detected_cars->Size(); ++idx) {
+      std::cout << "car #" << detected_cars->GetID(idx) << " - ";
+      const PredTrajectories &predictions = detected_cars->GetCar(idx)
+                                              .GetPredTrajs();
+      for (int k = 0; k < predictions.size; ++k) {
+        std::cout << predictions.intents[k] << " = "
+        << predictions.trajs[k].probability << ", ";
       }
       std::cout << std::endl;
     }
@@ -13,10 +13,8 @@
 #include "trajectory.hpp"
 
 void PredictBehavior(const EgoVehicle &ego_car,
-                     const std::map<int, std::vector<int>> &car_ids_by_lane,
-                     const std::vector<double> &map_interp_s,
-                     const std::vector<double> &map_interp_x,
-                     const std::vector<double> &map_interp_y,
-                     std::map<int, DetectedVehicle> *detected_cars);
+                     const LaneIndex &car_ids_by_lane,
+                     const FrenetMap &frenet_map,
+                     DetectedVehicleTable *detected_cars);
 
 #endif /* prediction_hpp */
@@ -13,11 +13,11 @@
  * trajectory and the size of the prev_path unprocessed points sent by the
  * simulator.
  */
-int GetCurrentTrajIndex(const VehTrajectory &prev_ego_traj,
+int GetCurrentTrajIndex(const TrajRingBuffer &prev_ego_traj,
                         int prev_path_size) {
   
   int idx_current_pt = 0;
-  const int traj_size = prev_ego_traj.states.size();
+  const int traj_size = prev_ego_traj.Size();
   if (traj_size > prev_path_size) {
     idx_current_pt = (traj_size - prev_path_size - 1);
   }
@@ -28,23 +28,21 @@ int GetCurrentTrajIndex(const VehTrajectory &prev_ego_traj,
 /**
  * Use the ego car's current (x,y) position and the previous trajectory to find
  * the corresponding state values [s, s_dot, s_dotdot, d, d_dot, d_dotdot] with
- * the index for the current state and the map waypoints for (x,y)->(s,d)
- * Frenet conversion.  Return the current ego state.
+ * the index for the current state and the Frenet map for (x,y)->(s,d)
+ * conversion.  Return the current ego state and update the ego car's
+ * closest waypoint hint (ego_wp_hint) by ptr.
  */
 VehState ProcessEgoState(double car_x, double car_y, int idx_current_pt,
-                         const VehTrajectory &prev_ego_traj,
-                         const std::vector<double> &map_interp_s,
-                         const std::vector<double> &map_interp_x,
-                         const std::vector<double> &map_interp_y) {
+                         const TrajRingBuffer &prev_ego_traj,
+                         const FrenetMap &frenet_map,
+                         int *ego_wp_hint) {
   VehState ego_state;
   
   // Convert (x,y) to Frenet (s,d) using interpolated map waypoints
-  std::vector<double> car_sd = GetHiResFrenet(car_x, car_y,
-                                              map_interp_s,
-                                              map_interp_x,
-                                              map_interp_y);
-  const double car_s = car_sd[0];
-  const double car_d = car_sd[1];
+  const FrenetProjection car_sd = GetHiResFrenet(car_x, car_y, 0., 0.,
+                                                 frenet_map, ego_wp_hint);
+  const double car_s = car_sd.s;
+  const double car_d = car_sd.d;
   
   // Find s_dot, s_dot_dot and d_dot, d_dot_dot at the index for the current
   // state in the previous ego trajectory
@@ -52,11 +50,11 @@ VehState ProcessEgoState(double car_x, double car_y, int idx_current_pt,
   double car_s_dotdot = 0.;
   double car_d_dot = 0.;
   double car_d_dotdot = 0.;
-  if (prev_ego_traj.states.size() > 0) {
-    car_s_dot = prev_ego_traj.states[idx_current_pt].s_dot;
-    car_s_dotdot = prev_ego_traj.states[idx_current_pt].s_dotdot;
-    car_d_dot = prev_ego_traj.states[idx_current_pt].d_dot;
-    car_d_dotdot = prev_ego_traj.states[idx_current_pt].d_dotdot;
+  if (prev_ego_traj.Size() > 0) {
+    car_s_dot = prev_ego_traj[idx_current_pt].s_dot;
+    car_s_dotdot = prev_ego_traj[idx_current_pt].s_dotdot;
+    car_d_dot = prev_ego_traj[idx_current_pt].d_dot;
+    car_d_dotdot = prev_ego_traj[idx_current_pt].d_dotdot;
   }
   
   // Pack state
@@ -72,8 +70,7 @@ VehState ProcessEgoState(double car_x, double car_y, int idx_current_pt,
   // Debug logging
   if (kDBGSensorFusion != 0) {
     // Check (x,y)-(s,d) conversion accuracy
-    std::vector<double> car_xy = GetHiResXY(car_s, car_d, map_interp_s,
-                                            map_interp_x, map_interp_y);
+    std::vector<double> car_xy = GetHiResXY(car_s, car_d, frenet_map);
     
     std::cout << "x: " << ego_state.x << ", y: " << ego_state.y
               << ", xy->s: " << car_s << ", xy->d: " << car_d
@@ -86,139 +83,137 @@ VehState ProcessEgoState(double car_x, double car_y, int idx_current_pt,
 
 /**
  * Process sensor_fusion data to find detected cars within sensor range and
- * modify the detected_cars map to add/update the detected vehicles' states.
- * detected_cars: key = veh ID, val = DetectedVehicle objects
+ * modify the detected_cars table to add/update the detected vehicles' states.
+ *
+ * The sensor_fusion rows are processed as a batch:
+ *   1. Gather (x,y) of all rows and cull to cars within sensor range
+ *   2. Gather in-range cars' data and waypoint hints into a SensedCarBatch
+ *   3. Transform the batch to Frenet (split over threads if large)
+ *   4. Add/update detected cars from the batch
+ * The working arrays and the batch are drawn from the per-cycle arena.
  */
 void ProcessDetectedCars(const EgoVehicle &ego_car,
                          const std::vector<std::vector<double>> &sensor_fusion,
-                         const std::vector<double> &map_interp_s,
-                         const std::vector<double> &map_interp_x,
-                         const std::vector<double> &map_interp_y,
-                         const std::vector<double> &map_interp_dx,
-                         const std::vector<double> &map_interp_dy,
-                         std::map<int, DetectedVehicle> *detected_cars) {
+                         const FrenetMap &frenet_map,
+                         DetectedVehicleTable *detected_cars) {
+  
+  const int num_sensed = sensor_fusion.size();
+  const VehState &ego_state = ego_car.GetState();
+  Arena *arena = &GetCycleArena();
   
   // Check all sensor fusion vehicles for distance from ego car
-  for (int i = 0; i < sensor_fusion.size(); ++i) {
+  ArenaVector<double> all_x(num_sensed, 0., ArenaAllocator<double>(arena));
+  ArenaVector<double> all_y(num_sensed, 0., ArenaAllocator<double>(arena));
+  for (int i = 0; i < num_sensed; ++i) {
+    all_x[i] = sensor_fusion[i][1];
+    all_y[i] = sensor_fusion[i][2];
+  }
+  ArenaVector<int> idx_in_range(num_sensed, 0, ArenaAllocator<int>(arena));
+  const int num_in_range = CullPointsInRange(all_x.data(), all_y.data(),
+                                             num_sensed, ego_state.x,
+                                             ego_state.y, kSensorRange,
+                                             idx_in_range.data());
+  
+  // Vehicles outside of sensor range, remove them from detected_cars table
+  ArenaVector<bool> is_in_range(num_sensed, false,
+                                ArenaAllocator<bool>(arena));
+  for (int k = 0; k < num_in_range; ++k) {
+    is_in_range[idx_in_range[k]] = true;
+  }
+  for (int i = 0; i < num_sensed; ++i) {
     const int sensed_id = sensor_fusion[i][0];
-    const double sensed_x = sensor_fusion[i][1];
-    const double sensed_y = sensor_fusion[i][2];
-    const VehState ego_state = ego_car.GetState();
-    const double dist_to_sensed = Distance(ego_state.x, ego_state.y,
-                                           sensed_x, sensed_y);
-    
-    // Process detected cars within sensor range
-    if (dist_to_sensed < kSensorRange) {
-      const double sensed_vx = sensor_fusion[i][3];
-      const double sensed_vy = sensor_fusion[i][4];
-      
-      auto det_car_sd = GetHiResFrenet(sensed_x, sensed_y, map_interp_s,
-                                       map_interp_x, map_interp_y);
-      const double sensed_s = det_car_sd[0];
-      const double sensed_d = det_car_sd[1];
-      
-      // Calculate s_dot and d_dot
-      const int sensed_closest_wp = ClosestWaypoint(sensed_x, sensed_y,
-                                                    map_interp_x, map_interp_y);
+    if ((is_in_range[i] == false) && detected_cars->Contains(sensed_id)) {
+      detected_cars->Erase(sensed_id);
       
-      auto v_frenet = GetFrenetVelocity(sensed_vx, sensed_vy, sensed_closest_wp,
-                                        map_interp_dx, map_interp_dy);
-      const double calc_s_dot = v_frenet[0];
-      const double calc_d_dot = v_frenet[1];
-      
-      // Set detected car state values, assuming constant accel
-      VehState new_det_car_state;
-      new_det_car_state.x = sensed_x;
-      new_det_car_state.y = sensed_y;
-      new_det_car_state.s = sensed_s;
-      new_det_car_state.s_dot = calc_s_dot;
-      new_det_car_state.s_dotdot = 0.;
-      new_det_car_state.d = sensed_d;
-      new_det_car_state.d_dot = calc_d_dot;
-      new_det_car_state.d_dotdot = 0.;
-      
-      // Modify detected_cars map for this detected vehicle
-      if (detected_cars->count(sensed_id) == 0) {
-        // New sensed vehicle, build detected vehicle object to add
-        DetectedVehicle sensed_car = DetectedVehicle();
-        sensed_car.SetID(sensed_id);
-        sensed_car.UpdateState(new_det_car_state);
-        sensed_car.UpdateRelDist(ego_car);
-        
-        // Add new vehicle to detected_cars map
-        (*detected_cars)[sensed_car.GetID()] = sensed_car;
-        
-        // Debug logging
-        if (kDBGSensorFusion != 0) {
-          std::cout << "Added ID: " << (*detected_cars)[sensed_id].GetID()
-                    << std::endl;
-        }
-      }
-      else {
-        // Vehicle already in detected_cars map, just update values
-        detected_cars->at(sensed_id).UpdateState(new_det_car_state);
-        detected_cars->at(sensed_id).UpdateRelDist(ego_car);
-        
-        // Debug logging
-        if (kDBGSensorFusion != 0) {
-          std::cout << "Updated ID: " << detected_cars->at(sensed_id).GetID()
-                    << std::endl;
-        }
+      // Debug logging
+      if (kDBGSensorFusion != 0) {
+        std::cout << "Erased ID: " << sensed_id << std::endl;
       }
     }
-    else {
-      // Vehicle outside of sensor range, remove it from detected_cars map
-      if (detected_cars->count(sensed_id) > 0) {
-        detected_cars->erase(sensed_id);
-        
-        // Debug logging
-        if (kDBGSensorFusion != 0) {
-          std::cout << "Erased ID: " << sensed_id << std::endl;
-        }
-      }
+  }
+  
+  // Gather detected cars within sensor range into a batch, starting the
+  // closest waypoint search from the last one found for each car
+  SensedCarBatch batch(arena);
+  batch.Resize(num_in_range);
+  for (int k = 0; k < num_in_range; ++k) {
+    const int i = idx_in_range[k];
+    batch.id[k] = sensor_fusion[i][0];
+    batch.x[k] = sensor_fusion[i][1];
+    batch.y[k] = sensor_fusion[i][2];
+    batch.vx[k] = sensor_fusion[i][3];
+    batch.vy[k] = sensor_fusion[i][4];
+    batch.wp_hint[k] = -1;
+    const int idx_car = detected_cars->Find(batch.id[k]);
+    if (idx_car >= 0) {
+      batch.wp_hint[k] = detected_cars->GetCar(idx_car).GetWaypointHint();
+    }
+  }
+  
+  // Convert (x,y) and (vx,vy) to Frenet (s,d) and (s_dot,d_dot)
+  GetHiResFrenetBatch(batch.x.data(), batch.y.data(),
+                      batch.vx.data(), batch.vy.data(), num_in_range,
+                      frenet_map, batch.wp_hint.data(),
+                      batch.s.data(), batch.d.data(),
+                      batch.s_dot.data(), batch.d_dot.data());
+  
+  // Process detected cars within sensor range
+  for (int k = 0; k < num_in_range; ++k) {
+    const int sensed_id = batch.id[k];
+    
+    // Set detected car state values, assuming constant accel
+    VehState new_det_car_state;
+    new_det_car_state.x = batch.x[k];
+    new_det_car_state.y = batch.y[k];
+    new_det_car_state.s = batch.s[k];
+    new_det_car_state.s_dot = batch.s_dot[k];
+    new_det_car_state.s_dotdot = 0.;
+    new_det_car_state.d = batch.d[k];
+    new_det_car_state.d_dot = batch.d_dot[k];
+    new_det_car_state.d_dotdot = 0.;
+    
+    // Modify detected_cars table for this detected vehicle, adding it first
+    // if it's a new sensed vehicle
+    const bool is_new_car = !detected_cars->Contains(sensed_id);
+    const int idx_car = detected_cars->Insert(sensed_id);
+    detected_cars->UpdateCar(idx_car, new_det_car_state, batch.wp_hint[k],
+                             ego_car, frenet_map.GetMaxS());
+    
+    // Debug logging
+    if (kDBGSensorFusion != 0) {
+      std::cout << (is_new_car ? "Added ID: " : "Updated ID: ")
+                << detected_cars->GetID(idx_car) << std::endl;
     }
   }
 }
 
 /**
- * Group and sort detected vehicles in the detected_cars map into another map
- * car_ids_by_lane with key = lane #, val = vector of veh ID's.  The vectors
- * are sorted by relative s from the ego car.
+ * Group and sort detected vehicles in the detected_cars table into the lane
+ * index car_ids_by_lane (by ptr), with each lane's veh ID's sorted by relative
+ * s from the ego car.  The lane index is kept between cycles and updated
+ * incrementally from its previous ordering, and its neighbor table is rebuilt
+ * for this cycle's FindCarInLane checks.
  */
-std::map<int, std::vector<int>> SortDetectedCarsByLane(
-                          const std::map<int, DetectedVehicle> &detected_cars) {
-  
-  std::map<int, std::vector<int>> car_ids_by_lane;
-  
-  // Gather detected car ID's in a map by lane number
-  for (auto it = detected_cars.begin(); it != detected_cars.end(); ++it) {
-    car_ids_by_lane[it->second.GetLane()].push_back(it->second.GetID());
-  }
+void SortDetectedCarsByLane(const EgoVehicle &ego_car,
+                            const DetectedVehicleTable &detected_cars,
+                            LaneIndex *car_ids_by_lane) {
   
-  // Lambda sort car ID's in each lane by s relative to ego car
-  for (auto it = car_ids_by_lane.begin(); it != car_ids_by_lane.end(); ++it) {
-    // it->second is a vector of int for the car ID's in that lane;
-    std::sort(it->second.begin(), it->second.end(),
-              [&detected_cars](int &lhs, int &rhs) -> bool {
-                auto lhs_s_rel = detected_cars.at(lhs).GetRelS();
-                auto rhs_s_rel = detected_cars.at(rhs).GetRelS();
-                return lhs_s_rel > rhs_s_rel; // higher s_rel first
-              });
-  }
+  // Update detected car ID's by lane number, re-sort each lane and build the
+  // lane neighbor table
+  car_ids_by_lane->Update(ego_car, detected_cars);
   
   // Debug logging
   if (kDBGSensorFusion != 0) {
     // Print out car id's sorted by lane
     std::cout << "Cars sorted by lane:" << std::endl;
-    for (auto it = car_ids_by_lane.begin(); it != car_ids_by_lane.end(); ++it) {
-      std::cout << "lane #" << it->first << " - ";
-      for (int i = 0; i < it->second.size(); ++i) {
-        std::cout << it->second[i] << "= "
-                  << detected_cars.at(it->second[i]).GetRelS() << ", ";
+    for (int lane = 0; lane < car_ids_by_lane->GetNumLanes(); ++lane) {
+      const LaneCarsView lane_cars = car_ids_by_lane->GetLaneCars(lane);
+      if (lane_cars.size == 0) { continue; }
+      std::cout << "lane #" << lane << " - ";
+      for (int i = 0; i < lane_cars.size; ++i) {
+        std::cout << lane_cars[i].id << "= " << lane_cars[i].rel_s << ", ";
       }
       std::cout << std::endl;
     }
   }
-  
-  return car_ids_by_lane;
 }
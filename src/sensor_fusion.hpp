@@ -10,26 +10,60 @@
 
 #include <stdio.h>
 #include "vehicle.hpp"
+#include "frenet_map.hpp"
 
-int GetCurrentTrajIndex(const VehTrajectory &prev_ego_traj,
+// Structure of arrays for a batch of sensed cars' data and Frenet states,
+// with the arrays drawn from an arena
+struct SensedCarBatch {
+  ArenaVector<int> id;
+  ArenaVector<double> x;
+  ArenaVector<double> y;
+  ArenaVector<double> vx;
+  ArenaVector<double> vy;
+  ArenaVector<int> wp_hint;
+  ArenaVector<double> s;
+  ArenaVector<double> d;
+  ArenaVector<double> s_dot;
+  ArenaVector<double> d_dot;
+  
+  explicit SensedCarBatch(Arena *arena)
+      : id(ArenaAllocator<int>(arena)), x(ArenaAllocator<double>(arena)),
+        y(ArenaAllocator<double>(arena)), vx(ArenaAllocator<double>(arena)),
+        vy(ArenaAllocator<double>(arena)),
+        wp_hint(ArenaAllocator<int>(arena)), s(ArenaAllocator<double>(arena)),
+        d(ArenaAllocator<double>(arena)),
+        s_dot(ArenaAllocator<double>(arena)),
+        d_dot(ArenaAllocator<double>(arena)) { }
+  
+  void Resize(int num_cars) {
+    id.resize(num_cars);
+    x.resize(num_cars);
+    y.resize(num_cars);
+    vx.resize(num_cars);
+    vy.resize(num_cars);
+    wp_hint.resize(num_cars);
+    s.resize(num_cars);
+    d.resize(num_cars);
+    s_dot.resize(num_cars);
+    d_dot.resize(num_cars);
+  }
+};
+
+int GetCurrentTrajIndex(const TrajRingBuffer &prev_ego_traj,
                         int prev_path_size);
 
 VehState ProcessEgoState(double car_x, double car_y, int idx_current_pt,
-                         const VehTrajectory &prev_ego_traj,
-                         const std::vector<double> &map_interp_s,
-                         const std::vector<double> &map_interp_x,
-                         const std::vector<double> &map_interp_y);
+                         const TrajRingBuffer &prev_ego_traj,
+                         const FrenetMap &frenet_map,
+                         int *ego_wp_hint);
 
 void ProcessDetectedCars(const EgoVehicle &ego_car,
                          const std::vector<std::vector<double>> &sensor_fusion,
-                         const std::vector<double> &map_interp_s,
-                         const std::vector<double> &map_interp_x,
-                         const std::vector<double> &map_interp_y,
-                         const std::vector<double> &map_interp_dx,
-                         const std::vector<double> &map_interp_dy,
-                         std::map<int, DetectedVehicle> *detected_cars);
-
-std::map<int, std::vector<int>> SortDetectedCarsByLane(
-                           const std::map<int, DetectedVehicle> &detected_cars);
+                         const FrenetMap &frenet_map,
+                         DetectedVehicleTable *detected_cars);
+
+void SortDetectedCarsByLane(const EgoVehicle &ego_car,
+                            const DetectedVehicleTable &detected_cars,
+                            LaneIndex *car_ids_by_lane);
 
 #endif /* sensor_fusion_hpp */
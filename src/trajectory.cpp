@@ -7,36 +7,13 @@
 
 #include "trajectory.hpp"
 
-/**
- * Use a part of the previous ego trajectory as the start of the next
- * trajectory as a buffer to keep smooth continuity for communication between
- * the path planner and the simulator driving the points.
- * Returns the buffer portion set of states of the previous trajectory, or an
- * empty trajectory if the current index is at 0.
- */
-VehTrajectory GetBufferTrajectory(int idx_current_pt,
-                                  VehTrajectory prev_ego_traj) {
-  
-  VehTrajectory traj_prev_buffer;
-  int buffer_pts = kPathBufferTime / kSimCycleTime;
-  if (idx_current_pt > 0) {
-    int end_pt = std::min(idx_current_pt+1 + buffer_pts,
-                          int(prev_ego_traj.states.size()));
-    
-    for (int i = idx_current_pt+1; i < end_pt; ++i) {
-      traj_prev_buffer.states.push_back(prev_ego_traj.states[i]);
-    }
-  }
-  
-  return traj_prev_buffer;
-}
-
 /**
  * Get a new trajectory for the ego car with target end state based on the
  * target behavior by:
  *   a) Generate multiple traj's with random variations in target
  *      speed and time
- *   b) Limit the traj's max speed and accel in (x,y) to stay within limits
+ *   b) Limit the traj's max speed and accel in (x,y) to stay within limits,
+ *      estimated from the Frenet speeds and the road curvature
  *   c) Assign a cost to each traj based on accumulated collision
  *      risk from the predicted paths of detected vehicles, and
  *      the amount of deviation from the base target
@@ -44,15 +21,16 @@ VehTrajectory GetBufferTrajectory(int idx_current_pt,
  *      down in case all other trajs have cost above an allowable
  *      threshold
  *   e) Select the final traj with the lowest cost
+ *   f) Convert only the final traj's points to (x,y)
  *
- * Returns the new ego car best trajectory
+ * Returns the new ego car best trajectory, and sets the number of possible
+ * traj's whose cost evaluation was pruned early by ptr
  */
 VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
-                         const std::map<int, DetectedVehicle> &detected_cars,
-                         const std::map<int, std::vector<int>> &car_ids_by_lane,
-                         const std::vector<double> &map_interp_s,
-                         const std::vector<double> &map_interp_x,
-                         const std::vector<double> &map_interp_y) {
+                         const DetectedVehicleTable &detected_cars,
+                         const LaneIndex &car_ids_by_lane,
+                         const OccupancyGrid &occupancy_grid,
+                         const FrenetMap &frenet_map, int *num_pruned_trajs) {
 
   // Initialize random generators
   std::random_device rand_dev;
@@ -62,20 +40,24 @@ VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
 
   // Set start state
   VehState start_state;
-  const VehTrajectory ego_traj = ego_car.GetTraj();
-  if (ego_traj.states.size() > 0) {
-    start_state = ego_traj.states.back();
+  const TrajRingBuffer &ego_traj = ego_car.GetTraj();
+  if (ego_traj.Size() > 0) {
+    start_state = ego_traj.Back();
   }
   else {
     start_state = ego_car.GetState();
   }
   
   // Set target time and speed from behavior target
-  const VehBehavior ego_beh = ego_car.GetTgtBehavior();
+  const VehBehavior &ego_beh = ego_car.GetTgtBehavior();
   const int ego_lane = ego_car.GetLane();
   const double t_tgt = ego_beh.tgt_time;
   const double v_tgt = ego_beh.tgt_speed;
   const double a_tgt = kMaxA;
+  
+  // Get envelopes of detected cars' predicted paths for broad-phase culling
+  const PredEnvelopes pred_envelopes = GetPredEnvelopes(ego_car, detected_cars,
+                                                        frenet_map.GetMaxS());
 
   // Set target D based on behavior target lane
   double d_tgt;
@@ -95,7 +77,11 @@ VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
   }
   
   // Generate multiple potential trajectories
-  std::vector<VehTrajectory> possible_trajs;
+  ArenaVector<VehTrajectory> possible_trajs{
+                          ArenaAllocator<VehTrajectory>(&GetCycleArena())};
+  possible_trajs.reserve(kTrajGenNum + 1);
+  double cost_bound = kTrajCostThresh; // lowest traj cost so far
+  *num_pruned_trajs = 0;
   for (int i = 0; i < kTrajGenNum; ++i) {
     
     double v_delta = 0;
@@ -112,19 +98,17 @@ VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
     const double v_tgt_var = v_tgt - v_delta; // allow slower speed
     
     VehTrajectory traj_var = GetTrajectory(start_state, t_tgt_var, v_tgt_var,
-                                           d_tgt, a_tgt, map_interp_s,
-                                           map_interp_x, map_interp_y);
+                                           d_tgt, a_tgt, frenet_map);
 
     // Limit traj for max speed and accel
-    auto adj_ratios = CheckTrajFeasibility(traj_var);
-    
-    const double spd_adj_ratio = adj_ratios[0];
-    const double a_adj_ratio = adj_ratios[1];
+    double spd_adj_ratio;
+    double a_adj_ratio;
+    CheckTrajFeasibility(traj_var, frenet_map, &spd_adj_ratio, &a_adj_ratio);
     if ((spd_adj_ratio != 1.0) || (a_adj_ratio != 1.0)) {
       traj_var = GetTrajectory(start_state, t_tgt_var,
                                (v_tgt_var * spd_adj_ratio - kSpdAdjOffset),
                                d_tgt, (a_tgt * a_adj_ratio - kAccAdjOffset),
-                               map_interp_s, map_interp_x, map_interp_y);
+                               frenet_map);
     }
     
     // Debug logging
@@ -133,15 +117,28 @@ VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
                 << " sec, v=" << mps2mph(v_tgt_var) << "mph" << std::endl;
     }
 
-    // Evaluate traj cost using other vehicle predicted paths
-    traj_var.cost = EvalTrajCost(traj_var, ego_car, detected_cars);
-    
-    // Only keep traj's with cost below thresh
-    if (traj_var.cost < kTrajCostThresh) {
-      possible_trajs.push_back(traj_var);
+    // Evaluate traj cost using other vehicle predicted paths, stopping early
+    // once it's worse than the lowest cost traj so far or the thresh
+    bool is_pruned;
+    traj_var.cost = EvalTrajCost(traj_var, ego_car, detected_cars,
+                                 car_ids_by_lane, pred_envelopes,
+                                 occupancy_grid, cost_bound, &is_pruned);
+    if (is_pruned) {
+      (*num_pruned_trajs)++;
+    }
+    else if (traj_var.cost < kTrajCostThresh) {
+      // Only keep traj's with cost below thresh
+      cost_bound = std::min(cost_bound, traj_var.cost);
+      possible_trajs.push_back(std::move(traj_var));
     }
   } // loop to generate next traj
   
+  // Debug logging
+  if (kDBGTrajectory != 0) {
+    std::cout << "Pruned " << *num_pruned_trajs << " of " << kTrajGenNum
+              << " possible traj's early" << std::endl;
+  }
+  
   // Add backup traj to keep current D if all possible traj's were too risky
   if (possible_trajs.size() == 0) {
     if (kDBGTrajectory != 0) {
@@ -153,10 +150,16 @@ VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
     double v_backup = v_tgt;
 
     VehTrajectory traj_backup = GetTrajectory(start_state, t_backup, v_backup,
-                                              d_backup, a_tgt, map_interp_s,
-                                              map_interp_x, map_interp_y);
+                                              d_backup, a_tgt, frenet_map);
     
-    traj_backup.cost = EvalTrajCost(traj_backup, ego_car, detected_cars);
+    // Backup traj only needs to be checked against the thresh, so a pruned
+    // eval only has a partial cost and is counted as over the thresh
+    bool is_pruned;
+    traj_backup.cost = EvalTrajCost(traj_backup, ego_car, detected_cars,
+                                    car_ids_by_lane, pred_envelopes,
+                                    occupancy_grid, kTrajCostThresh,
+                                    &is_pruned);
+    if (is_pruned) { traj_backup.cost = std::numeric_limits<double>::max(); }
     
     // Reduce target speed until cost is low enough
     while (traj_backup.cost > kTrajCostThresh) {
@@ -166,10 +169,15 @@ VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
         std::cout << " Checking target v=" << v_backup << std::endl;
       }
       traj_backup = GetTrajectory(start_state, t_backup, v_backup,
-                                  d_backup, a_tgt, map_interp_s,
-                                  map_interp_x, map_interp_y);
+                                  d_backup, a_tgt, frenet_map);
       
-      traj_backup.cost = EvalTrajCost(traj_backup, ego_car, detected_cars);
+      traj_backup.cost = EvalTrajCost(traj_backup, ego_car, detected_cars,
+                                      car_ids_by_lane, pred_envelopes,
+                                      occupancy_grid, kTrajCostThresh,
+                                      &is_pruned);
+      if (is_pruned) {
+        traj_backup.cost = std::numeric_limits<double>::max();
+      }
     }
     
     /*
@@ -196,10 +204,11 @@ VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
             std::cout << " Checking target v=" << v_backup_LCR << std::endl;
           }
           traj_backup_LCR = GetTrajectory(start_state, t_backup, v_backup_LCR,
-                                      d_backup_LCR, a_tgt, map_interp_s,
-                                      map_interp_x, map_interp_y);
+                                      d_backup_LCR, a_tgt, frenet_map);
           traj_backup_LCR.cost = EvalTrajCost(traj_backup_LCR, ego_car,
-                                              detected_cars);
+                                              detected_cars, car_ids_by_lane,
+                                              pred_envelopes, occupancy_grid,
+                                              kTrajCostThresh, &is_pruned);
         }        
       }
     
@@ -215,10 +224,11 @@ VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
             std::cout << " Checking target v=" << v_backup_LCL << std::endl;
           }
           traj_backup_LCL = GetTrajectory(start_state, t_backup, v_backup_LCL,
-                                      d_backup_LCL, a_tgt, map_interp_s,
-                                      map_interp_x, map_interp_y);
+                                      d_backup_LCL, a_tgt, frenet_map);
           traj_backup_LCL.cost = EvalTrajCost(traj_backup_LCL, ego_car,
-                                              detected_cars);
+                                              detected_cars, car_ids_by_lane,
+                                              pred_envelopes, occupancy_grid,
+                                              kTrajCostThresh, &is_pruned);
         }
       }
       
@@ -257,18 +267,30 @@ VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
     */
     
     // Limit final backup traj for max speed and accel
-    auto adj_ratios = CheckTrajFeasibility(traj_backup);
-    
-    const double spd_adj_ratio = adj_ratios[0];
-    const double a_adj_ratio = adj_ratios[1];
+    double spd_adj_ratio;
+    double a_adj_ratio;
+    CheckTrajFeasibility(traj_backup, frenet_map, &spd_adj_ratio,
+                         &a_adj_ratio);
     if ((spd_adj_ratio != 1.0) || (a_adj_ratio != 1.0)) {
       traj_backup = GetTrajectory(start_state, t_backup,
                                   (v_backup * spd_adj_ratio - kSpdAdjOffset),
                                   d_backup,
                                   (a_tgt * a_adj_ratio - kAccAdjOffset),
-                                  map_interp_s, map_interp_x, map_interp_y);
+                                  frenet_map);
       
-      traj_backup.cost = EvalTrajCost(traj_backup, ego_car, detected_cars);
+      traj_backup.cost = EvalTrajCost(traj_backup, ego_car, detected_cars,
+                                      car_ids_by_lane, pred_envelopes,
+                                      occupancy_grid,
+                                      std::numeric_limits<double>::max(),
+                                      &is_pruned);
+    }
+    else if (is_pruned) {
+      // Backup traj is used even if over the thresh, so get its full cost
+      traj_backup.cost = EvalTrajCost(traj_backup, ego_car, detected_cars,
+                                      car_ids_by_lane, pred_envelopes,
+                                      occupancy_grid,
+                                      std::numeric_limits<double>::max(),
+                                      &is_pruned);
     }
       
     // Debug logging
@@ -278,18 +300,16 @@ VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
                 << traj_backup.cost << std::endl;
     }
     
-    possible_trajs.push_back(traj_backup);
+    possible_trajs.push_back(std::move(traj_backup));
   }
   
   // Get traj with lowest cost
-  VehTrajectory best_traj;
   int best_traj_idx = -1;
   double lowest_cost = std::numeric_limits<double>::max();
-  for (int i = 0; i < possible_trajs.size(); ++i) {
+  for (int i = 0; i < int(possible_trajs.size()); ++i) {
     if (possible_trajs[i].cost < lowest_cost) {
       best_traj_idx = i;
       lowest_cost = possible_trajs[i].cost;
-      best_traj = possible_trajs[i];
     }
   }
   
@@ -299,116 +319,302 @@ VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
               << "\n" << std::endl;
   }
     
-  return best_traj;
+  if (best_traj_idx < 0) { return GetCycleTrajectory(); }
+  
+  // Only the final traj is sent to the sim, so only it needs (x,y) points
+  VehTrajectory &best_traj = possible_trajs[best_traj_idx];
+  SetTrajXY(frenet_map, &best_traj);
+  return std::move(best_traj);
+}
+
+/**
+ * Get an empty trajectory with its states drawn from the per-cycle arena
+ */
+VehTrajectory GetCycleTrajectory() {
+  VehTrajectory traj = {
+    ArenaVector<VehState>(ArenaAllocator<VehState>(&GetCycleArena())), 0., 0.,
+    Poly<5>(), Poly<5>()
+  };
+  return traj;
+}
+
+/**
+ * Get the predicted trajectory of a trajectory's Frenet polys, ending at the
+ * time of its last state
+ */
+PredTrajectory GetPredTrajectory(const VehTrajectory &traj) {
+  PredTrajectory pred_traj = {traj.poly_s, traj.poly_d,
+                              traj.states.size() * kSimCycleTime,
+                              traj.probability};
+  return pred_traj;
 }
 
 /**
  * Get a trajectory for a specified start state and a target time, speed,
- * Frenet d value, and accel using JMT and basic kinematic estimations.  The
- * JMT is applied to Frenet s and d coordinates separately, and then the (s,d)
- * points are converted to (x,y) points.  The (x,y) points are also checked for
- * a minimum separation distance and filtered to prevent low speed jitter.
+ * Frenet d value, and accel using JMT and basic kinematic estimations.
  * Returns the trajectory with states up to time t_tgt.
  */
 VehTrajectory GetTrajectory(VehState start_state, double t_tgt,
                             double v_tgt, double d_tgt, double a_tgt,
-                            const std::vector<double> &map_interp_s,
-                            const std::vector<double> &map_interp_x,
-                            const std::vector<double> &map_interp_y) {
-  
-  VehTrajectory new_traj;
-  
-  //// Generate S trajectory ////
-  
-  double s_est;
-  double s_dot_est;
-  double s_dotdot_est;
-  
-  // Estimate s, s_dot, s_dot_dot with basic kinematics approximating with
-  // constant accel to keep a reasonable JMT
-  const double t_maxa = abs(v_tgt - start_state.s_dot) / a_tgt;
-  const double a_signed = (v_tgt > start_state.s_dot) ? a_tgt : -a_tgt;
-  if (t_maxa > t_tgt) {
-    // Cut off target v and a to limit t
-    s_dot_est = start_state.s_dot + a_signed * t_tgt;
-    s_dotdot_est = a_signed;
-  }
-  else {
-    // Can achieve target speed in time
-    s_dot_est = v_tgt;
-    s_dotdot_est = (s_dot_est - start_state.s_dot) / t_tgt;
-  }
-  s_est = start_state.s + start_state.s_dot*t_tgt + 0.5*s_dotdot_est*sq(t_tgt);
-  
-  std::vector<double> start_state_s = {start_state.s, start_state.s_dot,
-                                       start_state.s_dotdot};
-  std::vector<double> end_state_s = {s_est, s_dot_est, s_dotdot_est};
-  
-  auto coeffs_JMT_s = JMT(start_state_s, end_state_s, t_tgt);
-  auto coeffs_JMT_s_dot = DiffPoly(coeffs_JMT_s);
-  auto coeffs_JMT_s_dotdot = DiffPoly(coeffs_JMT_s_dot);
-  
-  //// Generate D trajectory ////
+                            const FrenetMap &frenet_map) {
   
-  const double d_est = d_tgt;
-  const double d_dot_est = 0; // finish lane change by end of traj
-  const double d_dotdot_est = 0; // finish lane change by end of traj
+  return std::move(GetTrajectories(start_state, t_tgt, &v_tgt, &d_tgt, 1,
+                                   a_tgt, frenet_map)[0]);
+}
+
+/**
+ * Get num_trajs trajectories from the same start state over the same target
+ * time, with each trajectory's target speed and Frenet d value in v_tgts and
+ * d_tgts, using JMT and basic kinematic estimations.  The JMT is applied to
+ * Frenet s and d coordinates separately, and all of the trajectories' s and d
+ * polynomials are sampled together with the sim time basis tables.  The
+ * points are also checked for a minimum (x,y) separation distance (estimated
+ * from the road curvature) and filtered to prevent low speed jitter.  The
+ * states' (x,y) points are not set, and are only converted by SetTrajXY for a
+ * trajectory that needs them.  The trajectories and working arrays are drawn
+ * from the per-cycle arena.
+ * Returns the trajectories with states up to time t_tgt.
+ */
+ArenaVector<VehTrajectory> GetTrajectories(VehState start_state, double t_tgt,
+                                           const double *v_tgts,
+                                           const double *d_tgts,
+                                           int num_trajs, double a_tgt,
+                                           const FrenetMap &frenet_map) {
   
-  std::vector<double> start_state_d = {start_state.d, start_state.d_dot,
-                                       start_state.d_dotdot};
-  std::vector<double> end_state_d = {d_est, d_dot_est, d_dotdot_est};
+  Arena *arena = &GetCycleArena();
   
-  auto coeffs_JMT_d = JMT(start_state_d, end_state_d, t_tgt);
-  auto coeffs_JMT_d_dot = DiffPoly(coeffs_JMT_d);
-  auto coeffs_JMT_d_dotdot = DiffPoly(coeffs_JMT_d_dot);
+  // JMT polys for s of each traj, followed by d of each traj
+  ArenaVector<Poly<5>> polys_JMT(2 * num_trajs, Poly<5>(),
+                                 ArenaAllocator<Poly<5>>(arena));
   
-  // Look up (s,d) vals for each sim cycle time step and convert to (x,y)
-  const int num_pts = t_tgt / kSimCycleTime;
-  double t;
-  for (int i = 1; i < num_pts; ++i) {
-    t = i * kSimCycleTime; // idx 0 is 1st point ahead of car, start from i = 1
+  for (int k = 0; k < num_trajs; ++k) {
+    const double v_tgt = v_tgts[k];
+    const double d_tgt = d_tgts[k];
+    
+    //// Generate S trajectory ////
+    
+    double s_est;
+    double s_dot_est;
+    double s_dotdot_est;
+    
+    // Estimate s, s_dot, s_dot_dot with basic kinematics approximating with
+    // constant accel to keep a reasonable JMT
+    const double t_maxa = abs(v_tgt - start_state.s_dot) / a_tgt;
+    const double a_signed = (v_tgt > start_state.s_dot) ? a_tgt : -a_tgt;
+    if (t_maxa > t_tgt) {
+      // Cut off target v and a to limit t
+      s_dot_est = start_state.s_dot + a_signed * t_tgt;
+      s_dotdot_est = a_signed;
+    }
+    else {
+      // Can achieve target speed in time
+      s_dot_est = v_tgt;
+      s_dotdot_est = (s_dot_est - start_state.s_dot) / t_tgt;
+    }
+    s_est = (start_state.s + start_state.s_dot*t_tgt
+             + 0.5*s_dotdot_est*sq(t_tgt));
+    
+    const double start_state_s[] = {start_state.s, start_state.s_dot,
+                                    start_state.s_dotdot};
+    const double end_state_s[] = {s_est, s_dot_est, s_dotdot_est};
+    
+    polys_JMT[k] = JMT(start_state_s, end_state_s, t_tgt);
     
-    VehState state;
-    state.s = std::fmod(EvalPoly(t, coeffs_JMT_s), kMaxS);
-    state.s_dot = EvalPoly(t, coeffs_JMT_s_dot);
-    state.s_dotdot = EvalPoly(t, coeffs_JMT_s_dotdot);
-    state.d = EvalPoly(t, coeffs_JMT_d);
-    state.d_dot = EvalPoly(t, coeffs_JMT_d_dot);
-    state.d_dotdot = EvalPoly(t, coeffs_JMT_d_dotdot);
+    //// Generate D trajectory ////
     
-    std::vector<double> state_xy = GetHiResXY(state.s, state.d, map_interp_s,
-                                              map_interp_x, map_interp_y);
-    state.x = state_xy[0];
-    state.y = state_xy[1];
+    const double d_est = d_tgt;
+    const double d_dot_est = 0; // finish lane change by end of traj
+    const double d_dotdot_est = 0; // finish lane change by end of traj
     
-    // Check for min (x,y) dist from prev point, re-push prev point if too small
-    if (i > 1) {
-      const int prev_idx = new_traj.states.size() - 1; // last pushed point
-      const double dist_pnt = Distance(state.x, state.y,
-                                       new_traj.states[prev_idx].x,
-                                       new_traj.states[prev_idx].y);
+    const double start_state_d[] = {start_state.d, start_state.d_dot,
+                                    start_state.d_dotdot};
+    const double end_state_d[] = {d_est, d_dot_est, d_dotdot_est};
+    
+    polys_JMT[num_trajs + k] = JMT(start_state_d, end_state_d, t_tgt);
+  }
+  
+  // Sample s and d with their derivatives at each sim cycle time step, idx 0
+  // is 1st point ahead of car at t = 1 step
+  const int num_pts = t_tgt / kSimCycleTime;
+  const int num_new_pts = std::max(num_pts - 1, 0);
+  const int num_traj_pts = num_trajs * num_new_pts;
+  ArenaVector<double> pts_pos(2 * num_traj_pts, 0.,
+                              ArenaAllocator<double>(arena));
+  ArenaVector<double> pts_vel(2 * num_traj_pts, 0.,
+                              ArenaAllocator<double>(arena));
+  ArenaVector<double> pts_acc(2 * num_traj_pts, 0.,
+                              ArenaAllocator<double>(arena));
+  SampleQuinticBatch(polys_JMT.data(), 2 * num_trajs, num_new_pts,
+                     pts_pos.data(), pts_vel.data(), pts_acc.data());
+  
+  // Wrap s around the track (points of s of all trajs are contiguous)
+  const double max_s = frenet_map.GetMaxS();
+  for (int i = 0; i < num_traj_pts; ++i) {
+    pts_pos[i] = std::fmod(pts_pos[i], max_s);
+  }
+  
+  // Road curvature at each point of s for the min (x,y) dist checks
+  ArenaVector<double> pts_curvature(num_traj_pts, 0.,
+                                    ArenaAllocator<double>(arena));
+  GetHiResCurvatureBatch(pts_pos.data(), num_traj_pts, frenet_map,
+                         pts_curvature.data());
+  
+  ArenaVector<VehTrajectory> new_trajs{ArenaAllocator<VehTrajectory>(arena)};
+  new_trajs.reserve(num_trajs);
+  for (int k = 0; k < num_trajs; ++k) {
+    new_trajs.push_back(GetCycleTrajectory());
+    VehTrajectory &new_traj = new_trajs[k];
+    new_traj.poly_s = polys_JMT[k];
+    new_traj.poly_d = polys_JMT[num_trajs + k];
+    new_traj.states.reserve(num_new_pts);
+    const int idx_s = k * num_new_pts; // 1st point of traj's s
+    const int idx_d = (num_trajs + k) * num_new_pts; // 1st point of traj's d
+    int i_prev = 0; // point that the traj's last state was sampled at
+    for (int i = 0; i < num_new_pts; ++i) {
+      VehState state;
+      state.x = 0.; // set by SetTrajXY
+      state.y = 0.;
+      state.s = pts_pos[idx_s + i];
+      state.s_dot = pts_vel[idx_s + i];
+      state.s_dotdot = pts_acc[idx_s + i];
+      state.d = pts_pos[idx_d + i];
+      state.d_dot = pts_vel[idx_d + i];
+      state.d_dotdot = pts_acc[idx_d + i];
       
-      if (dist_pnt < kMinTrajPntDist) {
-        state = new_traj.states[prev_idx]; // set state back to copy of previous
+      // Check for min (x,y) dist from prev point, set back to prev point if
+      // too small
+      if (i > 0) {
+        const VehState &prev_state = new_traj.states.back();
+        double ds = state.s - prev_state.s;
+        if (ds < -0.5*max_s) { ds += max_s; } // wrapped around the track
+        const double curvature = pts_curvature[idx_s + i_prev];
+        const double xy_dist = sqrt(sq(ds * (1. - curvature * prev_state.d))
+                                    + sq(state.d - prev_state.d));
+        if (xy_dist < kMinTrajPntDist) {
+          state = prev_state; // copy of previous
+        }
+        else {
+          i_prev = i;
+        }
       }
+      
+      new_traj.states.push_back(state);
     }
-    
-    new_traj.states.push_back(state);
   }
   
-  return new_traj;
+  return new_trajs;
 }
 
+/**
+ * Set the (x,y) points of a trajectory's states from their Frenet (s,d)
+ * points, converted in one batch
+ */
+void SetTrajXY(const FrenetMap &frenet_map, VehTrajectory *traj) {
+  
+  Arena *arena = &GetCycleArena();
+  const int num_pts = traj->states.size();
+  ArenaVector<double> pts_s(num_pts, 0., ArenaAllocator<double>(arena));
+  ArenaVector<double> pts_d(num_pts, 0., ArenaAllocator<double>(arena));
+  for (int i = 0; i < num_pts; ++i) {
+    pts_s[i] = traj->states[i].s;
+    pts_d[i] = traj->states[i].d;
+  }
+  
+  ArenaVector<double> pts_x(num_pts, 0., ArenaAllocator<double>(arena));
+  ArenaVector<double> pts_y(num_pts, 0., ArenaAllocator<double>(arena));
+  GetHiResXYBatch(pts_s.data(), pts_d.data(), num_pts, frenet_map,
+                  pts_x.data(), pts_y.data());
+  for (int i = 0; i < num_pts; ++i) {
+    traj->states[i].x = pts_x[i];
+    traj->states[i].y = pts_y[i];
+  }
+}
 
 /**
- * Check trajectory feasibility for over-speed and over-accel limits.  Returns
- * adjustment ratios based on the amount of over-limit.
+ * Build the time-power basis tables for the kTimeBasisSteps sim cycle time
+ * steps t = (i+1) * kSimCycleTime, with row i of pos = [1, t, t^2, t^3, t^4,
+ * t^5] and rows of vel and acc its 1st and 2nd time derivatives
  */
-std::vector<double> CheckTrajFeasibility(const VehTrajectory traj) {
+static TimeBasis BuildTimeBasis() {
+  
+  TimeBasis basis;
+  for (int i = 0; i < kTimeBasisSteps; ++i) {
+    const double t = (i + 1) * kSimCycleTime;
+    double t_pow = 1.; // t^j
+    for (int j = 0; j < 6; ++j) {
+      basis.pos[i][j] = t_pow;
+      basis.vel[i][j] = (j >= 1) ? j * basis.pos[i][j-1] : 0.;
+      basis.acc[i][j] = (j >= 2) ? j * (j-1) * basis.pos[i][j-2] : 0.;
+      t_pow *= t;
+    }
+  }
+  
+  return basis;
+}
 
-  // Check for (x,y) over-speed/accel and return adj ratios to compensate
-  double spd_adj_ratio = 1.0;
-  double a_adj_ratio = 1.0;
+/**
+ * Get the time-power basis tables for the sim cycle time steps of the longest
+ * trajectory horizon in use, built once per process on first use
+ */
+const TimeBasis& GetSimTimeBasis() {
+  static const TimeBasis basis = BuildTimeBasis();
+  return basis;
+}
+
+/**
+ * Sample num_polys quintic polynomials with their 1st and 2nd derivatives at
+ * the first num_pts sim cycle time steps.  The caller's pts_pos, pts_vel and
+ * pts_acc arrays (num_polys * num_pts each) get polynomial k's points at
+ * [k * num_pts, (k+1) * num_pts).  Steps within the time basis tables are
+ * sampled as dot products of the table rows with the polynomial's
+ * coefficients, with Horner evaluation as fallback for steps past the tables.
+ */
+void SampleQuinticBatch(const Poly<5> *polys, int num_polys, int num_pts,
+                        double *pts_pos, double *pts_vel, double *pts_acc) {
+  
+  const TimeBasis &basis = GetSimTimeBasis();
+  const int num_basis_pts = std::min(num_pts, kTimeBasisSteps);
+  
+  for (int k = 0; k < num_polys; ++k) {
+    const double *a = polys[k].a;
+    double *poly_pos = &pts_pos[k * num_pts];
+    double *poly_vel = &pts_vel[k * num_pts];
+    double *poly_acc = &pts_acc[k * num_pts];
+    for (int i = 0; i < num_basis_pts; ++i) {
+      double pos = 0.;
+      double vel = 0.;
+      double acc = 0.;
+      for (int j = 0; j < 6; ++j) {
+        pos += basis.pos[i][j] * a[j];
+        vel += basis.vel[i][j] * a[j];
+        acc += basis.acc[i][j] * a[j];
+      }
+      poly_pos[i] = pos;
+      poly_vel[i] = vel;
+      poly_acc[i] = acc;
+    }
+    for (int i = num_basis_pts; i < num_pts; ++i) {
+      polys[k].EvalDerivs((i + 1) * kSimCycleTime, &poly_pos[i],
+                          &poly_vel[i], &poly_acc[i]);
+    }
+  }
+}
+
+
+/**
+ * Check trajectory feasibility for over-speed and over-accel limits.  Sets
+ * the adjustment ratios based on the amount of over-limit.
+ * The (x,y) speed is found in Frenet from s_dot scaled by (1 - curvature * d)
+ * for the road curvature at the point's s, combined with d_dot, so the traj
+ * doesn't need its (x,y) points.
+ */
+void CheckTrajFeasibility(const VehTrajectory &traj,
+                          const FrenetMap &frenet_map,
+                          double *spd_adj_ratio, double *a_adj_ratio) {
+
+  // Check for (x,y) over-speed/accel and set adj ratios to compensate
+  *spd_adj_ratio = 1.0;
+  *a_adj_ratio = 1.0;
   
   double v_peak = 0;
   double xy_speed = 0;
@@ -417,13 +623,24 @@ std::vector<double> CheckTrajFeasibility(const VehTrajectory traj) {
   double ave_speed = 0;
   double ave_speed_prev = 0;
   
+  // Road curvature at each point's s, looked up along the traj together
+  Arena *arena = &GetCycleArena();
+  const int num_states = int(traj.states.size());
+  ArenaVector<double> pts_s(num_states, 0., ArenaAllocator<double>(arena));
+  ArenaVector<double> pts_curvature(num_states, 0.,
+                                    ArenaAllocator<double>(arena));
+  for (int i = 0; i < num_states; ++i) { pts_s[i] = traj.states[i].s; }
+  GetHiResCurvatureBatch(pts_s.data(), num_states, frenet_map,
+                         pts_curvature.data());
+  
   // Loop through each point in traj starting from 2nd point
-  for (int i = 1; i < traj.states.size(); ++i) {
+  for (int i = 1; i < num_states; ++i) {
     
-    // Check for over-speed from previous point
-    xy_speed = (Distance(traj.states[i].x, traj.states[i].y,
-                         traj.states[i-1].x, traj.states[i-1].y)
-                / kSimCycleTime);
+    // Check for over-speed at point
+    const VehState &state = traj.states[i];
+    const double curvature = pts_curvature[i];
+    xy_speed = sqrt(sq(state.s_dot * (1. - curvature * state.d))
+                    + sq(state.d_dot));
     
     if (xy_speed > v_peak) { v_peak = xy_speed; }
     
@@ -444,75 +661,314 @@ std::vector<double> CheckTrajFeasibility(const VehTrajectory traj) {
   }
   
   // Calculate adjustment ratios
-  if (v_peak > kTargetSpeed) { spd_adj_ratio = kTargetSpeed / v_peak; }
-  if (a_peak > kMaxA) { a_adj_ratio = kMaxA / a_peak; }
+  if (v_peak > kTargetSpeed) { *spd_adj_ratio = kTargetSpeed / v_peak; }
+  if (a_peak > kMaxA) { *a_adj_ratio = kMaxA / a_peak; }
   
   // Debug logging
   if (kDBGTrajectory != 0) {
     std::cout << "Traj check: v_peak = " << mps2mph(v_peak)
               << " mph, a_peak = " << a_peak << std::endl;
   }
-  
-  return {spd_adj_ratio, a_adj_ratio};
 }
 
 /**
- * Evaluate trajectory's cost based on collision risk and deviation from target
- *
- * Note: This implementation is currently not very efficient and could probably
- *       be multithreaded.
+ * Get the envelopes of each detected car's predicted paths over all of its
+ * intents, from the start of the new ego traj (after ego's prev path buffer)
+ * to the end of the predictions, from the Bernstein bounds of the paths'
+ * polys.  Cars with no predicted path left after the start have empty
+ * envelopes.
  */
-double EvalTrajCost(const VehTrajectory traj, const EgoVehicle &ego_car,
-                    const std::map<int, DetectedVehicle> &detected_cars) {
+PredEnvelopes GetPredEnvelopes(const EgoVehicle &ego_car,
+                               const DetectedVehicleTable &detected_cars,
+                               double max_s) {
   
-  double collision_risk_sum = 0.0;
+  const int num_cars = detected_cars.Size();
+  PredEnvelopes pred_envelopes = {
+    ArenaVector<PredEnvelope>(num_cars, PredEnvelope(),
+                              ArenaAllocator<PredEnvelope>(&GetCycleArena())),
+    0., 0., ego_car.GetTraj().Size() * kSimCycleTime, 0.,
+    ego_car.GetState().s, max_s
+  };
+  const double t_start = pred_envelopes.t_start;
+  
+  for (int idx = 0; idx < num_cars; ++idx) {
+    PredEnvelope &envelope = pred_envelopes.cars[idx];
+    envelope.min_s = std::numeric_limits<double>::max();
+    envelope.max_s = -std::numeric_limits<double>::max();
+    envelope.min_d = std::numeric_limits<double>::max();
+    envelope.max_d = -std::numeric_limits<double>::max();
+    
+    const double car_rel_s = detected_cars.GetRelS(idx);
+    const double car_d = detected_cars.GetD(idx);
+    const PredTrajectories &pred_trajs = detected_cars.GetCar(idx)
+                                           .GetPredTrajs();
+    for (int i = 0; i < pred_trajs.size; ++i) {
+      const PredTrajectory &car_traj = pred_trajs.trajs[i];
+      if (car_traj.t_end <= t_start) { continue; }
+      
+      // Distance travelled in s from now and d over the rest of the path
+      Poly<5> dist_s = car_traj.s.Shift(t_start);
+      dist_s.a[0] -= car_traj.s.a[0];
+      const Poly<5> path_d = car_traj.d.Shift(t_start);
+      double min_val, max_val;
+      dist_s.GetBounds(car_traj.t_end - t_start, &min_val, &max_val);
+      envelope.min_s = std::min(envelope.min_s, car_rel_s + min_val);
+      envelope.max_s = std::max(envelope.max_s, car_rel_s + max_val);
+      path_d.GetBounds(car_traj.t_end - t_start, &min_val, &max_val);
+      envelope.min_d = std::min(envelope.min_d, min_val);
+      envelope.max_d = std::max(envelope.max_d, max_val);
+      pred_envelopes.t_end = std::max(pred_envelopes.t_end, car_traj.t_end);
+    }
+    
+    if (envelope.min_s <= envelope.max_s) {
+      pred_envelopes.reach_s = std::max(pred_envelopes.reach_s,
+                                        std::max(car_rel_s - envelope.min_s,
+                                                 envelope.max_s - car_rel_s));
+      pred_envelopes.reach_d = std::max(pred_envelopes.reach_d,
+                                        std::max(car_d - envelope.min_d,
+                                                 envelope.max_d - car_d));
+    }
+  }
   
-  // Set start index to start checking other car's predicted paths after ego's
-  // prev path buffer where the new trajectory will start
-  const int idx_start_traj = ego_car.GetTraj().states.size();
+  return pred_envelopes;
+}
 
-  // Check each time step of the traj to find overlap with other car pred paths
-  for (int i = 0; i < traj.states.size(); i += kEvalRiskStep) {
-    const double ego_s = traj.states[i].s;
-    const double ego_d = traj.states[i].d;
+/**
+ * Broad-phase culling of the detected cars to check for collision risk with a
+ * new ego traj.  The traj's swept window in relative s and d (expanded by the
+ * collision thresholds) is found from the Bernstein bounds of its polys up to
+ * the end of the predictions.  Cars that could have envelopes in the window
+ * are looked up in the lanes and s range of the lane index within the
+ * envelopes' reach, and the cars with envelopes overlapping the window are
+ * kept.  Fills idx_near_cars with the dense indices of the kept cars and
+ * returns the number kept.
+ */
+int CullCarsNearTraj(const VehTrajectory &traj,
+                     const DetectedVehicleTable &detected_cars,
+                     const LaneIndex &car_ids_by_lane,
+                     const PredEnvelopes &pred_envelopes,
+                     int *idx_near_cars) {
+  
+  const double t_check = std::min(traj.states.size() * kSimCycleTime,
+                                  pred_envelopes.t_end
+                                  - pred_envelopes.t_start);
+  if (t_check <= 0.) { return 0; }
+  
+  // Swept window of the traj in relative s and d, with s wrapping around the
+  // track
+  const double max_s = pred_envelopes.max_s;
+  Poly<5> rel_s = traj.poly_s;
+  rel_s.a[0] -= pred_envelopes.ref_s;
+  if (rel_s.a[0] > 0.5*max_s) { rel_s.a[0] -= max_s; }
+  else if (rel_s.a[0] < -0.5*max_s) { rel_s.a[0] += max_s; }
+  double min_s, max_s_window;
+  double min_d, max_d;
+  rel_s.GetBounds(t_check, &min_s, &max_s_window);
+  traj.poly_d.GetBounds(t_check, &min_d, &max_d);
+  min_s -= kCollisionSThresh;
+  max_s_window += kCollisionSThresh;
+  min_d -= kCollisionDThresh;
+  max_d += kCollisionDThresh;
+  
+  // Lanes of cars that could reach the window (lane # is ceil(d / width)),
+  // with lanes beyond the indexed lanes looked up in the out-of-lanes bucket
+  const int num_lanes = car_ids_by_lane.GetNumLanes();
+  const int min_lane = std::max(
+      int(std::ceil((min_d - pred_envelopes.reach_d) / kLaneWidth)), 0);
+  const int max_lane = std::min(
+      int(std::ceil((max_d + pred_envelopes.reach_d) / kLaneWidth)),
+      num_lanes);
+  
+  int num_near_cars = 0;
+  for (int lane = min_lane; lane <= max_lane; ++lane) {
+    const LaneCarsView lane_cars = ((lane < num_lanes)
+        ? car_ids_by_lane.GetLaneCars(lane)
+        : car_ids_by_lane.GetOutOfLanesCars());
     
-    // Check for each detected vehicle
-    for (auto it = detected_cars.begin(); it != detected_cars.end(); ++it) {
-      DetectedVehicle car = it->second;
-      std::map<VehIntents, VehTrajectory> cur_pred_trajs = car.GetPredTrajs();
+    // Lane's cars are sorted by higher relative s first, so start at the
+    // first car that could reach the window and stop after the last one
+    const double car_max_s = max_s_window + pred_envelopes.reach_s;
+    const double car_min_s = min_s - pred_envelopes.reach_s;
+    const LaneCar *it = std::lower_bound(lane_cars.begin(), lane_cars.end(),
+                                         car_max_s,
+                                         [](const LaneCar &car, double s) {
+                                           return car.rel_s > s;
+                                         });
+    for (; (it != lane_cars.end()) && (it->rel_s >= car_min_s); ++it) {
+      const int idx = detected_cars.Find(it->id);
+      const PredEnvelope &envelope = pred_envelopes.cars[idx];
+      if ((envelope.min_s < max_s_window) && (envelope.max_s > min_s)
+          && (envelope.min_d < max_d) && (envelope.max_d > min_d)) {
+        idx_near_cars[num_near_cars++] = idx;
+      }
+    }
+  }
+  
+  return num_near_cars;
+}
 
-      // Check each predicted path of this detected vehicle at this time step
-      for (auto it2 = cur_pred_trajs.begin();
-                it2 != cur_pred_trajs.end(); ++it2) {
-        const VehTrajectory car_traj = it2->second;
-        
-        // Stop if predicted traj reached its end
-        if ((idx_start_traj+i) > car_traj.states.size()) { break; }
-        
-        const double car_s = car_traj.states[idx_start_traj+i].s;
-        const double car_d = car_traj.states[idx_start_traj+i].d;
-        
-        // Check if ego car and other car would be too close at this time step
-        if ((abs(ego_s - car_s) < kCollisionSThresh)
-            && (abs(ego_d - car_d) < kCollisionDThresh)) {
-          
-          // Risk probability with exponential decay over predicted time e^(-t)
-          collision_risk_sum += car_traj.probability * exp(-i * kSimCycleTime);
-        }
-      } // loop to detected car's next predicted path
-    } // loop to next detected car
-  } // loop to traj's next time step
+/**
+ * Get the collision risk between a new ego trajectory and a detected car's
+ * predicted trajectory, as the integral of the risk weight e^(-t) over the
+ * times when they would be within kCollisionSThresh and kCollisionDThresh of
+ * each other.  The gaps in s and d are polys from the difference of their
+ * JMT polys, so the times are found from the roots of the gaps at the
+ * thresholds, after the Bernstein bounds of the gaps rule out cars that are
+ * never close enough.
+ * t_start is the start time of the ego traj after the predicted traj's start,
+ * and t_begin to t_end is the time window to check from the start of the ego
+ * traj.
+ */
+double GetCollisionRisk(const VehTrajectory &traj,
+                        const PredTrajectory &car_traj, double t_start,
+                        double t_begin, double t_end, double max_s) {
   
-  // Apply cost function factor to collision risk sum
-  const double traj_cost_risk = kTrajCostRisk * collision_risk_sum;
+  // Gaps between ego and car over the time window, with s wrapping around the
+  // track
+  Poly<5> gap_s = car_traj.s.Shift(t_start + t_begin);
+  Poly<5> gap_d = car_traj.d.Shift(t_start + t_begin);
+  const Poly<5> ego_s = (t_begin > 0.) ? traj.poly_s.Shift(t_begin)
+                                       : traj.poly_s;
+  const Poly<5> ego_d = (t_begin > 0.) ? traj.poly_d.Shift(t_begin)
+                                       : traj.poly_d;
+  for (int i = 0; i <= 5; ++i) {
+    gap_s.a[i] = ego_s.a[i] - gap_s.a[i];
+    gap_d.a[i] = ego_d.a[i] - gap_d.a[i];
+  }
+  if (gap_s.a[0] > 0.5*max_s) { gap_s.a[0] -= max_s; }
+  else if (gap_s.a[0] < -0.5*max_s) { gap_s.a[0] += max_s; }
+  const double t_window = t_end - t_begin;
   
-  // Add traj cost based on deviation from base target
-  const VehBehavior ego_beh = ego_car.GetTgtBehavior();
+  // Rule out cars that are never close enough
+  double min_gap_s, max_gap_s;
+  double min_gap_d, max_gap_d;
+  gap_s.GetBounds(t_window, &min_gap_s, &max_gap_s);
+  if ((min_gap_s >= kCollisionSThresh) || (max_gap_s <= -kCollisionSThresh)) {
+    return 0.;
+  }
+  gap_d.GetBounds(t_window, &min_gap_d, &max_gap_d);
+  if ((min_gap_d >= kCollisionDThresh) || (max_gap_d <= -kCollisionDThresh)) {
+    return 0.;
+  }
+  
+  // Split time at the roots of each gap at its +/- thresholds (only checking
+  // thresholds within the gap's bounds)
+  const double threshs[] = {kCollisionSThresh, -kCollisionSThresh,
+                            kCollisionDThresh, -kCollisionDThresh};
+  const double min_gaps[] = {min_gap_s, min_gap_s, min_gap_d, min_gap_d};
+  const double max_gaps[] = {max_gap_s, max_gap_s, max_gap_d, max_gap_d};
+  double t_splits[4*5 + 2];
+  int num_splits = 0;
+  t_splits[num_splits++] = 0.;
+  for (int k = 0; k < 4; ++k) {
+    if ((min_gaps[k] >= threshs[k]) || (max_gaps[k] <= threshs[k])) {
+      continue;
+    }
+    Poly<5> gap_thresh = (k < 2) ? gap_s : gap_d;
+    gap_thresh.a[0] -= threshs[k];
+    num_splits += gap_thresh.FindRoots(0., t_window, &t_splits[num_splits]);
+  }
+  t_splits[num_splits++] = t_window;
+  std::sort(t_splits, t_splits + num_splits);
+  
+  // Integrate e^(-t) over the intervals where both gaps are within thresholds
+  double risk = 0.;
+  for (int k = 0; k < num_splits - 1; ++k) {
+    const double t_mid = 0.5 * (t_splits[k] + t_splits[k+1]);
+    if ((abs(gap_s.Eval(t_mid)) < kCollisionSThresh)
+        && (abs(gap_d.Eval(t_mid)) < kCollisionDThresh)) {
+      risk += exp(-t_splits[k]) - exp(-t_splits[k+1]);
+    }
+  }
+  
+  return exp(-t_begin) * risk;
+}
+
+/**
+ * Evaluate trajectory's cost based on collision risk and deviation from target
+ *
+ * The collision risk is checked in continuous time against each predicted
+ * path of the detected vehicles near the traj after broad-phase culling, as
+ * the probability weighted risk of each path per kEvalRiskStep time steps to
+ * keep the scale of sampling the risk at that interval.
+ *
+ * The evaluation is cut short once the cost exceeds cost_bound (is_pruned is
+ * set by ptr), returning the partial cost so far.  The cheap deviation cost
+ * is added first, and then the risk is accumulated in time windows from the
+ * start of the traj (starting at kEvalRiskWindowTime and doubling), since the
+ * early windows have the highest risk weighting and are the tightest for the
+ * collision checks to rule out.  Windows where the occupancy grid has no
+ * predicted paths near the traj are skipped without checking any cars.
+ */
+double EvalTrajCost(const VehTrajectory &traj, const EgoVehicle &ego_car,
+                    const DetectedVehicleTable &detected_cars,
+                    const LaneIndex &car_ids_by_lane,
+                    const PredEnvelopes &pred_envelopes,
+                    const OccupancyGrid &occupancy_grid, double cost_bound,
+                    bool *is_pruned) {
+  
+  // Traj cost based on deviation from base target
+  const VehBehavior &ego_beh = ego_car.GetTgtBehavior();
   const double t_traj = traj.states.size() * kSimCycleTime;
   const double t_tgtdev = abs(ego_beh.tgt_time - t_traj);
   const double v_traj = traj.states.back().s_dot;
   const double v_tgtdev = abs(ego_beh.tgt_speed - v_traj);
   const double traj_cost_tgtdev = kTrajCostDeviation * (t_tgtdev + v_tgtdev);
+  *is_pruned = (traj_cost_tgtdev > cost_bound);
+  
+  // Predicted paths start now and the new traj starts after ego's prev path
+  // buffer, and the check stops at the end of either
+  const double t_start_traj = pred_envelopes.t_start;
+  const double t_end_traj = t_traj;
+  
+  // Only check detected vehicles with predicted paths near the traj
+  ArenaVector<int> idx_near_cars(detected_cars.Size(), 0,
+                                 ArenaAllocator<int>(&GetCycleArena()));
+  int num_near_cars = 0;
+  if (*is_pruned == false) {
+    num_near_cars = CullCarsNearTraj(traj, detected_cars, car_ids_by_lane,
+                                     pred_envelopes, idx_near_cars.data());
+  }
+  
+  // Add traj cost based on collision risk sum, window by window
+  const double risk_gain = kTrajCostRisk / (kEvalRiskStep * kSimCycleTime);
+  double traj_cost_risk = 0.0;
+  double t_window = kEvalRiskWindowTime;
+  double t_begin = 0.;
+  int idx_window = 0;
+  for (; (t_begin < t_end_traj) && (*is_pruned == false);
+       t_begin += t_window, t_window *= 2., ++idx_window) {
+    
+    // Skip windows where no predicted path could be near the traj
+    if (occupancy_grid.IsTrajWindowClear(traj, idx_window, t_begin,
+                                         std::min(t_end_traj,
+                                                  t_begin + t_window))) {
+      continue;
+    }
+    
+    // Check for each near detected vehicle
+    for (int k = 0; (k < num_near_cars) && (*is_pruned == false); ++k) {
+      const PredTrajectories &cur_pred_trajs =
+          detected_cars.GetCar(idx_near_cars[k]).GetPredTrajs();
+      
+      // Check each predicted path of this detected vehicle
+      for (int i = 0; (i < cur_pred_trajs.size) && (*is_pruned == false);
+           ++i) {
+        const PredTrajectory &car_traj = cur_pred_trajs.trajs[i];
+        const double t_end = std::min(std::min(t_end_traj, t_begin + t_window),
+                                      car_traj.t_end - t_start_traj);
+        if (t_end <= t_begin) { continue; }
+        
+        traj_cost_risk += (risk_gain * car_traj.probability
+                           * GetCollisionRisk(traj, car_traj, t_start_traj,
+                                              t_begin, t_end,
+                                              pred_envelopes.max_s));
+        
+        // Stop once the traj is already too costly
+        *is_pruned = ((traj_cost_tgtdev + traj_cost_risk) > cost_bound);
+      } // loop to detected car's next predicted path
+    } // loop to next detected car
+  } // loop to next time window
 
   // Set total trajectory cost
   const double traj_cost = traj_cost_risk + traj_cost_tgtdev;
@@ -520,7 +976,11 @@ double EvalTrajCost(const VehTrajectory traj, const EgoVehicle &ego_car,
   // Debug logging
   if (kDBGTrajectory != 0) {
     std::cout << "  Eval traj cost: risk = " << traj_cost_risk
-              << " tgt_dev = " << traj_cost_tgtdev << std::endl;
+              << " tgt_dev = " << traj_cost_tgtdev << ", checked "
+              << num_near_cars << " of " << detected_cars.Size()
+              << " cars";
+    if (*is_pruned) { std::cout << ", pruned by t = " << t_begin; }
+    std::cout << std::endl;
   }
   
   return traj_cost;
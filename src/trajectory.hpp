@@ -11,26 +11,97 @@
 #include <stdio.h>
 #include <random>
 #include "vehicle.hpp"
+#include "frenet_map.hpp"
+#include "occupancy_grid.hpp"
 
-VehTrajectory GetBufferTrajectory(int idx_current_pt,
-                                  VehTrajectory prev_ego_traj);
+/**
+ * Time-power basis tables over the kTimeBasisSteps sim cycle time steps
+ * t = (i+1) * kSimCycleTime, so sampling a quintic polynomial at a step is a
+ * dot product of the step's row with its coefficients.  Row i of pos is
+ * [1, t, t^2, t^3, t^4, t^5], and rows of vel and acc are its 1st and 2nd
+ * time derivatives.
+ */
+struct TimeBasis {
+  double pos[kTimeBasisSteps][6];
+  double vel[kTimeBasisSteps][6];
+  double acc[kTimeBasisSteps][6];
+};
+
+// Bounds in s relative to the ego car and in d of a detected car's predicted
+// paths of all intents
+struct PredEnvelope {
+  double min_s;
+  double max_s;
+  double min_d;
+  double max_d;
+};
+
+/**
+ * Predicted path envelopes of all detected cars (by dense index in the
+ * detected vehicle table) from the start of the new ego traj, for broad-phase
+ * culling of the collision risk checks, with the largest reach of any
+ * envelope from its car's current position for lane index lookups
+ */
+struct PredEnvelopes {
+  ArenaVector<PredEnvelope> cars;
+  double reach_s; // m, max envelope reach from its car's relative s
+  double reach_d; // m, max envelope reach from its car's d
+  double t_start; // sec, start time of new ego traj from now
+  double t_end; // sec, latest end time of predicted paths from now
+  double ref_s; // m, ego car's s for relative s
+  double max_s; // m, track length
+};
 
 VehTrajectory GetEgoTrajectory(const EgoVehicle &ego_car,
-                         const std::map<int, DetectedVehicle> &detected_cars,
-                         const std::map<int, std::vector<int>> &car_ids_by_lane,
-                         const std::vector<double> &map_interp_s,
-                         const std::vector<double> &map_interp_x,
-                         const std::vector<double> &map_interp_y);
+                         const DetectedVehicleTable &detected_cars,
+                         const LaneIndex &car_ids_by_lane,
+                         const OccupancyGrid &occupancy_grid,
+                         const FrenetMap &frenet_map, int *num_pruned_trajs);
+
+VehTrajectory GetCycleTrajectory();
+
+PredTrajectory GetPredTrajectory(const VehTrajectory &traj);
 
 VehTrajectory GetTrajectory(VehState start_state, double t_tgt,
                             double v_tgt, double d_tgt, double a_tgt,
-                            const std::vector<double> &map_interp_s,
-                            const std::vector<double> &map_interp_x,
-                            const std::vector<double> &map_interp_y);
+                            const FrenetMap &frenet_map);
+
+ArenaVector<VehTrajectory> GetTrajectories(VehState start_state, double t_tgt,
+                                           const double *v_tgts,
+                                           const double *d_tgts,
+                                           int num_trajs, double a_tgt,
+                                           const FrenetMap &frenet_map);
+
+void SetTrajXY(const FrenetMap &frenet_map, VehTrajectory *traj);
+
+const TimeBasis& GetSimTimeBasis();
+
+void SampleQuinticBatch(const Poly<5> *polys, int num_polys, int num_pts,
+                        double *pts_pos, double *pts_vel, double *pts_acc);
+
+void CheckTrajFeasibility(const VehTrajectory &traj,
+                          const FrenetMap &frenet_map,
+                          double *spd_adj_ratio, double *a_adj_ratio);
+
+PredEnvelopes GetPredEnvelopes(const EgoVehicle &ego_car,
+                               const DetectedVehicleTable &detected_cars,
+                               double max_s);
+
+int CullCarsNearTraj(const VehTrajectory &traj,
+                     const DetectedVehicleTable &detected_cars,
+                     const LaneIndex &car_ids_by_lane,
+                     const PredEnvelopes &pred_envelopes,
+                     int *idx_near_cars);
 
-std::vector<double> CheckTrajFeasibility(const VehTrajectory traj);
+double GetCollisionRisk(const VehTrajectory &traj,
+                        const PredTrajectory &car_traj, double t_start,
+                        double t_begin, double t_end, double max_s);
 
-double EvalTrajCost(const VehTrajectory traj, const EgoVehicle &ego_car,
-                    const std::map<int, DetectedVehicle> &detected_cars);
+double EvalTrajCost(const VehTrajectory &traj, const EgoVehicle &ego_car,
+                    const DetectedVehicleTable &detected_cars,
+                    const LaneIndex &car_ids_by_lane,
+                    const PredEnvelopes &pred_envelopes,
+                    const OccupancyGrid &occupancy_grid, double cost_bound,
+                    bool *is_pruned);
 
 #endif /* trajectory_hpp */
@@ -7,10 +7,54 @@
 
 #include "vehicle.hpp"
 
+//// TrajRingBuffer class ////
+
+static_assert((kEgoTrajCapacity & (kEgoTrajCapacity - 1)) == 0,
+              "ego traj ring buffer capacity must be a power of 2");
+
+// Constructor/Destructor
+TrajRingBuffer::TrajRingBuffer()
+    : states_(kEgoTrajCapacity), head_tick_(0), tail_tick_(0) { }
+TrajRingBuffer::~TrajRingBuffer() { }
+
+/**
+ * Drop states from the front of the buffer by advancing the head tick
+ */
+void TrajRingBuffer::DropFront(int num_states) {
+  head_tick_ += std::min(std::max(num_states, 0), Size());
+}
+
+/**
+ * Cut states from the back of the buffer to keep at most num_states
+ */
+void TrajRingBuffer::Truncate(int num_states) {
+  tail_tick_ = head_tick_ + std::min(std::max(num_states, 0), Size());
+}
+
+/**
+ * Write a trajectory's states at the tail of the buffer.  States past the
+ * buffer's capacity (furthest in the future) are not kept, so returns the
+ * number of states kept for the caller to check.
+ */
+int TrajRingBuffer::Append(const VehTrajectory &traj) {
+  const int num_states = std::min(int(traj.states.size()),
+                                  kEgoTrajCapacity - Size());
+  for (int i = 0; i < num_states; ++i) {
+    states_[tail_tick_ & kTickMask] = traj.states[i];
+    tail_tick_++;
+  }
+  return num_states;
+}
+
+/**
+ * Drop all states while keeping the tick count going
+ */
+void TrajRingBuffer::Clear() { head_tick_ = tail_tick_; }
+
 //// Vehicle base class ////
 
 // Constructor/Destructor
-Vehicle::Vehicle() { }
+Vehicle::Vehicle() : wp_hint_(-1) { }
 Vehicle::~Vehicle() { }
 
 /**
@@ -19,14 +63,14 @@ Vehicle::~Vehicle() { }
 int Vehicle::GetID() const { return veh_id_; }
 void Vehicle::SetID(int veh_id) { veh_id_ = veh_id; }
 int Vehicle::GetLane() const { return lane_; }
-VehState Vehicle::GetState() const { return state_; }
-VehTrajectory Vehicle::GetTraj() const { return traj_; }
-void Vehicle::SetTraj(VehTrajectory traj) { traj_ = traj; }
+int Vehicle::GetWaypointHint() const { return wp_hint_; }
+void Vehicle::SetWaypointHint(int wp_hint) { wp_hint_ = wp_hint; }
+const VehState& Vehicle::GetState() const { return state_; }
 
 /**
  * Update vehicle's state values and calculate its new lane position
  */
-void Vehicle::UpdateState(VehState new_state) {
+void Vehicle::UpdateState(const VehState &new_state) {
   
   // Update state values
   state_ = new_state;
@@ -41,24 +85,6 @@ void Vehicle::UpdateState(VehState new_state) {
   lane_ = lane;
 }
 
-/**
- * Reset vehicle's trajectory
- */
-void Vehicle::ClearTraj() {
-  traj_.states.clear();
-  traj_.probability = 0.;
-  traj_.cost = 0.;
-}
-
-/**
- * Append a trajectory to the end of the vehicle's current trajectory
- */
-void Vehicle::AppendTraj(VehTrajectory traj) {
-  for (int i = 0; i < traj.states.size(); ++i) {
-    traj_.states.push_back(traj.states[i]);
-  }
-}
-
 //// EgoVehicle sub-class ////
 
 // Constructor/Destructor
@@ -72,7 +98,10 @@ EgoVehicle::~EgoVehicle() { }
  * Member data accessors
  */
 int EgoVehicle::GetLaneChangeCounter() const { return counter_lane_change_; }
-VehBehavior EgoVehicle::GetTgtBehavior() const { return tgt_behavior_; }
+const VehBehavior& EgoVehicle::GetTgtBehavior() const {
+  return tgt_behavior_;
+}
+const TrajRingBuffer& EgoVehicle::GetTraj() const { return traj_; }
 
 /**
  * Set the vehicle's final target behavior and update lane counter
@@ -109,49 +138,526 @@ void EgoVehicle::SetTgtBehavior(VehBehavior new_tgt_beh) {
   }
 }
 
+/**
+ * Keep a part of the ego trajectory just after the current index as a buffer
+ * to start the next trajectory, to keep smooth continuity for communication
+ * between the path planner and the simulator driving the points.  The states
+ * up to the current one are dropped from the head and any states past the
+ * buffer are cut from the tail, in place.  The buffer is empty if the current
+ * index is at 0.
+ */
+void EgoVehicle::TrimTrajToBuffer(int idx_current_pt) {
+  const int buffer_pts = kPathBufferTime / kSimCycleTime;
+  if (idx_current_pt > 0) {
+    traj_.DropFront(idx_current_pt+1);
+    traj_.Truncate(buffer_pts);
+  }
+  else {
+    traj_.Clear();
+  }
+}
+
+/**
+ * Append a trajectory to the end of the ego car's current trajectory.
+ * Returns the number of states kept, fewer than the trajectory's if the ego
+ * traj would be longer than kEgoTrajCapacity.
+ */
+int EgoVehicle::AppendTraj(const VehTrajectory &traj) {
+  return traj_.Append(traj);
+}
+
 //// DetectedVehicle sub-class ////
  
 // Constructor/Destructor
-DetectedVehicle::DetectedVehicle() : Vehicle() { }
+DetectedVehicle::DetectedVehicle() : Vehicle() { pred_trajs_.size = 0; }
 DetectedVehicle::~DetectedVehicle() { }
 
 /**
  * Member data accessors
  */
 double DetectedVehicle::GetRelS() const { return s_rel_; }
-void DetectedVehicle::ClearPredTrajs() { pred_trajs_.clear(); }
-std::map<VehIntents, VehTrajectory> DetectedVehicle::GetPredTrajs() const {
+void DetectedVehicle::ClearPredTrajs() { pred_trajs_.size = 0; }
+const PredTrajectories& DetectedVehicle::GetPredTrajs() const {
   return pred_trajs_;
 }
-void DetectedVehicle::SetPredTrajs(std::map<VehIntents,
-                                   VehTrajectory> pred_trajs) {
+void DetectedVehicle::SetPredTrajs(const PredTrajectories &pred_trajs) {
   pred_trajs_ = pred_trajs;
 }
 
 /**
- * Calculate relative s from ego car
+ * Calculate relative s from ego car, with s wrapping around the track at max_s
  */
-void DetectedVehicle::UpdateRelDist(const EgoVehicle &ego_car) {
+void DetectedVehicle::UpdateRelDist(const EgoVehicle &ego_car, double max_s) {
   
   double s_rel = GetState().s - ego_car.GetState().s;
   // Normalize to within sensor range in case s wraps around the track
-  while (s_rel > kSensorRange) { s_rel -= kMaxS; }
-  while (s_rel < -kSensorRange) { s_rel += kMaxS; }
+  while (s_rel > kSensorRange) { s_rel -= max_s; }
+  while (s_rel < -kSensorRange) { s_rel += max_s; }
   s_rel_ = s_rel;
 }
 
+//// DetectedVehicleTable class ////
+
+/**
+ * Detected vehicles are stored densely at indices [0, Size()) for
+ * cache-friendly iteration, with their hot state values also kept as
+ * structure of arrays by dense index.  Vehicles are found by ID or handle
+ * through slot indirection (veh ID -> slot -> dense index) without any tree
+ * traversal.  Erasing a vehicle moves the last vehicle into its dense index
+ * and bumps its slot's generation so old handles to it are invalidated.
+ */
+
+// Constructor/Destructor
+DetectedVehicleTable::DetectedVehicleTable() { }
+DetectedVehicleTable::~DetectedVehicleTable() { }
+
+/**
+ * Member data accessors
+ */
+int DetectedVehicleTable::Size() const { return cars_.size(); }
+bool DetectedVehicleTable::Contains(int veh_id) const {
+  return (Find(veh_id) >= 0);
+}
+const DetectedVehicle& DetectedVehicleTable::GetCar(int idx) const {
+  return cars_[idx];
+}
+
+/**
+ * Find dense index of vehicle by ID, or -1 if not in the table
+ */
+int DetectedVehicleTable::Find(int veh_id) const {
+  if ((veh_id < 0) || (veh_id >= int(id_slots_.size()))
+      || (id_slots_[veh_id] < 0)) {
+    return -1;
+  }
+  return slots_[id_slots_[veh_id]].dense_idx;
+}
+
+/**
+ * Find dense index of vehicle by handle, or -1 if it was erased
+ */
+int DetectedVehicleTable::Find(VehHandle handle) const {
+  if ((handle.slot < 0) || (handle.slot >= int(slots_.size()))
+      || (slots_[handle.slot].generation != handle.generation)) {
+    return -1;
+  }
+  return slots_[handle.slot].dense_idx;
+}
+
+/**
+ * Get handle to vehicle by ID ({-1, -1} if not in the table)
+ */
+VehHandle DetectedVehicleTable::GetHandle(int veh_id) const {
+  VehHandle handle = {-1, -1};
+  if (Find(veh_id) >= 0) {
+    handle.slot = id_slots_[veh_id];
+    handle.generation = slots_[handle.slot].generation;
+  }
+  return handle;
+}
+
+/**
+ * Get vehicle by ID, throwing std::out_of_range if not in the table
+ */
+const DetectedVehicle& DetectedVehicleTable::At(int veh_id) const {
+  const int idx = Find(veh_id);
+  if (idx < 0) {
+    throw std::out_of_range("Vehicle ID not in detected vehicle table");
+  }
+  return cars_[idx];
+}
+
+/**
+ * Add a new vehicle with ID veh_id at the end of the table, reusing a free
+ * slot if there is one.  Returns the new vehicle's dense index, or the
+ * existing one's if the ID is already in the table.
+ */
+int DetectedVehicleTable::Insert(int veh_id) {
+  
+  const int idx_found = Find(veh_id);
+  if (idx_found >= 0) { return idx_found; }
+  
+  int slot;
+  if (free_slots_.size() > 0) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  }
+  else {
+    slot = slots_.size();
+    slots_.push_back({-1, 0});
+  }
+  if (veh_id >= int(id_slots_.size())) { id_slots_.resize(veh_id + 1, -1); }
+  id_slots_[veh_id] = slot;
+  
+  const int idx = cars_.size();
+  slots_[slot].dense_idx = idx;
+  dense_slots_.push_back(slot);
+  cars_.push_back(DetectedVehicle());
+  cars_[idx].SetID(veh_id);
+  ids_.push_back(veh_id);
+  lanes_.push_back(0);
+  s_.push_back(0.);
+  d_.push_back(0.);
+  s_dot_.push_back(0.);
+  rel_s_.push_back(0.);
+  
+  return idx;
+}
+
+/**
+ * Remove vehicle by ID, moving the last vehicle into its dense index
+ */
+void DetectedVehicleTable::Erase(int veh_id) {
+  
+  const int idx = Find(veh_id);
+  if (idx < 0) { return; }
+  
+  // Free the erased vehicle's slot with a new generation
+  const int slot = id_slots_[veh_id];
+  slots_[slot].dense_idx = -1;
+  slots_[slot].generation++;
+  free_slots_.push_back(slot);
+  id_slots_[veh_id] = -1;
+  
+  // Move last vehicle into erased one's dense index
+  const int idx_last = cars_.size() - 1;
+  if (idx != idx_last) {
+    dense_slots_[idx] = dense_slots_[idx_last];
+    slots_[dense_slots_[idx]].dense_idx = idx;
+    cars_[idx] = std::move(cars_[idx_last]);
+    ids_[idx] = ids_[idx_last];
+    lanes_[idx] = lanes_[idx_last];
+    s_[idx] = s_[idx_last];
+    d_[idx] = d_[idx_last];
+    s_dot_[idx] = s_dot_[idx_last];
+    rel_s_[idx] = rel_s_[idx_last];
+  }
+  dense_slots_.pop_back();
+  cars_.pop_back();
+  ids_.pop_back();
+  lanes_.pop_back();
+  s_.pop_back();
+  d_.pop_back();
+  s_dot_.pop_back();
+  rel_s_.pop_back();
+}
+
+/**
+ * Update state, waypoint hint and relative s from ego car of the vehicle at
+ * dense index idx, keeping its hot state values in sync
+ */
+void DetectedVehicleTable::UpdateCar(int idx, const VehState &new_state,
+                                     int wp_hint, const EgoVehicle &ego_car,
+                                     double max_s) {
+  
+  DetectedVehicle &car = cars_[idx];
+  car.UpdateState(new_state);
+  car.SetWaypointHint(wp_hint);
+  car.UpdateRelDist(ego_car, max_s);
+  
+  lanes_[idx] = car.GetLane();
+  s_[idx] = new_state.s;
+  d_[idx] = new_state.d;
+  s_dot_[idx] = new_state.s_dot;
+  rel_s_[idx] = car.GetRelS();
+}
+
+void DetectedVehicleTable::SetPredTrajs(int idx,
+                                        const PredTrajectories &pred_trajs) {
+  cars_[idx].SetPredTrajs(pred_trajs);
+}
+
+//// LaneIndex class ////
+
+// Constructor/Destructor
+LaneIndex::LaneIndex() : lane_capacity_(kLaneIndexCapacity) {
+  for (int lane = 0; lane < kNumLaneBuckets; ++lane) { lane_sizes_[lane] = 0; }
+  lane_cars_.resize(kNumLaneBuckets * lane_capacity_);
+}
+LaneIndex::~LaneIndex() { }
+
+/**
+ * Lane bucket of a lane #, with lanes outside of the num_index_lanes indexed
+ * lanes in the out-of-lanes bucket after them
+ */
+static int GetIndexLane(int lane, int num_index_lanes) {
+  return ((lane >= 0) && (lane < num_index_lanes)) ? lane : num_index_lanes;
+}
+
+/**
+ * Member data accessors
+ */
+int LaneIndex::GetNumLanes() const { return kNumIndexLanes; }
+
+/**
+ * Get view of the sorted cars in an indexed lane, valid until the next
+ * Update().  Empty for lanes that aren't indexed, whose cars are only in the
+ * out-of-lanes bucket.
+ */
+LaneCarsView LaneIndex::GetLaneCars(int lane) const {
+  LaneCarsView lane_cars = {NULL, 0};
+  if ((lane >= 0) && (lane < kNumIndexLanes)) {
+    lane_cars.cars = &lane_cars_[lane * lane_capacity_];
+    lane_cars.size = lane_sizes_[lane];
+  }
+  return lane_cars;
+}
+
+/**
+ * Get view of the sorted cars in all lanes beyond the indexed lanes (mixed
+ * lanes, so check each car's own lane), valid until the next Update()
+ */
+LaneCarsView LaneIndex::GetOutOfLanesCars() const {
+  LaneCarsView lane_cars = {&lane_cars_[kNumIndexLanes * lane_capacity_],
+                            lane_sizes_[kNumIndexLanes]};
+  return lane_cars;
+}
+
+/**
+ * Get the closest car ahead/behind (check_side = kFront or kBack) in the check
+ * lane from the neighbor table, for the detected car at dense index idx_check
+ * or the ego car (idx_check = -1).  Return false if the table doesn't cover
+ * the check, which is only for detected cars with check lane not adjacent or
+ * for cars or check lanes beyond the indexed lanes.
+ */
+bool LaneIndex::GetNeighbor(VehSides check_side, int check_lane,
+                            int idx_check, LaneCar *neighbor) const {
+  
+  if (((check_side != kFront) && (check_side != kBack))
+      || (check_lane < 0) || (check_lane >= kNumIndexLanes)
+      || (idx_check >= int(car_neighbors_.size()))) {
+    return false;
+  }
+  const int idx_side = (check_side == kFront) ? 1 : 0;
+  
+  if (idx_check < 0) {
+    *neighbor = ego_neighbors_[check_lane][idx_side];
+    return true;
+  }
+  
+  const CarNeighbors &check_neighbors = car_neighbors_[idx_check];
+  if (check_neighbors.lane < 0) { return false; } // car out of indexed lanes
+  const int lane_offset = check_lane - check_neighbors.lane;
+  if (abs(lane_offset) > 1) { return false; }
+  *neighbor = check_neighbors.cars[lane_offset + 1][idx_side];
+  return true;
+}
+
+/**
+ * Grow each lane's block of storage to hold at least min_capacity cars,
+ * keeping the cars already in each lane
+ */
+void LaneIndex::GrowLaneCapacity(int min_capacity) {
+  
+  const int new_capacity = std::max(2 * lane_capacity_, min_capacity);
+  std::vector<LaneCar> new_lane_cars(kNumLaneBuckets * new_capacity);
+  for (int lane = 0; lane < kNumLaneBuckets; ++lane) {
+    std::copy(lane_cars_.begin() + lane * lane_capacity_,
+              lane_cars_.begin() + lane * lane_capacity_ + lane_sizes_[lane],
+              new_lane_cars.begin() + lane * new_capacity);
+  }
+  lane_cars_.swap(new_lane_cars);
+  lane_capacity_ = new_capacity;
+}
+
+/**
+ * Update the lane index to the current cars in the detected_cars table,
+ * starting from the previous cycle's sorted lanes:
+ *   1. Refresh relative s of cars still in the same lane, and drop cars that
+ *      were erased or changed lanes
+ *   2. Add new cars and cars that changed lanes at the end of their lane
+ *   3. Re-sort each lane by insertion sort
+ *   4. Build the neighbor table from the sorted lanes
+ *
+ * Cars rarely pass each other within a cycle, so the lanes are nearly sorted
+ * and the insertion sort is close to a single linear pass.  Storage is only
+ * reallocated when there are more cars than the lane capacity.
+ */
+void LaneIndex::Update(const EgoVehicle &ego_car,
+                       const DetectedVehicleTable &detected_cars) {
+  
+  const int num_cars = detected_cars.Size();
+  if (num_cars > lane_capacity_) { GrowLaneCapacity(num_cars); }
+  is_car_indexed_.assign(num_cars, false);
+  
+  // Refresh cars still in their lane and drop the rest, keeping their order
+  for (int lane = 0; lane < kNumLaneBuckets; ++lane) {
+    LaneCar *lane_start = &lane_cars_[lane * lane_capacity_];
+    int num_kept = 0;
+    for (int i = 0; i < lane_sizes_[lane]; ++i) {
+      const int idx_car = detected_cars.Find(lane_start[i].id);
+      if ((idx_car >= 0)
+          && (GetIndexLane(detected_cars.GetLane(idx_car), kNumIndexLanes)
+              == lane)) {
+        lane_start[num_kept].id = lane_start[i].id;
+        lane_start[num_kept].rel_s = detected_cars.GetRelS(idx_car);
+        is_car_indexed_[idx_car] = true;
+        num_kept++;
+      }
+    }
+    lane_sizes_[lane] = num_kept;
+  }
+  
+  // Add cars not in the index yet at the end of their lane
+  for (int i = 0; i < num_cars; ++i) {
+    if (is_car_indexed_[i] == false) {
+      const int idx_lane = GetIndexLane(detected_cars.GetLane(i),
+                                        kNumIndexLanes);
+      LaneCar &lane_car = lane_cars_[idx_lane * lane_capacity_
+                                     + lane_sizes_[idx_lane]++];
+      lane_car.rel_s = detected_cars.GetRelS(i);
+      lane_car.id = detected_cars.GetID(i);
+    }
+  }
+  
+  // Insertion sort each lane's cars by s relative to ego car
+  for (int lane = 0; lane < kNumLaneBuckets; ++lane) {
+    LaneCar *lane_start = &lane_cars_[lane * lane_capacity_];
+    for (int i = 1; i < lane_sizes_[lane]; ++i) {
+      const LaneCar cur_car = lane_start[i];
+      int j = i;
+      while ((j > 0) && (lane_start[j-1].rel_s < cur_car.rel_s)) {
+        lane_start[j] = lane_start[j-1]; // higher s_rel first
+        j--;
+      }
+      lane_start[j] = cur_car;
+    }
+  }
+  
+  UpdateNeighbors(ego_car, detected_cars);
+}
+
+/**
+ * Closest car ahead/behind (check_side = kFront or kBack) a reference car at
+ * ref_s_rel in a sorted lane, where idx_closest is the lane index of the
+ * closest car on that side (-1 or lane size if none).  The ego car is then
+ * checked last at relative s = 0 if it's in the lane.  Same results as a
+ * FindCarInLane scan: {check_id, +/-kSensorRange} if nothing in sensor range.
+ */
+static LaneCar FindClosestInLane(VehSides check_side, double ref_s_rel,
+                                 int check_id, const LaneCarsView &lane_cars,
+                                 int idx_closest, bool is_ego_in_lane,
+                                 int ego_id) {
+  
+  LaneCar closest;
+  closest.id = check_id;
+  closest.rel_s = (check_side == kFront) ? kSensorRange : -kSensorRange;
+  
+  if ((idx_closest >= 0) && (idx_closest < lane_cars.size)) {
+    const double cur_dist = lane_cars[idx_closest].rel_s - ref_s_rel;
+    if (fabs(cur_dist) < kSensorRange) {
+      closest.id = lane_cars[idx_closest].id;
+      closest.rel_s = cur_dist;
+    }
+  }
+  
+  if (is_ego_in_lane) {
+    const double ego_dist = -ref_s_rel;
+    if (((check_side == kFront)
+           && (ego_dist > 0.) && (ego_dist < closest.rel_s))
+        || ((check_side == kBack)
+              && (ego_dist < 0.) && (ego_dist > closest.rel_s))) {
+      closest.id = ego_id;
+      closest.rel_s = ego_dist;
+    }
+  }
+  
+  return closest;
+}
+
+/**
+ * Build the neighbor table from the sorted lanes.  For each pair of a car's
+ * lane and a check lane, the cars of both lanes are walked together in
+ * sorted order, so the whole table is built in linear time.
+ */
+void LaneIndex::UpdateNeighbors(const EgoVehicle &ego_car,
+                                const DetectedVehicleTable &detected_cars) {
+  
+  const int ego_id = ego_car.GetID();
+  const int ego_lane = ego_car.GetLane();
+  car_neighbors_.resize(detected_cars.Size());
+  
+  // Cars out of the indexed lanes have no neighbor table entries
+  const LaneCarsView out_cars = GetOutOfLanesCars();
+  for (int i = 0; i < out_cars.size; ++i) {
+    car_neighbors_[detected_cars.Find(out_cars[i].id)].lane = -1;
+  }
+  
+  // Ego car's neighbors in every lane
+  for (int lane = 0; lane < kNumIndexLanes; ++lane) {
+    const LaneCarsView lane_cars = GetLaneCars(lane);
+    int idx_behind = 0;
+    while ((idx_behind < lane_cars.size)
+           && (lane_cars[idx_behind].rel_s > 0.)) {
+      idx_behind++;
+    }
+    const int idx_ahead = idx_behind - 1;
+    while ((idx_behind < lane_cars.size)
+           && (lane_cars[idx_behind].rel_s >= 0.)) {
+      idx_behind++;
+    }
+    ego_neighbors_[lane][0] = FindClosestInLane(kBack, 0., ego_id, lane_cars,
+                                                idx_behind, false, ego_id);
+    ego_neighbors_[lane][1] = FindClosestInLane(kFront, 0., ego_id, lane_cars,
+                                                idx_ahead, false, ego_id);
+  }
+  
+  // Detected cars' neighbors in their own and adjacent lanes
+  const LaneCarsView no_cars = {NULL, 0};
+  for (int lane = 0; lane < kNumIndexLanes; ++lane) {
+    const LaneCarsView ref_cars = GetLaneCars(lane);
+    for (int lane_offset = -1; lane_offset <= 1; ++lane_offset) {
+      const int check_lane = lane + lane_offset;
+      const bool is_lane_indexed = ((check_lane >= 0)
+                                    && (check_lane < kNumIndexLanes));
+      const LaneCarsView check_cars = (is_lane_indexed ? GetLaneCars(check_lane)
+                                                       : no_cars);
+      const bool is_ego_in_lane = (is_lane_indexed && (check_lane == ego_lane));
+      
+      // Reference cars are sorted by decreasing s_rel, so the check lane
+      // positions of the closest cars ahead/behind only move forward
+      int idx_not_ahead = 0;
+      int idx_behind = 0;
+      for (int i = 0; i < ref_cars.size; ++i) {
+        const double ref_s_rel = ref_cars[i].rel_s;
+        while ((idx_not_ahead < check_cars.size)
+               && (check_cars[idx_not_ahead].rel_s > ref_s_rel)) {
+          idx_not_ahead++;
+        }
+        idx_behind = std::max(idx_behind, idx_not_ahead);
+        while ((idx_behind < check_cars.size)
+               && (check_cars[idx_behind].rel_s >= ref_s_rel)) {
+          idx_behind++;
+        }
+        
+        const int idx_car = detected_cars.Find(ref_cars[i].id);
+        CarNeighbors &car_neighbors = car_neighbors_[idx_car];
+        car_neighbors.lane = lane;
+        car_neighbors.cars[lane_offset + 1][0] = FindClosestInLane(kBack,
+            ref_s_rel, ref_cars[i].id, check_cars, idx_behind, is_ego_in_lane,
+            ego_id);
+        car_neighbors.cars[lane_offset + 1][1] = FindClosestInLane(kFront,
+            ref_s_rel, ref_cars[i].id, check_cars, idx_not_ahead - 1,
+            is_ego_in_lane, ego_id);
+      }
+    }
+  }
+}
+
 //// General vehicle functions ////
  
 /**
  * For the specified car ID# (check_id), check in the specified
  * lane (check_lane) to find the car ahead/behind (check_side = kFront or kBack)
- * and return a tuple of {car ID, relative s distance}.
+ * and return a tuple of {car ID, relative s distance}.  Answered from the lane
+ * index's neighbor table when it covers the check, otherwise by scanning the
+ * check lane's cars.
  */
 std::tuple<int, double> FindCarInLane(const VehSides check_side,
                        const int check_lane, const int check_id,
                        const EgoVehicle &ego_car,
-                       const std::map<int, DetectedVehicle> &detected_cars,
-                       const std::map<int, std::vector<int>> &car_ids_by_lane) {
+                       const DetectedVehicleTable &detected_cars,
+                       const LaneIndex &car_ids_by_lane) {
   
   // Set default return values in case of no car ahead
   int car_id_found = check_id; // default to same as check car
@@ -160,41 +666,53 @@ std::tuple<int, double> FindCarInLane(const VehSides check_side,
     s_rel_found *= -1.; // flip sign if looking behind
   }
 
-  // Copy car ID's to check in the lane to a vector
-  std::vector<int> cars_in_check_lane;
-  if (car_ids_by_lane.count(check_lane) > 0) {
-    for (int i = 0; i < car_ids_by_lane.at(check_lane).size(); ++i) {
-      cars_in_check_lane.push_back(car_ids_by_lane.at(check_lane)[i]);
-    }
+  // Answer from the lane index's neighbor table if it covers this check
+  const int idx_check = ((check_id != ego_car.GetID())
+                         ? detected_cars.Find(check_id) : -1);
+  LaneCar neighbor;
+  if (((check_id == ego_car.GetID()) || (idx_check >= 0))
+      && car_ids_by_lane.GetNeighbor(check_side, check_lane, idx_check,
+                                     &neighbor)) {
+    return std::make_tuple(neighbor.id, neighbor.rel_s);
   }
   
-  // Add ego car ID to the check lane for other cars to find
-  if ((check_id != ego_car.GetID()) && (check_lane == ego_car.GetLane())) {
-    cars_in_check_lane.push_back(ego_car.GetID());
+  // Set reference relative s value of car doing the check
+  double ref_s_rel;
+  if (check_id != ego_car.GetID()) {
+    ref_s_rel = detected_cars.GetRelS(idx_check);
+  }
+  else {
+    ref_s_rel = 0.; // ego car
   }
   
-  // Look for car in the lane
-  for (int i = 0; i < cars_in_check_lane.size(); ++i) {
-    const int cur_car_id = cars_in_check_lane[i];
+  // Look for car in the lane, with ego car checked last for other cars to find.
+  // A lane beyond the indexed lanes is scanned in the out-of-lanes bucket,
+  // skipping the bucket's cars in other lanes.
+  const bool is_lane_indexed = (check_lane < car_ids_by_lane.GetNumLanes());
+  const LaneCarsView cars_in_check_lane = (is_lane_indexed
+      ? car_ids_by_lane.GetLaneCars(check_lane)
+      : car_ids_by_lane.GetOutOfLanesCars());
+  const bool is_ego_in_lane = ((check_id != ego_car.GetID())
+                               && (check_lane == ego_car.GetLane()));
+  const int num_check = cars_in_check_lane.size + (is_ego_in_lane ? 1 : 0);
+  for (int i = 0; i < num_check; ++i) {
+    int cur_car_id;
     double cur_s_rel;
-    double ref_s_rel;
-    if (cur_car_id != check_id) { // only check if it's not yourself
-      // Set relative s value for the current car in the lane
-      if (cur_car_id != ego_car.GetID()) {
-        cur_s_rel = detected_cars.at(cur_car_id).GetRelS(); // other car
-      }
-      else {
-        cur_s_rel = 0.; // ego car
-      }
-      
-      // Set reference relative s value of car doing the check
-      if (check_id != ego_car.GetID()) {
-        ref_s_rel = detected_cars.at(check_id).GetRelS(); // car doing the check
-      }
-      else {
-        ref_s_rel = 0.; // ego car
+    if (i < cars_in_check_lane.size) {
+      cur_car_id = cars_in_check_lane[i].id;
+      cur_s_rel = cars_in_check_lane[i].rel_s;
+      if (!is_lane_indexed
+          && (detected_cars.GetLane(detected_cars.Find(cur_car_id))
+              != check_lane)) {
+        continue;
       }
-      
+    }
+    else {
+      cur_car_id = ego_car.GetID();
+      cur_s_rel = 0.; // ego car
+    }
+    
+    if (cur_car_id != check_id) { // only check if it's not yourself
       // Found closer car ahead if dist is positive and less than prev found,
       // or behind if dist is negative and greater than prev found
       const double cur_dist = cur_s_rel - ref_s_rel;
@@ -220,8 +738,8 @@ std::tuple<int, double> FindCarInLane(const VehSides check_side,
  */
 double EgoCheckSideGap(const VehSides check_side,
                        const EgoVehicle &ego_car,
-                       const std::map<int, DetectedVehicle> &detected_cars,
-                       const std::map<int, std::vector<int>> &car_ids_by_lane) {
+                       const DetectedVehicleTable &detected_cars,
+                       const LaneIndex &car_ids_by_lane) {
   
   double gap_on_side;
   
@@ -239,7 +757,7 @@ double EgoCheckSideGap(const VehSides check_side,
   }
   else {
     const int check_lane = ego_car.GetLane() + int(check_side);
-    if (car_ids_by_lane.count(check_lane) > 0) {
+    if (car_ids_by_lane.GetLaneCars(check_lane).size > 0) {
       // Get car ahead and behind in the check lane
       auto car_ahead = FindCarInLane(kFront, check_lane, ego_car.GetID(),
                                      ego_car, detected_cars, car_ids_by_lane);
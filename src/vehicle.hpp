@@ -9,7 +9,9 @@
 #define vehicle_hpp
 
 #include <stdio.h>
+#include <stdexcept>
 #include "path_common.hpp"
+#include "arena.hpp"
 
 enum VehSides {
   kLeft = -1,
@@ -46,9 +48,57 @@ struct VehState {
 };
 
 struct VehTrajectory {
-  std::deque<VehState> states;
+  ArenaVector<VehState> states;
   double probability;
   double cost;
+  Poly<5> poly_s; // JMT polys of the states, time 0 at the start state
+  Poly<5> poly_d;
+};
+
+// Predicted trajectory as its Frenet JMT polys (time 0 at the car's current
+// state) up to end time t_end, for continuous time collision risk checks
+struct PredTrajectory {
+  Poly<5> s;
+  Poly<5> d;
+  double t_end;
+  double probability;
+};
+
+// Predicted trajectories of a detected car for each of its predicted intents
+// in fixed storage, so a new cycle's predictions are written in place
+struct PredTrajectories {
+  VehIntents intents[kNumPredIntents];
+  PredTrajectory trajs[kNumPredIntents];
+  int size;
+};
+
+// Fixed capacity ring buffer of trajectory states indexed by sim tick (# of
+// states since the first one), so a path is kept in place between cycles.
+// States the sim has driven are dropped by advancing the head, and new states
+// are written directly at the tail.
+class TrajRingBuffer {
+public:
+  // Constructor/Destructor
+  TrajRingBuffer();
+  ~TrajRingBuffer();
+  
+  int Size() const { return tail_tick_ - head_tick_; }
+  long long GetHeadTick() const { return head_tick_; }
+  const VehState& operator[](int i) const {
+    return states_[(head_tick_ + i) & kTickMask];
+  }
+  const VehState& Back() const { return (*this)[Size() - 1]; }
+  void DropFront(int num_states);
+  void Truncate(int num_states);
+  int Append(const VehTrajectory &traj);
+  void Clear();
+
+private:
+  static constexpr int kTickMask = kEgoTrajCapacity - 1;
+  
+  std::vector<VehState> states_;
+  long long head_tick_;
+  long long tail_tick_;
 };
 
 // Base class for all vehicles
@@ -56,23 +106,21 @@ class Vehicle {
 public:
   // Constructor/Destructor
   Vehicle();
-  virtual ~Vehicle();
+  ~Vehicle();
 
   int GetID() const;
   void SetID(int veh_id);
   int GetLane() const;
-  VehState GetState() const;
-  VehTrajectory GetTraj() const;
-  void SetTraj(VehTrajectory traj);
-  void UpdateState(VehState new_state);
-  void ClearTraj();
-  void AppendTraj(VehTrajectory traj);
+  int GetWaypointHint() const;
+  void SetWaypointHint(int wp_hint);
+  const VehState& GetState() const;
+  void UpdateState(const VehState &new_state);
   
 private:
   int veh_id_;
   int lane_;
+  int wp_hint_;
   VehState state_;
-  VehTrajectory traj_;
 };
 
 // Subclass for ego vehicle
@@ -80,16 +128,20 @@ class EgoVehicle : public Vehicle {
 public:
   // Constructor/destructor
   EgoVehicle();
-  virtual ~EgoVehicle();
+  ~EgoVehicle();
   
   int GetLaneChangeCounter() const;
-  VehBehavior GetTgtBehavior() const;
+  const VehBehavior& GetTgtBehavior() const;
   void SetTgtBehavior(VehBehavior new_tgt_beh);
+  const TrajRingBuffer& GetTraj() const;
+  void TrimTrajToBuffer(int idx_current_pt);
+  int AppendTraj(const VehTrajectory &traj);
   
 private:
   int counter_lane_change_;
   int prev_tgt_lane_;
   VehBehavior tgt_behavior_;
+  TrajRingBuffer traj_;
 };
 
 // Subclass for all detected vehicles
@@ -97,29 +149,145 @@ class DetectedVehicle : public Vehicle {
 public:
   // Constructor/Destructor
   DetectedVehicle();
-  virtual ~DetectedVehicle();
+  ~DetectedVehicle();
   
   double GetRelS() const;
   void ClearPredTrajs();
-  std::map<VehIntents, VehTrajectory> GetPredTrajs() const;
-  void SetPredTrajs(std::map<VehIntents, VehTrajectory> pred_trajs);
-  void UpdateRelDist(const EgoVehicle &ego_car);
+  const PredTrajectories& GetPredTrajs() const;
+  void SetPredTrajs(const PredTrajectories &pred_trajs);
+  void UpdateRelDist(const EgoVehicle &ego_car, double max_s);
   
 private:
   double s_rel_;
-  std::map<VehIntents, VehTrajectory> pred_trajs_;
+  PredTrajectories pred_trajs_;
+};
+
+// Stable handle to a vehicle in the detected vehicle table, which no longer
+// finds the vehicle after it is erased (slot's generation has moved on)
+struct VehHandle {
+  int slot;
+  int generation;
+};
+
+// Dense table of all detected vehicles
+class DetectedVehicleTable {
+public:
+  // Constructor/Destructor
+  DetectedVehicleTable();
+  ~DetectedVehicleTable();
+  
+  int Size() const;
+  int Find(int veh_id) const;
+  int Find(VehHandle handle) const;
+  bool Contains(int veh_id) const;
+  VehHandle GetHandle(int veh_id) const;
+  const DetectedVehicle& At(int veh_id) const;
+  const DetectedVehicle& GetCar(int idx) const;
+  int Insert(int veh_id);
+  void Erase(int veh_id);
+  void UpdateCar(int idx, const VehState &new_state, int wp_hint,
+                 const EgoVehicle &ego_car, double max_s);
+  void SetPredTrajs(int idx, const PredTrajectories &pred_trajs);
+  
+  // Hot state values of the car at dense index idx
+  int GetID(int idx) const { return ids_[idx]; }
+  int GetLane(int idx) const { return lanes_[idx]; }
+  double GetS(int idx) const { return s_[idx]; }
+  double GetD(int idx) const { return d_[idx]; }
+  double GetSDot(int idx) const { return s_dot_[idx]; }
+  double GetRelS(int idx) const { return rel_s_[idx]; }
+
+private:
+  struct Slot {
+    int dense_idx;
+    int generation;
+  };
+  
+  std::vector<int> id_slots_;
+  std::vector<Slot> slots_;
+  std::vector<int> free_slots_;
+  std::vector<int> dense_slots_;
+  std::vector<DetectedVehicle> cars_;
+  std::vector<int> ids_;
+  std::vector<int> lanes_;
+  std::vector<double> s_;
+  std::vector<double> d_;
+  std::vector<double> s_dot_;
+  std::vector<double> rel_s_;
+};
+
+// Detected vehicle entry in the lane index (also used for neighbor entries
+// with rel_s as distance from the neighbor's reference car)
+struct LaneCar {
+  double rel_s;
+  int id;
+};
+
+// Read-only view of one lane's cars in the lane index
+struct LaneCarsView {
+  const LaneCar *cars;
+  int size;
+  
+  const LaneCar* begin() const { return cars; }
+  const LaneCar* end() const { return cars + size; }
+  const LaneCar& operator[](int i) const { return cars[i]; }
+};
+
+// Detected vehicle ID's grouped by lane # and sorted by relative s from the
+// ego car (higher s_rel first), in storage that is kept between cycles and
+// updated incrementally from the previous cycle's ordering.
+// Lanes 0 (off road on the left) to kNumLanes+1 (beyond the right lane) are
+// indexed, and cars in any lane further right are kept sorted together in a
+// separate out-of-lanes bucket.
+// Each update also builds a neighbor table with the closest car ahead and
+// behind each detected car in its own and adjacent indexed lanes, and the ego
+// car in every indexed lane.
+class LaneIndex {
+public:
+  // Constructor/Destructor
+  LaneIndex();
+  ~LaneIndex();
+  
+  int GetNumLanes() const;
+  LaneCarsView GetLaneCars(int lane) const;
+  LaneCarsView GetOutOfLanesCars() const;
+  bool GetNeighbor(VehSides check_side, int check_lane, int idx_check,
+                   LaneCar *neighbor) const;
+  void Update(const EgoVehicle &ego_car,
+              const DetectedVehicleTable &detected_cars);
+  
+private:
+  static constexpr int kNumIndexLanes = kNumLanes + 2;
+  static constexpr int kNumLaneBuckets = kNumIndexLanes + 1; // +out-of-lanes
+  
+  // Closest cars behind [0] and ahead [1] in lanes on left, same and right
+  struct CarNeighbors {
+    int lane;
+    LaneCar cars[3][2];
+  };
+  
+  void GrowLaneCapacity(int min_capacity);
+  void UpdateNeighbors(const EgoVehicle &ego_car,
+                       const DetectedVehicleTable &detected_cars);
+  
+  int lane_capacity_;
+  int lane_sizes_[kNumLaneBuckets];
+  std::vector<LaneCar> lane_cars_;
+  std::vector<char> is_car_indexed_;
+  std::vector<CarNeighbors> car_neighbors_;
+  LaneCar ego_neighbors_[kNumIndexLanes][2];
 };
 
 // General vehicle functions
 std::tuple<int, double> FindCarInLane(const VehSides check_side,
                         const int check_lane, const int check_id,
                         const EgoVehicle &ego_car,
-                        const std::map<int, DetectedVehicle> &detected_cars,
-                        const std::map<int, std::vector<int>> &car_ids_by_lane);
+                        const DetectedVehicleTable &detected_cars,
+                        const LaneIndex &car_ids_by_lane);
   
 double EgoCheckSideGap(const VehSides check_side,
                        const EgoVehicle &ego_car,
-                       const std::map<int, DetectedVehicle> &detected_cars,
-                       const std::map<int, std::vector<int>> &car_ids_by_lane);
+                       const DetectedVehicleTable &detected_cars,
+                       const LaneIndex &car_ids_by_lane);
 
 #endif /* vehicle_hpp */
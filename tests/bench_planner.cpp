@@ -0,0 +1,232 @@
+//
+//  bench_planner.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <vector>
+#include "test_common.hpp"
+#include "path_common.hpp"
+#include "frenet_map.hpp"
+#include "vehicle.hpp"
+#include "sensor_fusion.hpp"
+#include "prediction.hpp"
+#include "behavior.hpp"
+#include "trajectory.hpp"
+#include "occupancy_grid.hpp"
+
+/**
+ * Closed-loop planner benchmark without the simulator.
+ *
+ * Simulated traffic drives down the highway map at constant lane speeds,
+ * slowing down behind slower cars and the ego car, while the ego car follows
+ * its planned path the way the simulator does (consuming kBenchStepsPerCycle
+ * path points per planning cycle).  The planning cycle is the same sequence
+ * of steps as main's and its average processing time is reported.
+ *
+ * Usage: bench_planner [num_cars] [num_cycles] [--tiled] [--raster]
+ *
+ * Returns failure if the ego car collides with any simulated car or any new
+ * trajectory states are dropped from the ego traj.
+ */
+
+constexpr int kBenchStepsPerCycle = 10; // # of sim steps per planning cycle
+constexpr double kBenchCollisionS = 4.5; // m, car length overlap
+constexpr double kBenchCollisionD = 2.2; // m, car width overlap
+
+struct BenchCar {
+  double s;
+  double d;
+  double speed;
+};
+
+/**
+ * Wrap an s distance to [-max_s/2, max_s/2)
+ */
+double WrapRelS(double rel_s, double max_s) {
+  return fmod(rel_s + 1.5*max_s, max_s) - 0.5*max_s;
+}
+
+/**
+ * Move simulated cars ahead by one planning cycle, keeping them from running
+ * into slower cars or the ego car ahead of them in the same lane
+ */
+void MoveBenchCars(const VehState &ego_state, bool is_ego_valid,
+                   double max_s, std::vector<BenchCar> *cars) {
+  const double t_cycle = kBenchStepsPerCycle * kSimCycleTime;
+  for (int i = 0; i < int(cars->size()); ++i) {
+    BenchCar &car = (*cars)[i];
+    double speed = car.speed;
+    for (int j = 0; j < int(cars->size()); ++j) {
+      const BenchCar &other = (*cars)[j];
+      const double gap = fmod(other.s - car.s + max_s, max_s);
+      if ((j != i) && (std::abs(other.d - car.d) < 2.) && (gap > 0.)
+          && (gap < 25.)) {
+        speed = std::min(speed, 0.9*other.speed);
+      }
+    }
+    const double ego_gap = fmod(ego_state.s - car.s + max_s, max_s);
+    if (is_ego_valid && (std::abs(ego_state.d - car.d) < 2.5)
+        && (ego_gap < 20.)) {
+      speed = std::min(speed, 0.8*ego_state.s_dot);
+    }
+    car.s = fmod(car.s + speed*t_cycle, max_s);
+  }
+}
+
+int main(int argc, char **argv) {
+  int num_cars = 12;
+  int num_cycles = 300;
+  bool is_tiled = false;
+  bool is_raster = false;
+  int num_args = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--tiled") == 0) { is_tiled = true; }
+    else if (strcmp(argv[i], "--raster") == 0) { is_raster = true; }
+    else if (num_args++ == 0) { num_cars = atoi(argv[i]); }
+    else { num_cycles = atoi(argv[i]); }
+  }
+  
+  // Load map the same way main does
+  const TestRawMap raw_map = LoadTestRawMap();
+  const double max_s = raw_map.max_s;
+  FrenetMap frenet_map;
+  if (is_tiled) {
+    BuildTestTiledFrenetMap(raw_map, &frenet_map);
+  }
+  else {
+    BuildTestFrenetMap(raw_map, &frenet_map);
+  }
+  frenet_map.SetRasterProjection(is_raster);
+  
+  // Spread simulated cars over the lanes ahead of the ego car
+  std::vector<BenchCar> cars;
+  for (int i = 0; i < num_cars; ++i) {
+    BenchCar car;
+    car.s = fmod(60. + i*400./num_cars + (i % 3)*7., max_s);
+    car.d = tgt_lane2tgt_d(1 + i % 3);
+    car.speed = 17. + (i % 5);
+    cars.push_back(car);
+  }
+  
+  EgoVehicle ego_car = EgoVehicle();
+  ego_car.SetID(-1);
+  DetectedVehicleTable detected_cars;
+  LaneIndex car_ids_by_lane;
+  OccupancyGrid occupancy_grid;
+  
+  std::vector<double> ego_start = GetHiResXY(100., tgt_lane2tgt_d(2),
+                                             frenet_map);
+  double ego_x = ego_start[0];
+  double ego_y = ego_start[1];
+  std::vector<double> path_x;
+  std::vector<double> path_y;
+  
+  int num_collisions = 0;
+  int num_dropped_trajs = 0; // cycles with new traj states dropped
+  int num_pruned_trajs = 0; // possible traj's with cost evals pruned early
+  double min_gap = std::numeric_limits<double>::max();
+  double total_us = 0.;
+  
+  for (int cycle = 0; cycle < num_cycles; ++cycle) {
+    
+    // Simulator drives the ego car along the front of its path
+    const int num_consumed = std::min(kBenchStepsPerCycle,
+                                      int(path_x.size()));
+    if (num_consumed > 0) {
+      ego_x = path_x[num_consumed-1];
+      ego_y = path_y[num_consumed-1];
+      path_x.erase(path_x.begin(), path_x.begin() + num_consumed);
+      path_y.erase(path_y.begin(), path_y.begin() + num_consumed);
+    }
+    
+    // Move traffic and check for collisions with the ego car
+    const VehState &ego_state = ego_car.GetState();
+    MoveBenchCars(ego_state, (cycle > 0), max_s, &cars);
+    std::vector<std::vector<double>> sensor_fusion;
+    for (int i = 0; i < int(cars.size()); ++i) {
+      const BenchCar &car = cars[i];
+      if ((cycle > 0)
+          && (std::abs(WrapRelS(car.s - ego_state.s, max_s))
+              < kBenchCollisionS)
+          && (std::abs(car.d - ego_state.d) < kBenchCollisionD)) {
+        num_collisions++;
+      }
+      const double t_fd = 0.1; // sec, finite difference time for car vel
+      std::vector<double> xy = GetHiResXY(car.s, car.d, frenet_map);
+      std::vector<double> xy_next = GetHiResXY(car.s + car.speed*t_fd, car.d,
+                                               frenet_map);
+      sensor_fusion.push_back({double(i), xy[0], xy[1],
+                               (xy_next[0] - xy[0])/t_fd,
+                               (xy_next[1] - xy[1])/t_fd, car.s, car.d});
+      min_gap = std::min(min_gap, Distance(ego_x, ego_y, xy[0], xy[1]));
+    }
+    
+    // Planning cycle, same steps as main
+    auto t_start = std::chrono::high_resolution_clock::now();
+    
+    frenet_map.EvictTiles();
+    GetCycleArena().Reset();
+    
+    const int idx_current_pt = GetCurrentTrajIndex(ego_car.GetTraj(),
+                                                   int(path_x.size()));
+    int ego_wp_hint = ego_car.GetWaypointHint();
+    VehState new_ego_state = ProcessEgoState(ego_x, ego_y, idx_current_pt,
+                                             ego_car.GetTraj(), frenet_map,
+                                             &ego_wp_hint);
+    ego_car.UpdateState(new_ego_state);
+    ego_car.SetWaypointHint(ego_wp_hint);
+    ProcessDetectedCars(ego_car, sensor_fusion, frenet_map, &detected_cars);
+    SortDetectedCarsByLane(ego_car, detected_cars, &car_ids_by_lane);
+    PredictBehavior(ego_car, car_ids_by_lane, frenet_map, &detected_cars);
+    
+    VehBehavior new_ego_beh;
+    new_ego_beh.tgt_lane = LaneCostFcn(ego_car, detected_cars,
+                                       car_ids_by_lane);
+    new_ego_beh.intent = BehaviorFSM(ego_car, detected_cars, car_ids_by_lane);
+    new_ego_beh.tgt_time = kNewPathTime;
+    new_ego_beh.tgt_speed = SetTargetSpeed(ego_car, detected_cars,
+                                           car_ids_by_lane);
+    ego_car.SetTgtBehavior(new_ego_beh);
+    
+    ego_car.TrimTrajToBuffer(idx_current_pt);
+    occupancy_grid.Update(ego_car, detected_cars, max_s);
+    int num_pruned_cycle;
+    VehTrajectory new_traj = GetEgoTrajectory(ego_car, detected_cars,
+                                              car_ids_by_lane, occupancy_grid,
+                                              frenet_map, &num_pruned_cycle);
+    num_pruned_trajs += num_pruned_cycle;
+    if (ego_car.AppendTraj(new_traj) < int(new_traj.states.size())) {
+      num_dropped_trajs++;
+    }
+    
+    auto t_end = std::chrono::high_resolution_clock::now();
+    total_us += std::chrono::duration<double, std::micro>(t_end - t_start)
+                .count();
+    
+    // Send new path to the simulated ego car
+    const TrajRingBuffer &ego_traj = ego_car.GetTraj();
+    path_x.clear();
+    path_y.clear();
+    for (int i = 0; i < ego_traj.Size(); ++i) {
+      path_x.push_back(ego_traj[i].x);
+      path_y.push_back(ego_traj[i].y);
+    }
+  }
+  
+  printf("cars=%d cycles=%d tiled=%d raster=%d ego_s=%.1f min_gap=%.2f m "
+         "avg_cycle=%.1f us pruned=%.1f%% collisions=%d dropped=%d\n",
+         num_cars, num_cycles, int(is_tiled), int(is_raster),
+         ego_car.GetState().s, min_gap, total_us / std::max(num_cycles, 1),
+         100. * num_pruned_trajs / std::max(num_cycles * kTrajGenNum, 1),
+         num_collisions, num_dropped_trajs);
+  
+  return ((num_collisions == 0) && (num_dropped_trajs == 0)) ? 0 : 1;
+}
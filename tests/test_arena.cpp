@@ -0,0 +1,159 @@
+//
+//  test_arena.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include <string.h>
+#include <new>
+#include "test_common.hpp"
+#include "arena.hpp"
+#include "vehicle.hpp"
+#include "sensor_fusion.hpp"
+#include "prediction.hpp"
+#include "trajectory.hpp"
+
+/**
+ * Count of global allocator calls, to check that steady state planning steps
+ * only draw from the cycle arena
+ */
+static int g_num_global_allocs = 0;
+
+void* operator new(size_t num_bytes) {
+  g_num_global_allocs++;
+  void *p = malloc(num_bytes);
+  if (p == NULL) { throw std::bad_alloc(); }
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+/**
+ * Check alignment of allocations, that they don't overlap, and that after a
+ * cycle that overflowed the first block the merged block holds the same
+ * cycle without adding blocks
+ */
+static void TestArenaBlocks() {
+  Arena arena(1024);
+  CHECK(arena.GetNumBlockAllocs() == 1);
+  
+  for (int cycle = 0; cycle < 4; ++cycle) {
+    char *ptrs[50];
+    size_t sizes[50];
+    for (int i = 0; i < 50; ++i) {
+      const size_t alignment = size_t(1) << (i % 5);
+      sizes[i] = 1 + (i * 37) % 200;
+      ptrs[i] = static_cast<char*>(arena.Allocate(sizes[i], alignment));
+      CHECK((reinterpret_cast<size_t>(ptrs[i]) & (alignment - 1)) == 0);
+      memset(ptrs[i], i, sizes[i]);
+    }
+    for (int i = 0; i < 50; ++i) {
+      for (size_t j = 0; j < sizes[i]; ++j) { CHECK(ptrs[i][j] == char(i)); }
+    }
+    
+    // Only the 1st cycle adds blocks, then one merged block is used
+    if (cycle == 0) { CHECK(arena.GetNumBlockAllocs() > 2); }
+    const int num_block_allocs = arena.GetNumBlockAllocs();
+    arena.Reset();
+    CHECK(arena.GetNumBytesUsed() == 0);
+    if (cycle > 0) { CHECK(arena.GetNumBlockAllocs() == num_block_allocs); }
+  }
+  
+  // Single allocation bigger than a block gets a block of its own
+  void *p_big = arena.Allocate(1 << 16, 8);
+  CHECK(p_big != NULL);
+  arena.Reset();
+}
+
+/**
+ * Check that arena vectors draw from the arena and default constructed ones
+ * from the global heap
+ */
+static void TestArenaVector() {
+  Arena arena(1 << 16);
+  const int num_allocs = g_num_global_allocs;
+  ArenaVector<double> arena_vec{ArenaAllocator<double>(&arena)};
+  for (int i = 0; i < 1000; ++i) { arena_vec.push_back(i); }
+  CHECK(g_num_global_allocs == num_allocs);
+  CHECK(arena.GetNumBytesUsed() >= 1000 * sizeof(double));
+  CHECK(arena_vec[999] == 999.);
+  
+  ArenaVector<double> heap_vec;
+  heap_vec.push_back(1.);
+  CHECK(g_num_global_allocs > num_allocs);
+}
+
+/**
+ * Check that after warm up cycles, processing the sensor fusion data,
+ * sorting the detected cars by lane, predicting their trajectories and
+ * generating and checking the ego car's candidate trajectories don't call
+ * the global allocator
+ */
+static void TestSteadyStateCycle() {
+  FrenetMap frenet_map;
+  BuildTestFrenetMap(LoadTestRawMap(), &frenet_map);
+  
+  EgoVehicle ego_car;
+  ego_car.SetID(-1);
+  VehState ego_state = {};
+  ego_state.s = 500.;
+  ego_state.s_dot = 20.;
+  ego_state.d = tgt_lane2tgt_d(2);
+  const std::vector<double> ego_xy = GetHiResXY(ego_state.s, ego_state.d,
+                                                frenet_map);
+  ego_state.x = ego_xy[0];
+  ego_state.y = ego_xy[1];
+  ego_car.UpdateState(ego_state);
+  
+  // Sensor fusion rows {id, x, y, vx, vy, s, d} for cars around the ego car
+  std::vector<std::vector<double>> sensor_fusion;
+  for (int veh_id = 0; veh_id < 12; ++veh_id) {
+    const double s = 450. + veh_id * 12.;
+    const double d = tgt_lane2tgt_d(1 + veh_id % 3);
+    const double speed = 15. + veh_id % 5;
+    const double t_fd = 0.1; // sec, finite difference time for car vel
+    const std::vector<double> xy = GetHiResXY(s, d, frenet_map);
+    const std::vector<double> xy_next = GetHiResXY(s + speed*t_fd, d,
+                                                   frenet_map);
+    sensor_fusion.push_back({double(veh_id), xy[0], xy[1],
+                             (xy_next[0] - xy[0])/t_fd,
+                             (xy_next[1] - xy[1])/t_fd, s, d});
+  }
+  
+  DetectedVehicleTable detected_cars;
+  LaneIndex car_ids_by_lane;
+  
+  const double v_tgts[4] = {18., 20., 22., 15.};
+  const double d_tgts[4] = {2., 6., 6., 10.};
+  for (int cycle = 0; cycle < 5; ++cycle) {
+    const int num_allocs = g_num_global_allocs;
+    GetCycleArena().Reset();
+    ProcessDetectedCars(ego_car, sensor_fusion, frenet_map, &detected_cars);
+    SortDetectedCarsByLane(ego_car, detected_cars, &car_ids_by_lane);
+    PredictBehavior(ego_car, car_ids_by_lane, frenet_map, &detected_cars);
+    ArenaVector<VehTrajectory> trajs = GetTrajectories(ego_state, 2.5, v_tgts,
+                                                       d_tgts, 4, kMaxA,
+                                                       frenet_map);
+    for (int k = 0; k < int(trajs.size()); ++k) {
+      double spd_adj_ratio;
+      double a_adj_ratio;
+      CheckTrajFeasibility(trajs[k], frenet_map, &spd_adj_ratio,
+                           &a_adj_ratio);
+      CHECK((spd_adj_ratio > 0.) && (spd_adj_ratio <= 1.));
+      CHECK((a_adj_ratio > 0.) && (a_adj_ratio <= 1.));
+    }
+    if (cycle >= 2) { CHECK(g_num_global_allocs == num_allocs); }
+  }
+  CHECK(detected_cars.Size() == 12);
+  GetCycleArena().Reset();
+}
+
+int main() {
+  TestArenaBlocks();
+  TestArenaVector();
+  TestSteadyStateCycle();
+  
+  return TestResult("test_arena");
+}
@@ -0,0 +1,363 @@
+//
+//  test_collision_risk.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include <algorithm>
+#include <limits>
+#include "test_common.hpp"
+#include "trajectory.hpp"
+
+static const double kTestMaxS = 6945.554; // m, track length of the test map
+
+/**
+ * JMT poly from a start position and speed to a random end state after t_end,
+ * with the end position near the one at constant speed
+ */
+static Poly<5> RandJMT(double y0, double y_dot, double y_end_dot,
+                       double t_end) {
+  const double start[3] = {y0, y_dot, TestRand(-3., 3.)};
+  const double end[3] = {y0 + 0.5 * (y_dot + y_end_dot) * t_end
+                         + TestRand(-3., 3.), y_end_dot, 0.};
+  return JMT(start, end, t_end);
+}
+
+/**
+ * Collision risk by densely sampling the gaps between the ego traj and the
+ * car's predicted traj with midpoint steps of about dt, wrapping the gap in s
+ * around the track at every step
+ */
+static double DenseCollisionRisk(const VehTrajectory &traj,
+                                 const PredTrajectory &car_traj,
+                                 double t_start, double t_begin, double t_end,
+                                 double max_s) {
+  const double dt_max = 1e-4;
+  const int num_steps = int(std::ceil((t_end - t_begin) / dt_max));
+  const double dt = (t_end - t_begin) / num_steps;
+  double risk = 0.;
+  for (int k = 0; k < num_steps; ++k) {
+    const double t = t_begin + (k + 0.5) * dt;
+    double gap_s = std::fmod(traj.poly_s.Eval(t)
+                             - car_traj.s.Eval(t_start + t), max_s);
+    if (gap_s > 0.5*max_s) { gap_s -= max_s; }
+    else if (gap_s < -0.5*max_s) { gap_s += max_s; }
+    const double gap_d = traj.poly_d.Eval(t) - car_traj.d.Eval(t_start + t);
+    if ((std::abs(gap_s) < kCollisionSThresh)
+        && (std::abs(gap_d) < kCollisionDThresh)) {
+      risk += exp(-t) * dt;
+    }
+  }
+  return risk;
+}
+
+/**
+ * Check that the analytic collision risk matches dense sampling over random
+ * ego and car JMT pairs in EvalTrajCost's time windows, including pairs that
+ * straddle the end of the track and windows that start after the traj does
+ */
+static void TestCollisionRiskVsDense() {
+  int num_risky = 0;
+  int num_risky_wrapped = 0;
+  int num_risky_late = 0;
+  
+  srand(14);
+  for (int i = 0; i < 1500; ++i) {
+    // Ego near the end of the track or either side of its start for some
+    // pairs, with the car's s wrapped into the track
+    double ego_s;
+    const int where = i % 3;
+    if (where == 0) { ego_s = TestRand(kTestMaxS - 40., kTestMaxS); }
+    else if (where == 1) { ego_s = TestRand(0., 20.); }
+    else { ego_s = TestRand(100., kTestMaxS - 100.); }
+    const double car_s = std::fmod(ego_s + TestRand(-25., 40.) + kTestMaxS,
+                                   kTestMaxS);
+    const bool is_wrapped = (std::abs(car_s - ego_s) > 0.5*kTestMaxS);
+    
+    // Car's predicted traj starts now and ego's new traj after its buffer
+    PredTrajectory car_traj;
+    const double t_pred = TestRand(1.5, 4.);
+    const double car_v = TestRand(5., 25.);
+    car_traj.s = RandJMT(car_s, car_v, car_v + TestRand(-4., 4.), t_pred);
+    const double car_d = TestRand(0., 12.);
+    car_traj.d = RandJMT(car_d, 0., 0., t_pred);
+    car_traj.t_end = t_pred;
+    car_traj.probability = 1.;
+    
+    const double t_start = TestRand(0., 1.);
+    VehTrajectory traj;
+    const double t_traj = TestRand(1., 3.5);
+    const double ego_v = TestRand(5., 25.);
+    traj.poly_s = RandJMT(std::fmod(ego_s + ego_v*t_start, kTestMaxS), ego_v,
+                          ego_v + TestRand(-4., 4.), t_traj);
+    traj.poly_d = RandJMT(car_d + TestRand(-6., 6.), 0., 0., t_traj);
+    
+    // Windows the way EvalTrajCost steps them
+    double t_window = kEvalRiskWindowTime;
+    for (double t_begin = 0.; t_begin < t_traj;
+         t_begin += t_window, t_window *= 2.) {
+      const double t_end = std::min(std::min(t_traj, t_begin + t_window),
+                                    car_traj.t_end - t_start);
+      if (t_end <= t_begin) { continue; }
+      
+      const double risk = GetCollisionRisk(traj, car_traj, t_start, t_begin,
+                                           t_end, kTestMaxS);
+      const double risk_dense = DenseCollisionRisk(traj, car_traj, t_start,
+                                                   t_begin, t_end, kTestMaxS);
+      CHECK_NEAR(risk, risk_dense, 2e-4);
+      if (risk > 0.) {
+        num_risky++;
+        if (is_wrapped) { num_risky_wrapped++; }
+        if (t_begin > 0.) { num_risky_late++; }
+      }
+    }
+  }
+  
+  CHECK(num_risky > 300);
+  CHECK(num_risky_wrapped > 40);
+  CHECK(num_risky_late > 100);
+}
+
+/**
+ * Random ego car with a prev path buffer (near the end of the track for every
+ * 4th scenario), and cars within sensor range of it, some off the road on
+ * either side, with predicted paths that may end before the new traj starts
+ */
+static void SetRandTraffic(int scenario, EgoVehicle *ego_car,
+                           DetectedVehicleTable *detected_cars) {
+  VehState ego_state = {};
+  ego_state.s = (scenario % 4 == 0) ? TestRand(kTestMaxS - 40., kTestMaxS)
+                                    : TestRand(0., kTestMaxS);
+  ego_state.d = TestRand(1., 11.);
+  ego_car->UpdateState(ego_state);
+  
+  // Prev path buffer sets the new traj's start time
+  VehTrajectory buffer_traj;
+  const int num_buffer = int(TestRand(0., 40.));
+  for (int i = 0; i < num_buffer; ++i) {
+    buffer_traj.states.push_back(ego_state);
+  }
+  ego_car->AppendTraj(buffer_traj);
+  
+  const int num_cars = int(TestRand(1., 25.));
+  for (int k = 0; k < num_cars; ++k) {
+    VehState car_state = {};
+    car_state.s = std::fmod(ego_state.s + TestRand(-90., 90.) + kTestMaxS,
+                            kTestMaxS);
+    car_state.d = TestRand(-4., 20.);
+    car_state.s_dot = TestRand(5., 25.);
+    const int idx = detected_cars->Insert(k);
+    detected_cars->UpdateCar(idx, car_state, -1, *ego_car, kTestMaxS);
+    
+    PredTrajectories pred_trajs;
+    pred_trajs.size = int(TestRand(1., 4.));
+    for (int i = 0; i < pred_trajs.size; ++i) {
+      const double t_pred = TestRand(0.5, 4.);
+      pred_trajs.intents[i] = kKeepLane;
+      pred_trajs.trajs[i].s = RandJMT(car_state.s, car_state.s_dot,
+                                      car_state.s_dot + TestRand(-4., 4.),
+                                      t_pred);
+      pred_trajs.trajs[i].d = RandJMT(car_state.d, 0., 0., t_pred);
+      pred_trajs.trajs[i].d.a[3] += TestRand(-1., 1.);
+      pred_trajs.trajs[i].t_end = t_pred;
+      pred_trajs.trajs[i].probability = 1.;
+    }
+    detected_cars->SetPredTrajs(idx, pred_trajs);
+  }
+}
+
+/**
+ * Random candidate traj for the ego car from the end of its prev path buffer
+ */
+static VehTrajectory RandCandidateTraj(const EgoVehicle &ego_car) {
+  const VehState &ego_state = ego_car.GetState();
+  const double t_start = ego_car.GetTraj().Size() * kSimCycleTime;
+  VehTrajectory traj;
+  const double t_traj = TestRand(1., 3.5);
+  traj.states.resize(int(t_traj / kSimCycleTime));
+  const double ego_v = TestRand(5., 25.);
+  const double ego_v_end = ego_v + TestRand(-4., 4.);
+  traj.poly_s = RandJMT(std::fmod(ego_state.s + ego_v*t_start, kTestMaxS),
+                        ego_v, ego_v_end, t_traj);
+  traj.poly_d = RandJMT(ego_state.d, 0., 0., t_traj);
+  traj.poly_d.a[3] += TestRand(-1., 1.);
+  traj.states.back().s_dot = ego_v_end;
+  return traj;
+}
+
+/**
+ * Check that culling by the predicted path envelopes never drops a car that
+ * has any collision risk with a candidate traj, over random tables of cars
+ * in and out of the indexed lanes (including around the end of the track),
+ * and that risky cars are found through the lanes and relative s the
+ * envelopes reach, and through the out-of-lanes bucket
+ */
+static void TestCullCarsNearTraj() {
+  int num_risky = 0;
+  int num_culled = 0;
+  int num_risky_other_lane = 0;
+  int num_risky_outside_window = 0;
+  int num_risky_out_of_lanes = 0;
+  
+  srand(15);
+  for (int scenario = 0; scenario < 300; ++scenario) {
+    GetCycleArena().Reset();
+    
+    EgoVehicle ego_car;
+    DetectedVehicleTable detected_cars;
+    SetRandTraffic(scenario, &ego_car, &detected_cars);
+    const double ego_s = ego_car.GetState().s;
+    const double t_start = ego_car.GetTraj().Size() * kSimCycleTime;
+    LaneIndex car_ids_by_lane;
+    car_ids_by_lane.Update(ego_car, detected_cars);
+    const PredEnvelopes pred_envelopes = GetPredEnvelopes(ego_car,
+                                                          detected_cars,
+                                                          kTestMaxS);
+    
+    // Several candidate trajs from the end of the buffer
+    for (int n = 0; n < 10; ++n) {
+      const VehTrajectory traj = RandCandidateTraj(ego_car);
+      
+      std::vector<int> idx_near_cars(detected_cars.Size());
+      const int num_near_cars = CullCarsNearTraj(traj, detected_cars,
+                                                 car_ids_by_lane,
+                                                 pred_envelopes,
+                                                 idx_near_cars.data());
+      idx_near_cars.resize(num_near_cars);
+      num_culled += detected_cars.Size() - num_near_cars;
+      
+      // Traj's lanes and relative s range at the start and end, for cars
+      // that can only be found through the envelopes' reach
+      double traj_rel_s[2];
+      int traj_lanes[2];
+      const double t_check = traj.states.size() * kSimCycleTime;
+      for (int j = 0; j < 2; ++j) {
+        const double t = j * t_check;
+        traj_rel_s[j] = std::fmod(traj.poly_s.Eval(t) - ego_s
+                                  + 1.5*kTestMaxS, kTestMaxS) - 0.5*kTestMaxS;
+        traj_lanes[j] = int(std::ceil(traj.poly_d.Eval(t) / kLaneWidth));
+      }
+      
+      for (int idx = 0; idx < detected_cars.Size(); ++idx) {
+        const PredTrajectories &pred_trajs = detected_cars.GetCar(idx)
+                                               .GetPredTrajs();
+        double risk = 0.;
+        for (int i = 0; i < pred_trajs.size; ++i) {
+          const PredTrajectory &car_traj = pred_trajs.trajs[i];
+          double t_window = kEvalRiskWindowTime;
+          for (double t_begin = 0.; t_begin < t_check;
+               t_begin += t_window, t_window *= 2.) {
+            const double t_end = std::min(std::min(t_check,
+                                                   t_begin + t_window),
+                                          car_traj.t_end - t_start);
+            if (t_end <= t_begin) { continue; }
+            risk += GetCollisionRisk(traj, car_traj, t_start, t_begin, t_end,
+                                     kTestMaxS);
+          }
+        }
+        if (risk == 0.) { continue; }
+        
+        num_risky++;
+        CHECK(std::find(idx_near_cars.begin(), idx_near_cars.end(), idx)
+              != idx_near_cars.end());
+        const int car_lane = detected_cars.GetLane(idx);
+        const double car_rel_s = detected_cars.GetRelS(idx);
+        if ((car_lane != traj_lanes[0]) && (car_lane != traj_lanes[1])) {
+          num_risky_other_lane++;
+        }
+        if ((car_rel_s > std::max(traj_rel_s[0], traj_rel_s[1])
+                         + kCollisionSThresh)
+            || (car_rel_s < std::min(traj_rel_s[0], traj_rel_s[1])
+                            - kCollisionSThresh)) {
+          num_risky_outside_window++;
+        }
+        if (car_lane >= car_ids_by_lane.GetNumLanes()) {
+          num_risky_out_of_lanes++;
+        }
+      }
+    }
+  }
+  GetCycleArena().Reset();
+  
+  CHECK(num_risky > 0);
+  CHECK(num_culled > 0);
+  CHECK(num_risky_other_lane > 0);
+  CHECK(num_risky_outside_window > 0);
+  CHECK(num_risky_out_of_lanes > 0);
+}
+
+/**
+ * Check that a traj cost evaluation that isn't pruned by the cost bound gets
+ * the same cost as with no bound, and one that is pruned has a full cost
+ * over the bound (and a partial cost over the bound but not over the full
+ * cost), for bounds around each candidate traj's full cost
+ */
+static void TestEvalTrajCostPruning() {
+  int num_pruned = 0;
+  int num_not_pruned = 0;
+  
+  srand(16);
+  for (int scenario = 0; scenario < 300; ++scenario) {
+    GetCycleArena().Reset();
+    
+    EgoVehicle ego_car;
+    DetectedVehicleTable detected_cars;
+    SetRandTraffic(scenario, &ego_car, &detected_cars);
+    VehBehavior ego_beh = {};
+    ego_beh.intent = kKeepLane;
+    ego_beh.tgt_speed = TestRand(10., 22.);
+    ego_beh.tgt_time = TestRand(1.5, 3.);
+    ego_car.SetTgtBehavior(ego_beh);
+    LaneIndex car_ids_by_lane;
+    car_ids_by_lane.Update(ego_car, detected_cars);
+    const PredEnvelopes pred_envelopes = GetPredEnvelopes(ego_car,
+                                                          detected_cars,
+                                                          kTestMaxS);
+    OccupancyGrid occupancy_grid;
+    occupancy_grid.Update(ego_car, detected_cars, kTestMaxS);
+    
+    for (int n = 0; n < 10; ++n) {
+      const VehTrajectory traj = RandCandidateTraj(ego_car);
+      bool is_pruned;
+      const double cost_full = EvalTrajCost(traj, ego_car, detected_cars,
+                                            car_ids_by_lane, pred_envelopes,
+                                            occupancy_grid,
+                                            std::numeric_limits<double>::max(),
+                                            &is_pruned);
+      CHECK(is_pruned == false);
+      
+      for (int k = 0; k < 4; ++k) {
+        const double cost_bound = ((k < 3) ? cost_full * TestRand(0., 2.)
+                                           : kTrajCostThresh);
+        const double cost = EvalTrajCost(traj, ego_car, detected_cars,
+                                         car_ids_by_lane, pred_envelopes,
+                                         occupancy_grid, cost_bound,
+                                         &is_pruned);
+        if (is_pruned) {
+          num_pruned++;
+          CHECK(cost_full > cost_bound);
+          CHECK(cost > cost_bound);
+          CHECK(cost <= cost_full);
+        }
+        else {
+          num_not_pruned++;
+          CHECK(cost == cost_full);
+          CHECK(cost <= cost_bound);
+        }
+      }
+    }
+  }
+  GetCycleArena().Reset();
+  
+  CHECK(num_pruned > 0);
+  CHECK(num_not_pruned > 0);
+}
+
+int main() {
+  TestCollisionRiskVsDense();
+  TestCullCarsNearTraj();
+  TestEvalTrajCostPruning();
+  
+  return TestResult("test_collision_risk");
+}
@@ -0,0 +1,123 @@
+//
+//  test_common.hpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#ifndef test_common_hpp
+#define test_common_hpp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include "path_common.hpp"
+#include "frenet_map.hpp"
+
+/**
+ * Minimal checks for the unit test programs.  Failed checks are printed with
+ * their location and counted, and each test program returns TestResult() as
+ * its exit code so ctest reports it.
+ */
+inline int& TestFailures() {
+  static int num_failures = 0;
+  return num_failures;
+}
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      TestFailures()++; \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+    } \
+  } while (0)
+
+#define CHECK_NEAR(a, b, tol) \
+  do { \
+    const double check_a = (a); \
+    const double check_b = (b); \
+    if (!(std::abs(check_a - check_b) <= (tol))) { \
+      TestFailures()++; \
+      printf("%s:%d: CHECK_NEAR(%s, %s) failed: %.9g vs %.9g\n", __FILE__, \
+             __LINE__, #a, #b, check_a, check_b); \
+    } \
+  } while (0)
+
+inline int TestResult(const char *test_name) {
+  printf("%s: %s (%d failed checks)\n", test_name,
+         (TestFailures() == 0) ? "PASSED" : "FAILED", TestFailures());
+  return (TestFailures() == 0) ? 0 : 1;
+}
+
+/**
+ * Raw map waypoints (x,y,s,dx,dy) of the project's highway map, with the byte
+ * offset of each one's row in the map file
+ */
+struct TestRawMap {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> s;
+  std::vector<double> dx;
+  std::vector<double> dy;
+  std::vector<int64_t> row_offset;
+  double max_s;
+};
+
+inline TestRawMap LoadTestRawMap() {
+  TestRawMap raw_map;
+  std::ifstream in_map(TEST_MAP_FILE, std::ifstream::in);
+  std::string line;
+  int64_t row_offset = in_map.tellg();
+  while (getline(in_map, line)) {
+    std::istringstream iss(line);
+    double x;
+    double y;
+    float s;
+    float d_x;
+    float d_y;
+    iss >> x >> y >> s >> d_x >> d_y;
+    raw_map.x.push_back(x);
+    raw_map.y.push_back(y);
+    raw_map.s.push_back(s);
+    raw_map.dx.push_back(d_x);
+    raw_map.dy.push_back(d_y);
+    raw_map.row_offset.push_back(row_offset);
+    row_offset = in_map.tellg();
+  }
+  raw_map.max_s = GetTrackLength(raw_map.s, raw_map.x, raw_map.y);
+  return raw_map;
+}
+
+/**
+ * Build the flat Frenet map of the highway map the same way main does
+ */
+inline void BuildTestFrenetMap(const TestRawMap &raw_map,
+                               FrenetMap *frenet_map) {
+  auto waypts_interp = InterpolateMap(raw_map.s, raw_map.x, raw_map.y,
+                                      raw_map.dx, raw_map.dy, kMapInterpInc,
+                                      raw_map.max_s);
+  BuildFrenetMap(waypts_interp, kMapInterpInc, raw_map.max_s,
+                 kMapGridCellSize, frenet_map);
+}
+
+/**
+ * Build a tiled Frenet map of the highway map, the way main does for a map
+ * longer than kMapMaxFlatLength
+ */
+inline void BuildTestTiledFrenetMap(const TestRawMap &raw_map,
+                                    FrenetMap *frenet_map) {
+  BuildTiledFrenetMap(TEST_MAP_FILE, raw_map.s, raw_map.x, raw_map.y,
+                      raw_map.row_offset, kMapInterpInc, raw_map.max_s,
+                      frenet_map);
+}
+
+/**
+ * Uniform random number in [lo, hi) from a fixed seed sequence
+ */
+inline double TestRand(double lo, double hi) {
+  return lo + (hi - lo) * (rand() / (RAND_MAX + 1.0));
+}
+
+#endif /* test_common_hpp */
@@ -0,0 +1,174 @@
+//
+//  test_frenet_projection.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include "test_common.hpp"
+
+/**
+ * Check that (s,d) -> (x,y) -> (s,d) round trips on both sides of the road
+ * (signed d), and that the projection does not depend on the waypoint hint it
+ * is warm-started from
+ */
+static void TestRoundTripAndHints(const FrenetMap &frenet_map) {
+  const int num_wps = frenet_map.GetNumWaypoints();
+  srand(2);
+  for (int i = 0; i < 20000; ++i) {
+    const double s = TestRand(5., frenet_map.GetMaxS() - 5.);
+    const double d = TestRand(-11.5, 11.5);
+    const std::vector<double> xy = GetHiResXY(s, d, frenet_map);
+    
+    int no_hint = -1;
+    const FrenetProjection proj = GetHiResFrenet(xy[0], xy[1], 0., 0.,
+                                                 frenet_map, &no_hint);
+    CHECK_NEAR(proj.s, s, 0.05);
+    CHECK_NEAR(proj.d, d, 0.01);
+    CHECK((no_hint >= 0) && (no_hint < num_wps));
+    
+    int hint = (no_hint + int(TestRand(-10., 11.)) + num_wps) % num_wps;
+    const FrenetProjection proj_hint = GetHiResFrenet(xy[0], xy[1], 0., 0.,
+                                                      frenet_map, &hint);
+    CHECK(proj_hint.s == proj.s);
+    CHECK(proj_hint.d == proj.d);
+    CHECK(hint == no_hint);
+  }
+}
+
+/**
+ * Check that velocity along the road tangent and normal is split into s_dot
+ * and d_dot
+ */
+static void TestVelocityProjection(const FrenetMap &frenet_map) {
+  srand(3);
+  for (int i = 0; i < 1000; ++i) {
+    const double s = TestRand(5., frenet_map.GetMaxS() - 5.);
+    const double d = TestRand(0.5, 11.5);
+    const std::vector<double> xy = GetHiResXY(s, d, frenet_map);
+    int hint = -1;
+    const FrenetProjection proj = GetHiResFrenet(xy[0], xy[1], 0., 0.,
+                                                 frenet_map, &hint);
+    const double v_s = TestRand(0., 25.);
+    const double v_d = TestRand(-3., 3.);
+    const double vx = v_s * proj.tan_x + v_d * proj.norm_x;
+    const double vy = v_s * proj.tan_y + v_d * proj.norm_y;
+    const FrenetProjection proj_v = GetHiResFrenet(xy[0], xy[1], vx, vy,
+                                                   frenet_map, &hint);
+    CHECK_NEAR(proj_v.s_dot, v_s, 1e-9);
+    CHECK_NEAR(proj_v.d_dot, v_d, 1e-9);
+  }
+}
+
+/**
+ * Check that batch transforms (vectorized blocks, and chunks over the thread
+ * pool for large batches) match single point transforms
+ */
+static void TestBatch(const FrenetMap &frenet_map, int num_pts) {
+  srand(4);
+  std::vector<double> pts_x(num_pts);
+  std::vector<double> pts_y(num_pts);
+  std::vector<double> pts_vx(num_pts);
+  std::vector<double> pts_vy(num_pts);
+  std::vector<int> wp_hints(num_pts, -1);
+  for (int i = 0; i < num_pts; ++i) {
+    const double s = TestRand(0., frenet_map.GetMaxS());
+    const std::vector<double> xy = GetHiResXY(s, TestRand(-11.5, 11.5),
+                                              frenet_map);
+    pts_x[i] = xy[0];
+    pts_y[i] = xy[1];
+    pts_vx[i] = TestRand(-25., 25.);
+    pts_vy[i] = TestRand(-25., 25.);
+  }
+  std::vector<double> pts_s(num_pts);
+  std::vector<double> pts_d(num_pts);
+  std::vector<double> pts_s_dot(num_pts);
+  std::vector<double> pts_d_dot(num_pts);
+  GetHiResFrenetBatch(pts_x.data(), pts_y.data(), pts_vx.data(),
+                      pts_vy.data(), num_pts, frenet_map, wp_hints.data(),
+                      pts_s.data(), pts_d.data(), pts_s_dot.data(),
+                      pts_d_dot.data());
+  
+  for (int i = 0; i < num_pts; ++i) {
+    int hint = -1;
+    const FrenetProjection proj = GetHiResFrenet(pts_x[i], pts_y[i],
+                                                 pts_vx[i], pts_vy[i],
+                                                 frenet_map, &hint);
+    CHECK(wp_hints[i] == hint);
+    CHECK_NEAR(pts_s[i], proj.s, 1e-9);
+    CHECK_NEAR(pts_d[i], proj.d, 1e-9);
+    CHECK_NEAR(pts_s_dot[i], proj.s_dot, 1e-9);
+    CHECK_NEAR(pts_d_dot[i], proj.d_dot, 1e-9);
+  }
+}
+
+/**
+ * Check that batch (s,d) -> (x,y) (vectorized blocks with a scalar remainder)
+ * matches single point conversions, including s outside of the track
+ */
+static void TestXYBatch(const FrenetMap &frenet_map, int num_pts) {
+  srand(5);
+  const double max_s = frenet_map.GetMaxS();
+  std::vector<double> pts_s(num_pts);
+  std::vector<double> pts_d(num_pts);
+  for (int i = 0; i < num_pts; ++i) {
+    pts_s[i] = TestRand(-0.1*max_s, 1.1*max_s);
+    pts_d[i] = TestRand(-11.5, 11.5);
+  }
+  std::vector<double> pts_x(num_pts);
+  std::vector<double> pts_y(num_pts);
+  GetHiResXYBatch(pts_s.data(), pts_d.data(), num_pts, frenet_map,
+                  pts_x.data(), pts_y.data());
+  
+  for (int i = 0; i < num_pts; ++i) {
+    const std::vector<double> xy = GetHiResXY(pts_s[i], pts_d[i], frenet_map);
+    CHECK_NEAR(pts_x[i], xy[0], 1e-9);
+    CHECK_NEAR(pts_y[i], xy[1], 1e-9);
+  }
+}
+
+/**
+ * Check that the vectorized range cull finds the same points, in order, as
+ * checking each point's distance
+ */
+static void TestCullPointsInRange(int num_pts) {
+  srand(6);
+  std::vector<double> pts_x(num_pts);
+  std::vector<double> pts_y(num_pts);
+  std::vector<int> idx_in_range(num_pts);
+  for (int k = 0; k < 200; ++k) {
+    for (int i = 0; i < num_pts; ++i) {
+      pts_x[i] = TestRand(-150., 150.);
+      pts_y[i] = TestRand(-150., 150.);
+    }
+    const double x = TestRand(-50., 50.);
+    const double y = TestRand(-50., 50.);
+    const int num_in_range = CullPointsInRange(pts_x.data(), pts_y.data(),
+                                               num_pts, x, y, kSensorRange,
+                                               idx_in_range.data());
+    int num_ref = 0;
+    for (int i = 0; i < num_pts; ++i) {
+      if (Distance(x, y, pts_x[i], pts_y[i]) < kSensorRange) {
+        CHECK((num_ref < num_in_range) && (idx_in_range[num_ref] == i));
+        num_ref++;
+      }
+    }
+    CHECK(num_in_range == num_ref);
+  }
+}
+
+int main() {
+  const TestRawMap raw_map = LoadTestRawMap();
+  FrenetMap frenet_map;
+  BuildTestFrenetMap(raw_map, &frenet_map);
+  
+  TestRoundTripAndHints(frenet_map);
+  TestVelocityProjection(frenet_map);
+  TestBatch(frenet_map, 13);
+  TestBatch(frenet_map, 20 * kFrenetBatchMinPerThread + 7);
+  TestXYBatch(frenet_map, 3 * kXYBatchBlockSize + 7);
+  TestCullPointsInRange(13);
+  TestCullPointsInRange(64);
+  
+  return TestResult("test_frenet_projection");
+}
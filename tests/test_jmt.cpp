@@ -0,0 +1,80 @@
+//
+//  test_jmt.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include "test_common.hpp"
+#include "Eigen-3.3/Eigen/Dense"
+
+/**
+ * JMT coefficients a3-a5 by solving the end state equations as a linear
+ * system, the way JMT did before its closed form solution
+ */
+static void SolveJMTReference(const double *start, const double *end,
+                              double t_end, double *a) {
+  const double t2 = t_end * t_end;
+  const double t3 = t2 * t_end;
+  const double t4 = t3 * t_end;
+  const double t5 = t4 * t_end;
+  Eigen::Matrix3d A;
+  A <<    t3,     t4,     t5,
+       3.*t2,  4.*t3,  5.*t4,
+       6.*t_end, 12.*t2, 20.*t3;
+  Eigen::Vector3d b;
+  b << end[0] - (start[0] + start[1]*t_end + 0.5*start[2]*t2),
+       end[1] - (start[1] + start[2]*t_end),
+       end[2] - start[2];
+  const Eigen::Vector3d x = A.colPivHouseholderQr().solve(b);
+  a[0] = start[0];
+  a[1] = start[1];
+  a[2] = 0.5 * start[2];
+  a[3] = x(0);
+  a[4] = x(1);
+  a[5] = x(2);
+}
+
+/**
+ * Check that the closed form JMT matches the start and end states and the
+ * linear system solution, for states and durations in the planner's ranges
+ */
+static void TestJMT() {
+  srand(6);
+  for (int i = 0; i < 10000; ++i) {
+    const double start[3] = {TestRand(0., 7000.), TestRand(0., 25.),
+                             TestRand(-10., 10.)};
+    const double t_end = TestRand(0.5, 10.);
+    const double end[3] = {start[0] + TestRand(0., 25.) * t_end,
+                           TestRand(0., 25.), TestRand(-10., 10.)};
+    
+    const Poly<5> poly = JMT(start, end, t_end);
+    
+    double y;
+    double y_dot;
+    double y_dotdot;
+    poly.EvalDerivs(0., &y, &y_dot, &y_dotdot);
+    CHECK(y == start[0]);
+    CHECK(y_dot == start[1]);
+    CHECK(y_dotdot == start[2]);
+    poly.EvalDerivs(t_end, &y, &y_dot, &y_dotdot);
+    CHECK_NEAR(y, end[0], 1e-6);
+    CHECK_NEAR(y_dot, end[1], 1e-7);
+    CHECK_NEAR(y_dotdot, end[2], 1e-7);
+    
+    double a_ref[6];
+    SolveJMTReference(start, end, t_end, a_ref);
+    double t_pow = 1.;
+    for (int k = 0; k <= 5; ++k) {
+      // Compare each term's contribution at t_end
+      CHECK_NEAR(poly.a[k] * t_pow, a_ref[k] * t_pow, 1e-6);
+      t_pow *= t_end;
+    }
+  }
+}
+
+int main() {
+  TestJMT();
+  
+  return TestResult("test_jmt");
+}
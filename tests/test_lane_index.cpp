@@ -0,0 +1,186 @@
+//
+//  test_lane_index.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include "test_common.hpp"
+#include "vehicle.hpp"
+
+/**
+ * Car ID's of each lane sorted by relative s from the ego car (higher s_rel
+ * first), the way the lanes were sorted before the lane index
+ */
+static std::map<int, std::vector<int>> BaselineSortByLane(
+                                    const DetectedVehicleTable &detected_cars) {
+  std::map<int, std::vector<int>> car_ids_by_lane;
+  for (int idx = 0; idx < detected_cars.Size(); ++idx) {
+    car_ids_by_lane[detected_cars.GetLane(idx)].push_back(
+                                                    detected_cars.GetID(idx));
+  }
+  for (auto it = car_ids_by_lane.begin(); it != car_ids_by_lane.end(); ++it) {
+    std::sort(it->second.begin(), it->second.end(),
+              [&detected_cars](int lhs, int rhs) -> bool {
+                return (detected_cars.At(lhs).GetRelS()
+                        > detected_cars.At(rhs).GetRelS());
+              });
+  }
+  return car_ids_by_lane;
+}
+
+/**
+ * Closest car ahead/behind by scanning all cars in the check lane and the ego
+ * car, the way FindCarInLane searched before the lane index
+ */
+static std::tuple<int, double> BaselineFindCarInLane(VehSides check_side,
+                        int check_lane, int check_id,
+                        const EgoVehicle &ego_car,
+                        const DetectedVehicleTable &detected_cars) {
+  int car_id_found = check_id;
+  double s_rel_found = (check_side == kFront) ? kSensorRange : -kSensorRange;
+  const double ref_s_rel = ((check_id != ego_car.GetID())
+                            ? detected_cars.At(check_id).GetRelS() : 0.);
+  for (int idx = 0; idx <= detected_cars.Size(); ++idx) {
+    int cur_car_id;
+    double cur_s_rel;
+    if (idx < detected_cars.Size()) {
+      if (detected_cars.GetLane(idx) != check_lane) { continue; }
+      cur_car_id = detected_cars.GetID(idx);
+      cur_s_rel = detected_cars.GetRelS(idx);
+    }
+    else {
+      if ((check_id == ego_car.GetID())
+          || (check_lane != ego_car.GetLane())) {
+        continue;
+      }
+      cur_car_id = ego_car.GetID();
+      cur_s_rel = 0.;
+    }
+    if (cur_car_id == check_id) { continue; }
+    const double cur_dist = cur_s_rel - ref_s_rel;
+    if (((check_side == kFront)
+           && (cur_dist > 0.) && (cur_dist < s_rel_found))
+        || ((check_side == kBack)
+              && (cur_dist < 0.) && (cur_dist > s_rel_found))) {
+      s_rel_found = cur_dist;
+      car_id_found = cur_car_id;
+    }
+  }
+  return std::make_tuple(car_id_found, s_rel_found);
+}
+
+/**
+ * Check the lane index against the baseline sorting and scans: each indexed
+ * lane's cars, the out-of-lanes bucket, empty views for lanes beyond the
+ * indexed lanes, and FindCarInLane for every car and the ego car
+ */
+static void CheckLaneIndex(const EgoVehicle &ego_car,
+                           const DetectedVehicleTable &detected_cars,
+                           const LaneIndex &car_ids_by_lane) {
+  
+  std::map<int, std::vector<int>> baseline = BaselineSortByLane(
+                                                              detected_cars);
+  const int num_lanes = car_ids_by_lane.GetNumLanes();
+  for (int lane = 0; lane < num_lanes; ++lane) {
+    const LaneCarsView lane_cars = car_ids_by_lane.GetLaneCars(lane);
+    const std::vector<int> &baseline_ids = baseline[lane];
+    CHECK(lane_cars.size == int(baseline_ids.size()));
+    for (int i = 0; (i < lane_cars.size) && (i < int(baseline_ids.size()));
+         ++i) {
+      CHECK(lane_cars[i].id == baseline_ids[i]);
+      CHECK(lane_cars[i].rel_s == detected_cars.At(baseline_ids[i]).GetRelS());
+    }
+  }
+  
+  // Out-of-lanes bucket has the cars of all other lanes, sorted
+  const LaneCarsView out_cars = car_ids_by_lane.GetOutOfLanesCars();
+  int num_out_cars = 0;
+  for (auto it = baseline.begin(); it != baseline.end(); ++it) {
+    if (it->first >= num_lanes) { num_out_cars += it->second.size(); }
+  }
+  CHECK(out_cars.size == num_out_cars);
+  for (int i = 0; i < out_cars.size; ++i) {
+    CHECK(detected_cars.At(out_cars[i].id).GetLane() >= num_lanes);
+    CHECK((i == 0) || (out_cars[i-1].rel_s >= out_cars[i].rel_s));
+  }
+  for (int lane = num_lanes; lane < num_lanes + 5; ++lane) {
+    CHECK(car_ids_by_lane.GetLaneCars(lane).size == 0);
+  }
+  CHECK(car_ids_by_lane.GetLaneCars(-1).size == 0);
+  
+  // Neighbor lookups and scans match the baseline scan
+  for (int idx = -1; idx < detected_cars.Size(); ++idx) {
+    const int check_id = (idx < 0) ? ego_car.GetID()
+                                   : detected_cars.GetID(idx);
+    const int lane = (idx < 0) ? ego_car.GetLane()
+                               : detected_cars.GetLane(idx);
+    const int min_lane = (idx < 0) ? 0 : lane - 1;
+    const int max_lane = (idx < 0) ? num_lanes + 3 : lane + 1;
+    for (int check_lane = min_lane; check_lane <= max_lane; ++check_lane) {
+      for (int side = 0; side < 2; ++side) {
+        const VehSides check_side = (side == 0) ? kFront : kBack;
+        const std::tuple<int, double> found = FindCarInLane(check_side,
+            check_lane, check_id, ego_car, detected_cars, car_ids_by_lane);
+        const std::tuple<int, double> expected = BaselineFindCarInLane(
+            check_side, check_lane, check_id, ego_car, detected_cars);
+        CHECK(std::get<0>(found) == std::get<0>(expected));
+        CHECK(std::get<1>(found) == std::get<1>(expected));
+      }
+    }
+  }
+}
+
+/**
+ * Update the lane index over cycles of cars moving, changing lanes (including
+ * to and from lanes beyond the indexed lanes), leaving and entering
+ */
+static void TestLaneIndexUpdates() {
+  const double max_s = 6945.554;
+  EgoVehicle ego_car;
+  ego_car.SetID(-1);
+  VehState ego_state = {};
+  ego_state.s = 3000.;
+  ego_state.d = tgt_lane2tgt_d(2);
+  ego_car.UpdateState(ego_state);
+  
+  DetectedVehicleTable detected_cars;
+  LaneIndex car_ids_by_lane;
+  
+  srand(10);
+  for (int cycle = 0; cycle < 300; ++cycle) {
+    for (int veh_id = 0; veh_id < 40; ++veh_id) {
+      const double op = TestRand(0., 1.);
+      if (op < 0.05) {
+        detected_cars.Erase(veh_id);
+        continue;
+      }
+      if (!detected_cars.Contains(veh_id) && (op > 0.3)) { continue; }
+      
+      // New cars anywhere, existing cars move a bit and sometimes jump lanes
+      const int idx = detected_cars.Insert(veh_id);
+      VehState state = detected_cars.GetCar(idx).GetState();
+      if ((cycle == 0) || (op < 0.1) || (state.s == 0.)) {
+        state.s = ego_state.s + TestRand(-150., 150.);
+        state.d = TestRand(-1., 34.);
+      }
+      else {
+        state.s += TestRand(-3., 3.);
+        state.d += TestRand(-0.5, 0.5);
+      }
+      state.s_dot = TestRand(10., 25.);
+      detected_cars.UpdateCar(idx, state, -1, ego_car, max_s);
+    }
+    car_ids_by_lane.Update(ego_car, detected_cars);
+    CheckLaneIndex(ego_car, detected_cars, car_ids_by_lane);
+  }
+}
+
+int main() {
+  TestLaneIndexUpdates();
+  
+  return TestResult("test_lane_index");
+}
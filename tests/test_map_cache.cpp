@@ -0,0 +1,126 @@
+//
+//  test_map_cache.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include <string.h>
+#include "test_common.hpp"
+#include "map_cache.hpp"
+
+/**
+ * Write a copy of a map cache file with the int32 at byte offset set to value
+ */
+static void WriteCorruptCache(const std::vector<char> &cache_bytes,
+                              int64_t offset, int32_t value,
+                              const std::string &corrupt_file) {
+  std::vector<char> bytes = cache_bytes;
+  memcpy(&bytes[offset], &value, sizeof(value));
+  FILE *fp = fopen(corrupt_file.c_str(), "wb");
+  fwrite(bytes.data(), 1, bytes.size(), fp);
+  fclose(fp);
+}
+
+/**
+ * Check that a written map cache loads back to the same map, and that stale
+ * or corrupted caches are rejected so the caller falls back to the raw map
+ */
+static void TestMapCache(const FrenetMap &frenet_map) {
+  const std::string cache_file = "test_map_cache.bin";
+  const std::string corrupt_file = "test_map_cache_corrupt.bin";
+  const std::string map_file = TEST_MAP_FILE;
+  const MapSourceStamp src_stamp = {1234, 5678};
+  CHECK(WriteMapCache(cache_file, src_stamp, frenet_map));
+  
+  // Cache loads back to the same arrays and grid search results
+  FrenetMap cached_map;
+  CHECK(LoadMapCache(cache_file, map_file, src_stamp, &cached_map));
+  const int num_wps = frenet_map.GetNumWaypoints();
+  CHECK(cached_map.GetNumWaypoints() == num_wps);
+  CHECK(cached_map.GetMaxS() == frenet_map.GetMaxS());
+  for (int i = 0; i < kNumMapArrays; ++i) {
+    const double *flat = frenet_map.GetFlatArray(MapArray(i));
+    const double *cached = cached_map.GetFlatArray(MapArray(i));
+    CHECK(memcmp(flat, cached, num_wps * sizeof(double)) == 0);
+  }
+  srand(5);
+  for (int i = 0; i < 1000; ++i) {
+    const double x = TestRand(0., 2500.);
+    const double y = TestRand(1000., 3200.);
+    CHECK(ClosestWaypoint(x, y, cached_map)
+          == ClosestWaypoint(x, y, frenet_map));
+    CHECK(RasterWaypoint(x, y, cached_map)
+          == RasterWaypoint(x, y, frenet_map));
+  }
+  
+  // Stale and missing caches are rejected
+  FrenetMap stale_map;
+  const MapSourceStamp new_stamp = {1234, 5679};
+  CHECK(!LoadMapCache(cache_file, map_file, new_stamp, &stale_map));
+  CHECK(!LoadMapCache("no_such_map_cache.bin", map_file, src_stamp,
+                      &stale_map));
+  
+  // Out of range indices are rejected
+  std::vector<char> cache_bytes;
+  FILE *fp = fopen(cache_file.c_str(), "rb");
+  char buf[4096];
+  size_t num_read;
+  while ((num_read = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    cache_bytes.insert(cache_bytes.end(), buf, buf + num_read);
+  }
+  fclose(fp);
+  MapCacheHeader header;
+  memcpy(&header, cache_bytes.data(), sizeof(header));
+  const int64_t num_cells = int64_t(header.grid_num_cols)
+                            * header.grid_num_rows;
+  const int64_t num_raster_blocks = int64_t(header.raster_num_block_cols)
+                                    * header.raster_num_block_rows;
+  const int64_t cell_start_offset = (int64_t(sizeof(MapCacheHeader))
+                                     + kNumMapArrays * int64_t(num_wps)
+                                       * sizeof(double));
+  const int64_t cell_wps_offset = cell_start_offset + (num_cells + 1) * 4;
+  const int64_t block_slots_offset = (cell_wps_offset
+                                      + header.num_cell_wps * 4);
+  const int64_t raster_cell_offset = (block_slots_offset
+                                      + num_raster_blocks * 4);
+  
+  const int64_t bad_offsets[] = {
+    cell_start_offset + (num_cells / 2) * 4,
+    cell_wps_offset + (header.num_cell_wps / 2) * 4,
+    block_slots_offset + (num_raster_blocks / 2) * 4,
+    raster_cell_offset,
+  };
+  const int32_t bad_values[] = {
+    1 << 30,
+    num_wps,
+    header.raster_num_slots,
+    num_wps + 5,
+  };
+  for (int i = 0; i < 4; ++i) {
+    WriteCorruptCache(cache_bytes, bad_offsets[i], bad_values[i],
+                      corrupt_file);
+    FrenetMap corrupt_map;
+    CHECK(!LoadMapCache(corrupt_file, map_file, src_stamp, &corrupt_map));
+  }
+  
+  // Unchanged copy still loads
+  WriteCorruptCache(cache_bytes, raster_cell_offset,
+                    *reinterpret_cast<const int32_t*>(&cache_bytes[
+                        raster_cell_offset]), corrupt_file);
+  FrenetMap copy_map;
+  CHECK(LoadMapCache(corrupt_file, map_file, src_stamp, &copy_map));
+  
+  remove(cache_file.c_str());
+  remove(corrupt_file.c_str());
+}
+
+int main() {
+  const TestRawMap raw_map = LoadTestRawMap();
+  FrenetMap frenet_map;
+  BuildTestFrenetMap(raw_map, &frenet_map);
+  
+  TestMapCache(frenet_map);
+  
+  return TestResult("test_map_cache");
+}
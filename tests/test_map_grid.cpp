@@ -0,0 +1,96 @@
+//
+//  test_map_grid.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include "test_common.hpp"
+
+/**
+ * Check that the map grid index holds every point in exactly one cell, the
+ * cell containing it
+ */
+static void TestGridCells() {
+  std::vector<double> pts_x;
+  std::vector<double> pts_y;
+  srand(1);
+  for (int i = 0; i < 500; ++i) {
+    pts_x.push_back(TestRand(-50., 150.));
+    pts_y.push_back(TestRand(20., 80.));
+  }
+  std::vector<int> cell_start;
+  std::vector<int> cell_pts;
+  const MapGrid map_grid = BuildMapGrid(pts_x, pts_y, 10., &cell_start,
+                                        &cell_pts);
+  
+  CHECK(map_grid.num_pts == 500);
+  CHECK(int(cell_start.size()) == map_grid.num_cols * map_grid.num_rows + 1);
+  CHECK(cell_start.back() == 500);
+  std::vector<int> pt_count(500, 0);
+  for (int cell = 0; cell < map_grid.num_cols * map_grid.num_rows; ++cell) {
+    const int col = cell % map_grid.num_cols;
+    const int row = cell / map_grid.num_cols;
+    for (int k = cell_start[cell]; k < cell_start[cell+1]; ++k) {
+      const int pt = cell_pts[k];
+      pt_count[pt]++;
+      CHECK(int((pts_x[pt] - map_grid.x_min) / 10.) == col);
+      CHECK(int((pts_y[pt] - map_grid.y_min) / 10.) == row);
+    }
+  }
+  for (int i = 0; i < 500; ++i) { CHECK(pt_count[i] == 1); }
+}
+
+/**
+ * Check that the grid search finds a waypoint as close as the linear scan
+ * over all map waypoints, for points near the road, anywhere in the grid and
+ * outside of the grid
+ */
+static void TestClosestWaypoint(const FrenetMap &frenet_map) {
+  const double *map_x = frenet_map.GetFlatArray(kMapX);
+  const double *map_y = frenet_map.GetFlatArray(kMapY);
+  const int num_wps = frenet_map.GetNumWaypoints();
+  const MapGrid &map_grid = frenet_map.GetGrid();
+  const double x_max = map_grid.x_min + map_grid.num_cols * map_grid.cell_size;
+  const double y_max = map_grid.y_min + map_grid.num_rows * map_grid.cell_size;
+  
+  srand(2);
+  for (int k = 0; k < 3000; ++k) {
+    double x;
+    double y;
+    if (k % 3 == 0) {
+      // Near the road
+      const double s = TestRand(0., frenet_map.GetMaxS());
+      const std::vector<double> xy = GetHiResXY(s, TestRand(-20., 30.),
+                                                frenet_map);
+      x = xy[0];
+      y = xy[1];
+    }
+    else if (k % 3 == 1) {
+      // Anywhere in the grid
+      x = TestRand(map_grid.x_min, x_max);
+      y = TestRand(map_grid.y_min, y_max);
+    }
+    else {
+      // Outside of the grid
+      x = x_max + TestRand(1., 500.);
+      y = map_grid.y_min - TestRand(1., 500.);
+    }
+    
+    const int wp_grid = ClosestWaypoint(x, y, frenet_map);
+    const int wp_scan = ClosestWaypoint(x, y, map_x, map_y, num_wps);
+    CHECK((wp_grid >= 0) && (wp_grid < num_wps));
+    CHECK(Distance(x, y, map_x[wp_grid], map_y[wp_grid])
+          == Distance(x, y, map_x[wp_scan], map_y[wp_scan]));
+  }
+}
+
+int main() {
+  TestGridCells();
+  
+  FrenetMap frenet_map;
+  BuildTestFrenetMap(LoadTestRawMap(), &frenet_map);
+  TestClosestWaypoint(frenet_map);
+  
+  return TestResult("test_map_grid");
+}
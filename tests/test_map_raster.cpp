@@ -0,0 +1,72 @@
+//
+//  test_map_raster.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include "test_common.hpp"
+
+/**
+ * Check that the raster covers the road and that the grid search seeded from
+ * the raster wp finds exactly the same closest waypoint as the unseeded search,
+ * on the road and in the outer part of the raster corridor
+ */
+static void TestSeededSearch(const FrenetMap &frenet_map) {
+  const int num_wps = frenet_map.GetNumWaypoints();
+  srand(4);
+  for (int i = 0; i < 20000; ++i) {
+    const double s = TestRand(0., frenet_map.GetMaxS());
+    const double d = (i % 2 == 0) ? TestRand(-11.5, 11.5)
+                                  : TestRand(-19., 19.);
+    const std::vector<double> xy = GetHiResXY(s, d, frenet_map);
+    
+    const int raster_wp = RasterWaypoint(xy[0], xy[1], frenet_map);
+    CHECK((raster_wp < num_wps) && ((raster_wp >= 0) || (i % 2 == 1)));
+    if (raster_wp < 0) { continue; }
+    CHECK(ClosestWaypointFromSeed(xy[0], xy[1], raster_wp, frenet_map)
+          == ClosestWaypoint(xy[0], xy[1], frenet_map));
+  }
+}
+
+/**
+ * Check that raster projection gives bit-for-bit the same Frenet coordinates
+ * and closest waypoint as the grid search
+ */
+static void TestRasterProjection(FrenetMap *frenet_map) {
+  srand(5);
+  for (int i = 0; i < 20000; ++i) {
+    const double s = TestRand(0., frenet_map->GetMaxS());
+    const double d = TestRand(-11.5, 11.5);
+    const std::vector<double> xy = GetHiResXY(s, d, *frenet_map);
+    const double vx = TestRand(-25., 25.);
+    const double vy = TestRand(-25., 25.);
+    
+    frenet_map->SetRasterProjection(false);
+    int grid_hint = -1;
+    const FrenetProjection proj_grid = GetHiResFrenet(xy[0], xy[1], vx, vy,
+                                                      *frenet_map,
+                                                      &grid_hint);
+    frenet_map->SetRasterProjection(true);
+    int raster_hint = -1;
+    const FrenetProjection proj_raster = GetHiResFrenet(xy[0], xy[1], vx, vy,
+                                                        *frenet_map,
+                                                        &raster_hint);
+    CHECK(raster_hint == grid_hint);
+    CHECK(proj_raster.seg_wp == proj_grid.seg_wp);
+    CHECK(proj_raster.s == proj_grid.s);
+    CHECK(proj_raster.d == proj_grid.d);
+    CHECK(proj_raster.s_dot == proj_grid.s_dot);
+    CHECK(proj_raster.d_dot == proj_grid.d_dot);
+  }
+  frenet_map->SetRasterProjection(false);
+}
+
+int main() {
+  FrenetMap frenet_map;
+  BuildTestFrenetMap(LoadTestRawMap(), &frenet_map);
+  TestSeededSearch(frenet_map);
+  TestRasterProjection(&frenet_map);
+  
+  return TestResult("test_map_raster");
+}
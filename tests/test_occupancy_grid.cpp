@@ -0,0 +1,128 @@
+//
+//  test_occupancy_grid.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include "test_common.hpp"
+#include "occupancy_grid.hpp"
+#include "trajectory.hpp"
+
+/**
+ * Random quintic of a path starting at y0 with speed y_dot, with small higher
+ * order terms
+ */
+static Poly<5> RandPathPoly(double y0, double y_dot) {
+  Poly<5> poly;
+  poly.a[0] = y0;
+  poly.a[1] = y_dot;
+  double scale = 2.;
+  for (int i = 2; i <= 5; ++i) {
+    poly.a[i] = TestRand(-scale, scale);
+    scale *= 0.4;
+  }
+  return poly;
+}
+
+/**
+ * Check that the grid as a broad phase never skips a risk time window where
+ * the exact check finds any risk, over random traffic around the ego car
+ * (including cars beyond the grid's range and around the end of the track),
+ * and that it does skip some windows
+ */
+static void TestNeverSkipsRisk() {
+  const double max_s = 6945.554;
+  int num_clear = 0;
+  int num_risky = 0;
+  
+  srand(13);
+  for (int scenario = 0; scenario < 2000; ++scenario) {
+    EgoVehicle ego_car;
+    VehState ego_state = {};
+    ego_state.s = (scenario % 4 == 0) ? TestRand(max_s - 30., max_s)
+                                      : TestRand(0., max_s);
+    ego_state.d = TestRand(1., 11.);
+    ego_car.UpdateState(ego_state);
+    
+    // Prev path buffer sets the new traj's start time
+    VehTrajectory buffer_traj;
+    const int num_buffer = int(TestRand(0., 40.));
+    for (int i = 0; i < num_buffer; ++i) {
+      buffer_traj.states.push_back(ego_state);
+    }
+    ego_car.AppendTraj(buffer_traj);
+    const double t_start = num_buffer * kSimCycleTime;
+    
+    DetectedVehicleTable detected_cars;
+    const int num_cars = int(TestRand(1., 10.));
+    for (int k = 0; k < num_cars; ++k) {
+      VehState car_state = {};
+      car_state.s = fmod(ego_state.s + TestRand(-50., 100.) + max_s, max_s);
+      car_state.d = TestRand(-2., 14.);
+      car_state.s_dot = TestRand(5., 25.);
+      const int idx = detected_cars.Insert(k);
+      detected_cars.UpdateCar(idx, car_state, -1, ego_car, max_s);
+      
+      PredTrajectories pred_trajs;
+      pred_trajs.size = int(TestRand(1., 4.));
+      for (int i = 0; i < pred_trajs.size; ++i) {
+        pred_trajs.intents[i] = kKeepLane;
+        pred_trajs.trajs[i].s = RandPathPoly(car_state.s, car_state.s_dot);
+        pred_trajs.trajs[i].d = RandPathPoly(car_state.d, TestRand(-2., 2.));
+        pred_trajs.trajs[i].t_end = TestRand(0.2, 2.5);
+        pred_trajs.trajs[i].probability = 1.;
+      }
+      detected_cars.SetPredTrajs(idx, pred_trajs);
+    }
+    
+    OccupancyGrid occupancy_grid;
+    occupancy_grid.Update(ego_car, detected_cars, max_s);
+    
+    // Several new ego trajs from the end of the buffer
+    for (int n = 0; n < 5; ++n) {
+      VehTrajectory traj;
+      const double ego_v = TestRand(10., 25.);
+      traj.poly_s = RandPathPoly(fmod(ego_state.s + ego_v*t_start, max_s),
+                                 ego_v);
+      traj.poly_d = RandPathPoly(TestRand(1., 11.), TestRand(-2., 2.));
+      const double t_end_traj = TestRand(1., 3.);
+      
+      double t_window = kEvalRiskWindowTime;
+      double t_begin = 0.;
+      int idx_window = 0;
+      for (; t_begin < t_end_traj;
+           t_begin += t_window, t_window *= 2., ++idx_window) {
+        const double t_end_window = std::min(t_end_traj, t_begin + t_window);
+        if (!occupancy_grid.IsTrajWindowClear(traj, idx_window, t_begin,
+                                              t_end_window)) {
+          num_risky++;
+          continue;
+        }
+        num_clear++;
+        
+        for (int idx = 0; idx < detected_cars.Size(); ++idx) {
+          const PredTrajectories &pred_trajs = detected_cars.GetCar(idx)
+                                                 .GetPredTrajs();
+          for (int i = 0; i < pred_trajs.size; ++i) {
+            const PredTrajectory &car_traj = pred_trajs.trajs[i];
+            const double t_end = std::min(t_end_window,
+                                          car_traj.t_end - t_start);
+            if (t_end <= t_begin) { continue; }
+            CHECK(GetCollisionRisk(traj, car_traj, t_start, t_begin, t_end,
+                                   max_s) == 0.);
+          }
+        }
+      }
+    }
+  }
+  
+  CHECK(num_clear > 0);
+  CHECK(num_risky > 0);
+}
+
+int main() {
+  TestNeverSkipsRisk();
+  
+  return TestResult("test_occupancy_grid");
+}
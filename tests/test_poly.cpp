@@ -0,0 +1,215 @@
+//
+//  test_poly.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include "test_common.hpp"
+#include "trajectory.hpp"
+
+/**
+ * Random quintic with coefficients scaled like the planner's JMT polys
+ */
+static Poly<5> RandPoly() {
+  Poly<5> poly;
+  double scale = 100.;
+  for (int i = 0; i <= 5; ++i) {
+    poly.a[i] = TestRand(-scale, scale);
+    scale *= 0.3;
+  }
+  return poly;
+}
+
+/**
+ * Evaluate the polynomial term by term with explicit powers
+ */
+static double EvalPowers(const double *a, int degree, double x) {
+  double y = 0.;
+  for (int i = 0; i <= degree; ++i) { y += a[i] * pow(x, i); }
+  return y;
+}
+
+/**
+ * Check that Horner evaluation, the derivative polynomial and the fused
+ * evaluation of y and its derivatives match term by term evaluation
+ */
+static void TestEval() {
+  srand(7);
+  for (int i = 0; i < 2000; ++i) {
+    const Poly<5> poly = RandPoly();
+    const Poly<4> poly_dot = poly.Diff();
+    const Poly<3> poly_dotdot = poly_dot.Diff();
+    
+    double pts_x[10];
+    double pts_y[10];
+    double pts_y_dot[10];
+    double pts_y_dotdot[10];
+    for (int k = 0; k < 10; ++k) { pts_x[k] = TestRand(-1., 10.); }
+    poly.EvalDerivsBatch(pts_x, 10, pts_y, pts_y_dot, pts_y_dotdot);
+    
+    for (int k = 0; k < 10; ++k) {
+      const double x = pts_x[k];
+      const double y = EvalPowers(poly.a, 5, x);
+      const double y_dot = EvalPowers(poly_dot.a, 4, x);
+      const double y_dotdot = EvalPowers(poly_dotdot.a, 3, x);
+      const double tol = 1e-9 * (1. + std::abs(y));
+      CHECK_NEAR(poly.Eval(x), y, tol);
+      CHECK_NEAR(pts_y[k], y, tol);
+      CHECK_NEAR(pts_y_dot[k], y_dot, 1e-9 * (1. + std::abs(y_dot)));
+      CHECK_NEAR(pts_y_dotdot[k], y_dotdot,
+                 1e-9 * (1. + std::abs(y_dotdot)));
+    }
+    for (int k = 1; k <= 5; ++k) { CHECK(poly_dot.a[k-1] == k * poly.a[k]); }
+  }
+}
+
+/**
+ * Check that sampling with the time basis tables matches Horner evaluation at
+ * the sim time steps, for horizons within and past the tables
+ */
+static void TestSampleQuinticBatch() {
+  srand(8);
+  const int num_polys = 7;
+  const int num_pts = kTimeBasisSteps + 50;
+  Poly<5> polys[num_polys];
+  for (int k = 0; k < num_polys; ++k) { polys[k] = RandPoly(); }
+  
+  std::vector<double> pts_pos(num_polys * num_pts);
+  std::vector<double> pts_vel(num_polys * num_pts);
+  std::vector<double> pts_acc(num_polys * num_pts);
+  SampleQuinticBatch(polys, num_polys, num_pts, pts_pos.data(),
+                     pts_vel.data(), pts_acc.data());
+  
+  for (int k = 0; k < num_polys; ++k) {
+    for (int i = 0; i < num_pts; ++i) {
+      double y;
+      double y_dot;
+      double y_dotdot;
+      polys[k].EvalDerivs((i + 1) * kSimCycleTime, &y, &y_dot, &y_dotdot);
+      const int idx = k * num_pts + i;
+      CHECK_NEAR(pts_pos[idx], y, 1e-9 * (1. + std::abs(y)));
+      CHECK_NEAR(pts_vel[idx], y_dot, 1e-9 * (1. + std::abs(y_dot)));
+      CHECK_NEAR(pts_acc[idx], y_dotdot, 1e-9 * (1. + std::abs(y_dotdot)));
+    }
+  }
+}
+
+/**
+ * Check that the Taylor shifted polynomial matches evaluation at the shifted
+ * x, including shifts back before 0
+ */
+static void TestShift() {
+  srand(9);
+  for (int i = 0; i < 2000; ++i) {
+    const Poly<5> poly = RandPoly();
+    const double dx = TestRand(-2., 5.);
+    const Poly<5> shift_poly = poly.Shift(dx);
+    for (int k = 0; k < 10; ++k) {
+      const double x = TestRand(0., 5.);
+      const double y = EvalPowers(poly.a, 5, x + dx);
+      CHECK_NEAR(shift_poly.Eval(x), y, 1e-9 * (1. + std::abs(y)));
+    }
+  }
+}
+
+/**
+ * Check that the Bernstein bounds contain the polynomial over the range and
+ * its values at both ends (which are Bernstein coefficients themselves), and
+ * are exact for lines
+ */
+static void TestGetBounds() {
+  srand(10);
+  for (int i = 0; i < 2000; ++i) {
+    const Poly<5> poly = RandPoly();
+    const double x_end = TestRand(0.1, 6.);
+    double y_min, y_max;
+    poly.GetBounds(x_end, &y_min, &y_max);
+    const double tol = 1e-9 * (1. + std::abs(y_min) + std::abs(y_max));
+    CHECK(y_min <= y_max);
+    CHECK_NEAR(std::min(y_min, poly.Eval(0.)), y_min, tol);
+    CHECK_NEAR(std::min(y_min, poly.Eval(x_end)), y_min, tol);
+    CHECK_NEAR(std::max(y_max, poly.Eval(0.)), y_max, tol);
+    CHECK_NEAR(std::max(y_max, poly.Eval(x_end)), y_max, tol);
+    for (int k = 0; k <= 200; ++k) {
+      const double y = poly.Eval(k * x_end / 200.);
+      CHECK((y >= y_min - tol) && (y <= y_max + tol));
+    }
+    
+    Poly<5> line = {};
+    line.a[0] = poly.a[0];
+    line.a[1] = poly.a[1];
+    line.GetBounds(x_end, &y_min, &y_max);
+    const double y_end = line.a[0] + line.a[1] * x_end;
+    CHECK_NEAR(y_min, std::min(line.a[0], y_end), tol);
+    CHECK_NEAR(y_max, std::max(line.a[0], y_end), tol);
+  }
+}
+
+/**
+ * Quintic scale * (x - roots[0]) * ... * (x - roots[4])
+ */
+static Poly<5> PolyFromRoots(const double *roots, double scale) {
+  Poly<5> poly = {};
+  poly.a[0] = scale;
+  for (int k = 0; k < 5; ++k) {
+    for (int i = k + 1; i > 0; --i) {
+      poly.a[i] = poly.a[i-1] - roots[k] * poly.a[i];
+    }
+    poly.a[0] *= -roots[k];
+  }
+  return poly;
+}
+
+/**
+ * Check that the sign changing roots found within a range match known roots,
+ * with roots outside of the range skipped and a double root (no sign change)
+ * not reported
+ */
+static void TestFindRoots() {
+  srand(11);
+  const double x_lo = 0.;
+  const double x_hi = 3.;
+  for (int i = 0; i < 2000; ++i) {
+    // Roots spread over and past the range, apart from each other and from
+    // the ends of the range
+    double roots[5];
+    for (int k = 0; k < 5; ++k) {
+      roots[k] = -1. + k + TestRand(0.1, 0.9);
+    }
+    const double scale = (i % 2 == 0) ? TestRand(0.1, 10.)
+                                      : -TestRand(0.1, 10.);
+    const Poly<5> poly = PolyFromRoots(roots, scale);
+    
+    double found[5];
+    const int num_found = poly.FindRoots(x_lo, x_hi, found);
+    int num_in_range = 0;
+    for (int k = 0; k < 5; ++k) {
+      if ((roots[k] > x_lo) && (roots[k] < x_hi)) {
+        CHECK(num_in_range < num_found);
+        if (num_in_range < num_found) {
+          CHECK_NEAR(found[num_in_range], roots[k], kPolyRootTol);
+        }
+        num_in_range++;
+      }
+    }
+    CHECK(num_found == num_in_range);
+  }
+  
+  const double double_roots[] = {1., 1., 2., -5., 7.};
+  double found[5];
+  const int num_found = PolyFromRoots(double_roots, 1.).FindRoots(x_lo, x_hi,
+                                                                  found);
+  CHECK(num_found == 1);
+  CHECK_NEAR(found[0], 2., kPolyRootTol);
+}
+
+int main() {
+  TestEval();
+  TestSampleQuinticBatch();
+  TestShift();
+  TestGetBounds();
+  TestFindRoots();
+  
+  return TestResult("test_poly");
+}
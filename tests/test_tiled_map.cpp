@@ -0,0 +1,164 @@
+//
+//  test_tiled_map.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include "test_common.hpp"
+#include "map_cache.hpp"
+
+/**
+ * Check that a tiled map, interpolated tile by tile from the raw map file
+ * rows, matches the flat map interpolated from the whole raw map
+ */
+static void TestTiledMatchesFlat(const FrenetMap &flat_map,
+                                 FrenetMap *tiled) {
+  const FrenetMap &tiled_map = *tiled;
+  CHECK(tiled_map.IsTiled());
+  CHECK(tiled_map.GetNumWaypoints() == flat_map.GetNumWaypoints());
+  CHECK(tiled_map.GetMaxS() == flat_map.GetMaxS());
+  
+  srand(6);
+  for (int i = 0; i < 5000; ++i) {
+    const double s = TestRand(0., flat_map.GetMaxS());
+    const double d = TestRand(-11.5, 11.5);
+    const std::vector<double> xy_flat = GetHiResXY(s, d, flat_map);
+    const std::vector<double> xy_tiled = GetHiResXY(s, d, tiled_map);
+    CHECK_NEAR(xy_tiled[0], xy_flat[0], 0.05);
+    CHECK_NEAR(xy_tiled[1], xy_flat[1], 0.05);
+    
+    const int wp_flat = ClosestWaypoint(xy_flat[0], xy_flat[1], flat_map);
+    const int wp_tiled = ClosestWaypoint(xy_flat[0], xy_flat[1], tiled_map);
+    const int num_wps = flat_map.GetNumWaypoints();
+    const int wp_diff = std::abs(wp_tiled - wp_flat);
+    CHECK(std::min(wp_diff, num_wps - wp_diff) <= 1);
+    tiled->EvictTiles();
+  }
+}
+
+/**
+ * Check that tiles are evicted when one is added over kMapMaxResidentTiles,
+ * least recently used first, but never tiles used in the current cycle
+ */
+static void TestEvictOnInsert(FrenetMap *tiled_map) {
+  const int num_tiles = ((tiled_map->GetNumWaypoints() + kMapTileMask)
+                         >> kMapTileShift);
+  CHECK(num_tiles > kMapMaxResidentTiles + 8);
+  
+  // Fill the budget in one cycle, then add tiles in the next cycle
+  tiled_map->EvictTiles();
+  for (int t = 0; t < kMapMaxResidentTiles; ++t) {
+    tiled_map->GetTile(t << kMapTileShift);
+  }
+  CHECK(tiled_map->GetNumResidentTiles() == kMapMaxResidentTiles);
+  tiled_map->EvictTiles();
+  for (int t = kMapMaxResidentTiles; t < kMapMaxResidentTiles + 8; ++t) {
+    tiled_map->GetTile(t << kMapTileShift);
+    CHECK(tiled_map->GetNumResidentTiles() == kMapMaxResidentTiles);
+  }
+  
+  // Least recently used tiles were evicted, most recent ones are kept
+  tiled_map->GetTile(kMapMaxResidentTiles - 1);
+  CHECK(tiled_map->GetNumResidentTiles() == kMapMaxResidentTiles);
+  
+  // Tiles used in this cycle stay valid even over budget
+  tiled_map->EvictTiles();
+  std::vector<const MapTile*> cycle_tiles;
+  for (int t = 0; t < kMapMaxResidentTiles + 4; ++t) {
+    cycle_tiles.push_back(&tiled_map->GetTile(t << kMapTileShift));
+  }
+  CHECK(tiled_map->GetNumResidentTiles() == kMapMaxResidentTiles + 4);
+  for (int t = 0; t < int(cycle_tiles.size()); ++t) {
+    CHECK(cycle_tiles[t]->first_wp == (t << kMapTileShift));
+  }
+  tiled_map->EvictTiles();
+  CHECK(tiled_map->GetNumResidentTiles() == kMapMaxResidentTiles);
+}
+
+/**
+ * Check that a tiled map's raw map row index round trips through the map
+ * cache, with tiles read from the raw map file matching the original ones
+ */
+static void TestTiledCache(FrenetMap *tiled) {
+  const FrenetMap &tiled_map = *tiled;
+  const std::string cache_file = "test_tiled_map.bin";
+  const std::string map_file = TEST_MAP_FILE;
+  const MapSourceStamp src_stamp = GetMapSourceStamp(map_file);
+  CHECK(WriteMapCache(cache_file, src_stamp, tiled_map));
+  
+  FrenetMap cached_map;
+  CHECK(LoadMapCache(cache_file, map_file, src_stamp, &cached_map));
+  CHECK(cached_map.IsTiled());
+  CHECK(cached_map.GetNumWaypoints() == tiled_map.GetNumWaypoints());
+  CHECK(cached_map.GetMaxS() == tiled_map.GetMaxS());
+  for (int wp = 0; wp < tiled_map.GetNumWaypoints(); wp += 7) {
+    CHECK(cached_map.GetX(wp) == tiled_map.GetX(wp));
+    CHECK(cached_map.GetY(wp) == tiled_map.GetY(wp));
+    cached_map.EvictTiles();
+    tiled->EvictTiles();
+  }
+  CHECK(cached_map.GetNumResidentTiles() <= kMapMaxResidentTiles);
+  
+  // Tiled cache is stale without the same source map file
+  FrenetMap stale_map;
+  const MapSourceStamp no_stamp = {-1, -1};
+  CHECK(!LoadMapCache(cache_file, map_file, no_stamp, &stale_map));
+  
+  remove(cache_file.c_str());
+}
+
+/**
+ * Check that batch curvature lookups match GetHiResCurvature point by point,
+ * for trajectory-like runs of s (including around the end of the track and
+ * back to a new start) and for random s in any order, with s outside of the
+ * track wrapped
+ */
+static void TestCurvatureBatch(FrenetMap *map) {
+  const double max_s = map->GetMaxS();
+  const int num_pts = 1000;
+  std::vector<double> pts_s(num_pts);
+  std::vector<double> curvatures(num_pts);
+  
+  srand(12);
+  for (int i_batch = 0; i_batch < 200; ++i_batch) {
+    if (i_batch % 2 == 0) {
+      // Runs of 250 increasing s samples, some starting before the track end
+      for (int i = 0; i < num_pts; i += 250) {
+        double s = ((i / 250) % 2 == 0) ? TestRand(max_s - 50., max_s)
+                                        : TestRand(0., max_s);
+        for (int j = i; j < i + 250; ++j) {
+          s += TestRand(0., 0.5);
+          pts_s[j] = std::fmod(s, max_s);
+        }
+      }
+    }
+    else {
+      for (int i = 0; i < num_pts; ++i) {
+        pts_s[i] = TestRand(-max_s, 2.*max_s);
+      }
+    }
+    
+    GetHiResCurvatureBatch(pts_s.data(), num_pts, *map, curvatures.data());
+    for (int i = 0; i < num_pts; ++i) {
+      CHECK(curvatures[i] == GetHiResCurvature(pts_s[i], *map));
+    }
+    map->EvictTiles();
+  }
+}
+
+int main() {
+  const TestRawMap raw_map = LoadTestRawMap();
+  FrenetMap flat_map;
+  BuildTestFrenetMap(raw_map, &flat_map);
+  FrenetMap tiled_map;
+  BuildTestTiledFrenetMap(raw_map, &tiled_map);
+  
+  TestTiledMatchesFlat(flat_map, &tiled_map);
+  TestEvictOnInsert(&tiled_map);
+  TestTiledCache(&tiled_map);
+  TestCurvatureBatch(&flat_map);
+  TestCurvatureBatch(&tiled_map);
+  
+  return TestResult("test_tiled_map");
+}
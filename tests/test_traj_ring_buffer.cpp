@@ -0,0 +1,102 @@
+//
+//  test_traj_ring_buffer.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include <deque>
+#include "test_common.hpp"
+#include "vehicle.hpp"
+
+/**
+ * New trajectory with num_states states numbered from first_s in s
+ */
+static VehTrajectory MakeTraj(int num_states, double first_s) {
+  VehTrajectory traj;
+  for (int i = 0; i < num_states; ++i) {
+    VehState state = {};
+    state.s = first_s + i;
+    traj.states.push_back(state);
+  }
+  return traj;
+}
+
+/**
+ * Check the ring buffer against a reference deque through cycles of dropping
+ * driven states, truncating to a buffer and appending new trajectories, with
+ * the ring wrapping around many times and appends that overflow it
+ */
+static void TestRandomCycles() {
+  TrajRingBuffer ring;
+  std::deque<double> ref_s;
+  long long ref_head_tick = 0;
+  double next_s = 0.;
+  
+  srand(11);
+  for (int cycle = 0; cycle < 3000; ++cycle) {
+    const int num_drop = int(TestRand(0., 60.));
+    ring.DropFront(num_drop);
+    const int num_dropped = std::min(num_drop, int(ref_s.size()));
+    ref_s.erase(ref_s.begin(), ref_s.begin() + num_dropped);
+    ref_head_tick += num_dropped;
+    
+    const int num_keep = int(TestRand(0., 80.));
+    ring.Truncate(num_keep);
+    if (num_keep < int(ref_s.size())) { ref_s.resize(num_keep); }
+    
+    // Mostly normal paths, sometimes longer than the free capacity
+    const int num_new = (cycle % 10 == 9) ? int(TestRand(400., 700.))
+                                          : int(TestRand(0., 200.));
+    const VehTrajectory traj = MakeTraj(num_new, next_s);
+    next_s += num_new;
+    const int num_kept = ring.Append(traj);
+    const int num_free = kEgoTrajCapacity - int(ref_s.size());
+    CHECK(num_kept == std::min(num_new, num_free));
+    for (int i = 0; i < num_kept; ++i) { ref_s.push_back(traj.states[i].s); }
+    
+    CHECK(ring.Size() == int(ref_s.size()));
+    CHECK(ring.GetHeadTick() == ref_head_tick);
+    for (int i = 0; (i < ring.Size()) && (i < int(ref_s.size())); ++i) {
+      CHECK(ring[i].s == ref_s[i]);
+    }
+    if (ring.Size() > 0) { CHECK(ring.Back().s == ref_s.back()); }
+    
+    if (cycle % 100 == 99) {
+      ring.Clear();
+      ref_head_tick += ref_s.size();
+      ref_s.clear();
+      CHECK(ring.Size() == 0);
+      CHECK(ring.GetHeadTick() == ref_head_tick);
+    }
+  }
+}
+
+/**
+ * Check that the ego car trims its traj to the path buffer after the current
+ * point and reports the new states it keeps
+ */
+static void TestEgoTrimAndAppend() {
+  EgoVehicle ego_car;
+  const int buffer_pts = kPathBufferTime / kSimCycleTime;
+  CHECK(ego_car.AppendTraj(MakeTraj(150, 0.)) == 150);
+  
+  ego_car.TrimTrajToBuffer(20);
+  CHECK(ego_car.GetTraj().Size() == std::min(buffer_pts, 150 - 21));
+  CHECK(ego_car.GetTraj()[0].s == 21.);
+  
+  const int num_buffer = ego_car.GetTraj().Size();
+  CHECK(ego_car.AppendTraj(MakeTraj(kEgoTrajCapacity, 1000.))
+        == kEgoTrajCapacity - num_buffer);
+  CHECK(ego_car.GetTraj().Size() == kEgoTrajCapacity);
+  
+  ego_car.TrimTrajToBuffer(0);
+  CHECK(ego_car.GetTraj().Size() == 0);
+}
+
+int main() {
+  TestRandomCycles();
+  TestEgoTrimAndAppend();
+  
+  return TestResult("test_traj_ring_buffer");
+}
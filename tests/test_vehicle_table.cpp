@@ -0,0 +1,94 @@
+//
+//  test_vehicle_table.cpp
+//  Path_Planning
+//
+//  Created by Student on 2/20/18.
+//
+
+#include <map>
+#include "test_common.hpp"
+#include "vehicle.hpp"
+
+/**
+ * Check that the slot-mapped table stays consistent with a reference map of
+ * vehicle ID -> s through random inserts, updates and erases: ID and handle
+ * lookups, dense index order and the hot state values
+ */
+static void TestRandomOps() {
+  const double max_s = 6945.554;
+  EgoVehicle ego_car;
+  VehState ego_state = {};
+  ego_state.s = 100.;
+  ego_car.UpdateState(ego_state);
+  
+  DetectedVehicleTable table;
+  std::map<int, double> ref_cars; // veh ID -> s
+  std::map<int, VehHandle> handles; // handles of cars in the table
+  std::vector<VehHandle> erased_handles;
+  
+  srand(9);
+  for (int step = 0; step < 20000; ++step) {
+    const int veh_id = int(TestRand(0., 60.));
+    const double op = TestRand(0., 1.);
+    if (op < 0.5) {
+      // Insert (or find) and update
+      const bool was_in = (ref_cars.count(veh_id) > 0);
+      const int size_before = table.Size();
+      const int idx = table.Insert(veh_id);
+      CHECK(table.Size() == size_before + (was_in ? 0 : 1));
+      CHECK(table.GetID(idx) == veh_id);
+      VehState state = {};
+      state.s = TestRand(0., max_s);
+      state.d = TestRand(0., 12.);
+      state.s_dot = TestRand(0., 25.);
+      table.UpdateCar(idx, state, -1, ego_car, max_s);
+      ref_cars[veh_id] = state.s;
+      if (!was_in) { handles[veh_id] = table.GetHandle(veh_id); }
+    }
+    else if (op < 0.8) {
+      // Erase
+      if (ref_cars.count(veh_id) > 0) {
+        erased_handles.push_back(handles[veh_id]);
+        handles.erase(veh_id);
+      }
+      table.Erase(veh_id);
+      ref_cars.erase(veh_id);
+      CHECK(!table.Contains(veh_id));
+      CHECK(table.Find(table.GetHandle(veh_id)) == -1);
+    }
+    
+    // Whole table matches reference
+    CHECK(table.Size() == int(ref_cars.size()));
+    for (int idx = 0; idx < table.Size(); ++idx) {
+      const int id = table.GetID(idx);
+      CHECK(table.Find(id) == idx);
+      CHECK(table.At(id).GetID() == id);
+      CHECK(table.GetCar(idx).GetID() == id);
+      CHECK((ref_cars.count(id) > 0) && (table.GetS(idx) == ref_cars[id]));
+      CHECK(table.GetS(idx) == table.GetCar(idx).GetState().s);
+      CHECK(table.GetD(idx) == table.GetCar(idx).GetState().d);
+      CHECK(table.GetLane(idx) == table.GetCar(idx).GetLane());
+    }
+    for (std::map<int, VehHandle>::const_iterator it = handles.begin();
+         it != handles.end(); ++it) {
+      CHECK(table.Find(it->second) == table.Find(it->first));
+    }
+  }
+  
+  // Handles to erased vehicles never find the slot's later vehicles
+  for (int i = 0; i < int(erased_handles.size()); ++i) {
+    CHECK(table.Find(erased_handles[i]) == -1);
+  }
+  
+  // At() throws for IDs not in the table
+  bool is_thrown = false;
+  try { table.At(1000); }
+  catch (const std::out_of_range&) { is_thrown = true; }
+  CHECK(is_thrown);
+}
+
+int main() {
+  TestRandomOps();
+  
+  return TestResult("test_vehicle_table");
+}